@@ -0,0 +1,105 @@
+#ifndef avr_pins_h
+#define avr_pins_h
+#ifdef __cplusplus
+
+#include <stdint.h>
+
+/* Compile-time description of the Arduino Mega 2560 pins.
+ *
+ * The Arduino core resolves a pin number to its port and bit with
+ * tables in flash on every digitalRead()/digitalWrite(). The functions
+ * here are constexpr, so when the pin is a compile-time constant the
+ * port register addresses and the bit masks are constants as well.
+ * The mapping follows variants/mega/pins_arduino.h.
+ */
+
+#define AVR_NUM_DIGITAL_PINS 70
+
+typedef enum _avr_port {
+  AVR_PORT_A = 0, AVR_PORT_B, AVR_PORT_C, AVR_PORT_D, AVR_PORT_E, AVR_PORT_F,
+  AVR_PORT_G, AVR_PORT_H, AVR_PORT_J, AVR_PORT_K, AVR_PORT_L,
+  AVR_PORT_COUNT
+} avr_port;
+
+/* Data space addresses of the PINx registers. DDRx is at PINx + 1
+ * and PORTx is at PINx + 2 for all the ports. */
+constexpr uint16_t AVR_PIN_REG_ADDR[AVR_PORT_COUNT] = {
+  0x20, 0x23, 0x26, 0x29, 0x2C, 0x2F, 0x32, 0x100, 0x103, 0x106, 0x109
+};
+
+/* Port and bit of every digital pin, encoded as (port << 3) | bit */
+#define _P(port, bit) (((port) << 3) | (bit))
+constexpr uint8_t AVR_PIN_MAP[AVR_NUM_DIGITAL_PINS] = {
+  _P(AVR_PORT_E, 0), _P(AVR_PORT_E, 1), _P(AVR_PORT_E, 4), _P(AVR_PORT_E, 5), // 0 - 3
+  _P(AVR_PORT_G, 5), _P(AVR_PORT_E, 3), _P(AVR_PORT_H, 3), _P(AVR_PORT_H, 4), // 4 - 7
+  _P(AVR_PORT_H, 5), _P(AVR_PORT_H, 6), _P(AVR_PORT_B, 4), _P(AVR_PORT_B, 5), // 8 - 11
+  _P(AVR_PORT_B, 6), _P(AVR_PORT_B, 7), _P(AVR_PORT_J, 1), _P(AVR_PORT_J, 0), // 12 - 15
+  _P(AVR_PORT_H, 1), _P(AVR_PORT_H, 0), _P(AVR_PORT_D, 3), _P(AVR_PORT_D, 2), // 16 - 19
+  _P(AVR_PORT_D, 1), _P(AVR_PORT_D, 0), _P(AVR_PORT_A, 0), _P(AVR_PORT_A, 1), // 20 - 23
+  _P(AVR_PORT_A, 2), _P(AVR_PORT_A, 3), _P(AVR_PORT_A, 4), _P(AVR_PORT_A, 5), // 24 - 27
+  _P(AVR_PORT_A, 6), _P(AVR_PORT_A, 7), _P(AVR_PORT_C, 7), _P(AVR_PORT_C, 6), // 28 - 31
+  _P(AVR_PORT_C, 5), _P(AVR_PORT_C, 4), _P(AVR_PORT_C, 3), _P(AVR_PORT_C, 2), // 32 - 35
+  _P(AVR_PORT_C, 1), _P(AVR_PORT_C, 0), _P(AVR_PORT_D, 7), _P(AVR_PORT_G, 2), // 36 - 39
+  _P(AVR_PORT_G, 1), _P(AVR_PORT_G, 0), _P(AVR_PORT_L, 7), _P(AVR_PORT_L, 6), // 40 - 43
+  _P(AVR_PORT_L, 5), _P(AVR_PORT_L, 4), _P(AVR_PORT_L, 3), _P(AVR_PORT_L, 2), // 44 - 47
+  _P(AVR_PORT_L, 1), _P(AVR_PORT_L, 0), _P(AVR_PORT_B, 3), _P(AVR_PORT_B, 2), // 48 - 51
+  _P(AVR_PORT_B, 1), _P(AVR_PORT_B, 0),                                       // 52 - 53
+  _P(AVR_PORT_F, 0), _P(AVR_PORT_F, 1), _P(AVR_PORT_F, 2), _P(AVR_PORT_F, 3), // 54 - 57 (A0 - A3)
+  _P(AVR_PORT_F, 4), _P(AVR_PORT_F, 5), _P(AVR_PORT_F, 6), _P(AVR_PORT_F, 7), // 58 - 61 (A4 - A7)
+  _P(AVR_PORT_K, 0), _P(AVR_PORT_K, 1), _P(AVR_PORT_K, 2), _P(AVR_PORT_K, 3), // 62 - 65 (A8 - A11)
+  _P(AVR_PORT_K, 4), _P(AVR_PORT_K, 5), _P(AVR_PORT_K, 6), _P(AVR_PORT_K, 7)  // 66 - 69 (A12 - A15)
+};
+#undef _P
+
+/***f* avrPinValid
+ *
+ * Returns true if 'pin' exists on the board.
+ */
+constexpr bool avrPinValid(uint8_t pin) {
+  return pin < AVR_NUM_DIGITAL_PINS;
+}
+
+/***f* avrPinPort
+ *
+ * Returns the port (avr_port) that 'pin' belongs to.
+ */
+constexpr uint8_t avrPinPort(uint8_t pin) {
+  return AVR_PIN_MAP[pin] >> 3;
+}
+
+/***f* avrPinBit
+ *
+ * Returns the bit mask of 'pin' in its port registers.
+ */
+constexpr uint8_t avrPinBit(uint8_t pin) {
+  return 1 << (AVR_PIN_MAP[pin] & 0x07);
+}
+
+/***f* avrPinInputReg, avrPinDirReg, avrPinOutputReg
+ *
+ * Return the data space addresses of the PINx, DDRx and
+ * PORTx registers of 'pin'.
+ */
+constexpr uint16_t avrPinInputReg(uint8_t pin) {
+  return AVR_PIN_REG_ADDR[avrPinPort(pin)];
+}
+
+constexpr uint16_t avrPinDirReg(uint8_t pin) {
+  return AVR_PIN_REG_ADDR[avrPinPort(pin)] + 1;
+}
+
+constexpr uint16_t avrPinOutputReg(uint8_t pin) {
+  return AVR_PIN_REG_ADDR[avrPinPort(pin)] + 2;
+}
+
+/***f* avrPinHasPwm
+ *
+ * Returns true if analogWrite() can drive 'pin' with a hardware PWM.
+ * On the Mega these are the pins 2 - 13 and 44 - 46.
+ */
+constexpr bool avrPinHasPwm(uint8_t pin) {
+  return (pin >= 2 && pin <= 13) || (pin >= 44 && pin <= 46);
+}
+
+#endif // endif __cpluscplus
+#endif // endif avr_pins_h
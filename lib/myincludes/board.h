@@ -0,0 +1,133 @@
+#ifndef board_h
+#define board_h
+#ifdef __cplusplus
+
+#include "Arduino.h"
+#include "avr_pins.h"
+
+/* The enclosures that we build. Choose one at compile time with
+ * -DVAGVIDE_ENCLOSURE=... in the build_flags of platformio.ini.
+ */
+#define ENCLOSURE_SOUS_VIDE 0 // The sous vide with 4 sensors (2 front, 2 rear)
+#define ENCLOSURE_BENCH     1 // The development bench board with a single sensor
+
+#ifndef VAGVIDE_ENCLOSURE
+#define VAGVIDE_ENCLOSURE ENCLOSURE_SOUS_VIDE
+#endif
+
+/* Describes a temperature sensor. The sensor tables are stored in
+ * flash, so at run time read the fields with pgm_read_byte() and
+ * pgm_read_word(), or use the tempSensorPin() and tempSensorName()
+ * helpers from temperature.h.
+ */
+typedef struct _temp_sensor_desc {
+  uint8_t pin;       // The pin that the sensor is connected to.
+  const char *name;  // The description of the sensor. Stored in flash (PROGMEM).
+} temp_sensor_desc;
+
+/* Everything that changes between the enclosures. The order of the
+ * button_pins must be matching the order of the push_buttons enum.
+ * readButtons() reads a port only once for consecutive button_pins,
+ * so try to keep the buttons of the same port next to each other.
+ */
+typedef struct _board_desc {
+  const temp_sensor_desc *sensors; // Stored in flash (PROGMEM)
+  uint8_t num_sensors;
+  uint8_t temp_resolution_bits;    // 9, 10, 11 or 12 bits resolution with
+                                   // 93.75ms, 187.5ms, 375ms and 750ms temperature
+                                   // reading time respectively. Read the DS18B20
+                                   // datasheet for more information.
+  uint8_t button_pins[5];          // BACK, OK, DOWN, UP and the float switch
+  uint8_t ssr_pin;                 // Solid State Relay must be connected on a PWM pin
+  uint8_t pump_relay_pin;
+  uint8_t rgb_led_pins[3];         // R, G, B. Must be connected on PWM pins
+  uint8_t eth_cs_pin;              // SPI chip select of the ENC28J60
+  uint8_t lcd_i2c_addr;
+  uint8_t lcd_cols;
+  uint8_t lcd_rows;
+} board_desc;
+
+/***f* countOf
+ *
+ * Returns the number of elements of an array at compile time.
+ */
+template <typename T, size_t N>
+constexpr uint8_t countOf(const T (&)[N]) {
+  return N;
+}
+
+constexpr char SENSOR_NAME_1[] PROGMEM = "TemperatureSensor1"; // Front 1
+constexpr char SENSOR_NAME_2[] PROGMEM = "TemperatureSensor2"; // Front 2
+constexpr char SENSOR_NAME_3[] PROGMEM = "TemperatureSensor3"; // Rear 1
+constexpr char SENSOR_NAME_4[] PROGMEM = "TemperatureSensor4"; // Rear 2
+
+constexpr temp_sensor_desc SOUS_VIDE_SENSORS[] PROGMEM = {
+  {32, SENSOR_NAME_1},
+  {34, SENSOR_NAME_2},
+  {36, SENSOR_NAME_3},
+  {38, SENSOR_NAME_4}
+};
+
+constexpr temp_sensor_desc BENCH_SENSORS[] PROGMEM = {
+  {32, SENSOR_NAME_1}
+};
+
+constexpr board_desc BOARDS[] = {
+  /* ENCLOSURE_SOUS_VIDE */
+  {
+    SOUS_VIDE_SENSORS, countOf(SOUS_VIDE_SENSORS), 12,
+    {40, 42, 44, 46, 22},
+    8, 24,
+    {6, 4, 2},
+    53,
+    0x27, 16, 2
+  },
+  /* ENCLOSURE_BENCH */
+  {
+    BENCH_SENSORS, countOf(BENCH_SENSORS), 12,
+    {40, 42, 44, 46, 22},
+    8, 24,
+    {6, 4, 2},
+    53,
+    0x27, 16, 2
+  }
+};
+
+static_assert(VAGVIDE_ENCLOSURE < countOf(BOARDS), "Unknown VAGVIDE_ENCLOSURE");
+
+/* The board that we build for */
+constexpr board_desc BOARD = BOARDS[VAGVIDE_ENCLOSURE];
+
+/***f* boardPinsValid
+ *
+ * Returns true if the first 'count' pins of 'pins' exist on the board.
+ * With pwm == true they must also support analogWrite().
+ */
+constexpr bool boardPinsValid(const uint8_t *pins, uint8_t count, bool pwm) {
+  return count == 0 ||
+         (avrPinValid(pins[0]) && (!pwm || avrPinHasPwm(pins[0])) &&
+          boardPinsValid(pins + 1, count - 1, pwm));
+}
+
+/***f* boardSensorPinsValid
+ *
+ * Returns true if all the sensor pins exist on the board.
+ */
+constexpr bool boardSensorPinsValid(const temp_sensor_desc *sensors, uint8_t count) {
+  return count == 0 ||
+         (avrPinValid(sensors[0].pin) && boardSensorPinsValid(sensors + 1, count - 1));
+}
+
+static_assert(BOARD.num_sensors > 0, "At least one temperature sensor is needed");
+static_assert(boardSensorPinsValid(BOARD.sensors, BOARD.num_sensors), "Invalid temperature sensor pin");
+static_assert(BOARD.temp_resolution_bits >= 9 && BOARD.temp_resolution_bits <= 12,
+              "The DS18B20 supports 9, 10, 11 or 12 bits resolution");
+static_assert(boardPinsValid(BOARD.button_pins, countOf(BOARD.button_pins), false), "Invalid button pin");
+static_assert(avrPinValid(BOARD.pump_relay_pin), "Invalid pump relay pin");
+static_assert(avrPinValid(BOARD.eth_cs_pin), "Invalid ethernet chip select pin");
+static_assert(avrPinHasPwm(BOARD.ssr_pin), "The SSR must be connected on a PWM pin");
+static_assert(boardPinsValid(BOARD.rgb_led_pins, countOf(BOARD.rgb_led_pins), true),
+              "The RGB LED must be connected on PWM pins");
+
+#endif // endif __cpluscplus
+#endif // endif board_h
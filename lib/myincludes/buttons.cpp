@@ -0,0 +1,126 @@
+#include "buttons.h"
+
+static_assert((BUTTON_EVENT_QUEUE_SIZE & (BUTTON_EVENT_QUEUE_SIZE - 1)) == 0,
+              "BUTTON_EVENT_QUEUE_SIZE must be a power of 2");
+
+/* Only touched from the ISR */
+static uint8_t lastRaw = 0;
+static uint8_t stableTicks = 0;
+static uint16_t heldTicks = 0;   // Ticks since the held buttons last changed
+static uint8_t repeatTicks = 0;  // Ticks until the next repeat, 0 if not repeating
+static uint8_t repeatCount = 0;
+
+/* Written by the ISR, read by loop() */
+static volatile uint8_t debounced = 0;
+
+/* The ISR is the only writer of queueHead and loop() the only
+ * writer of queueTail. The slots aren't volatile, so loop() reads
+ * them with the interrupts disabled, which also orders the read
+ * after the one of queueHead. */
+static button_event queue[BUTTON_EVENT_QUEUE_SIZE];
+static volatile uint8_t queueHead = 0;
+static volatile uint8_t queueTail = 0;
+
+static void pushEvent(IN uint8_t type,
+                      IN uint8_t buttons,
+                      IN uint8_t repeats) {
+  uint8_t next = (queueHead + 1) & (BUTTON_EVENT_QUEUE_SIZE - 1);
+
+  /* If loop() is that late, the user has to press again */
+  if (next == queueTail)
+    return;
+
+  queue[queueHead].type = type;
+  queue[queueHead].buttons = buttons;
+  queue[queueHead].repeats = repeats;
+  queueHead = next;
+}
+
+void buttonsTick(IN uint8_t raw) {
+  if (raw != lastRaw) {
+    lastRaw = raw;
+    stableTicks = 0;
+    return;
+  }
+
+  if (stableTicks < BUTTON_DEBOUNCE_TICKS)
+    stableTicks++;
+
+  if (stableTicks == BUTTON_DEBOUNCE_TICKS && raw != debounced) {
+    uint8_t changed = (raw ^ debounced) & BUTTON_EVENT_MASK;
+    debounced = raw;
+
+    for (uint8_t bit = 1; bit & BUTTON_EVENT_MASK; bit <<= 1)
+      if (changed & bit)
+        pushEvent((raw & bit) ? BTN_EVENT_PRESS : BTN_EVENT_RELEASE, bit, 0);
+
+    if (changed) {
+      heldTicks = 0;
+      repeatTicks = 0;
+      repeatCount = 0;
+    }
+    return;
+  }
+
+  uint8_t held = debounced & BUTTON_EVENT_MASK;
+  if (!held)
+    return;
+
+  if (heldTicks < 0xFFFF)
+    heldTicks++;
+
+  if (held == BUTTON_CHORD_MASK) {
+    if (heldTicks == BUTTON_CHORD_TICKS)
+      pushEvent(BTN_EVENT_CHORD, held, 0);
+    return;
+  }
+
+  /* Long presses and repeats are only for a single button */
+  if (held & (held - 1))
+    return;
+
+  if (heldTicks == BUTTON_LONG_PRESS_TICKS)
+    pushEvent(BTN_EVENT_LONG, held, 0);
+
+  if (!(held & BUTTON_REPEAT_MASK))
+    return;
+
+  if (heldTicks == BUTTON_REPEAT_DELAY_TICKS)
+    repeatTicks = 1;
+
+  if (repeatTicks && --repeatTicks == 0) {
+    if (repeatCount < 0xFF)
+      repeatCount++;
+    pushEvent(BTN_EVENT_REPEAT, held, repeatCount);
+    repeatTicks = (repeatCount < BUTTON_REPEAT_FAST_AFTER) ? BUTTON_REPEAT_TICKS
+                                                           : BUTTON_REPEAT_FAST_TICKS;
+  }
+}
+
+uint8_t buttonsState() {
+  return debounced;
+}
+
+bool buttonsGetEvent(OUT button_event *ev) {
+  bool found = false;
+  uint8_t oldSREG = SREG;
+  cli();
+  uint8_t tail = queueTail;
+  if (tail != queueHead) {
+    *ev = queue[tail];
+    queueTail = (tail + 1) & (BUTTON_EVENT_QUEUE_SIZE - 1);
+    found = true;
+  }
+  SREG = oldSREG;
+  return found;
+}
+
+bool buttonsEventPending() {
+  return queueTail != queueHead;
+}
+
+uint8_t buttonsClicked(IN const button_event *ev) {
+  if (ev->type == BTN_EVENT_PRESS || ev->type == BTN_EVENT_REPEAT)
+    return ev->buttons;
+  return 0;
+}
@@ -0,0 +1,81 @@
+#ifndef buttons_h
+#define buttons_h
+#ifdef __cplusplus
+
+#include "common.h"
+
+/* The buttons are sampled from the 10ms Timer1 ISR. A button changes
+ * state only after it has read the same for BUTTON_DEBOUNCE_TICKS
+ * samples in a row, and every change is put as an event in a queue
+ * that loop() consumes with buttonsGetEvent().
+ *
+ * All the timings below are in ticks of BUTTON_TICK_MS.
+ */
+#define BUTTON_TICK_MS 10
+#define BUTTON_DEBOUNCE_TICKS 3         // 30ms
+#define BUTTON_LONG_PRESS_TICKS 100     // 1s
+#define BUTTON_REPEAT_DELAY_TICKS 50    // The first repeat comes 500ms after the press
+#define BUTTON_REPEAT_TICKS 25          // then one every 250ms,
+#define BUTTON_REPEAT_FAST_TICKS 10     // and one every 100ms after
+#define BUTTON_REPEAT_FAST_AFTER 10     // this many repeats
+#define BUTTON_CHORD_TICKS 450          // UP and DOWN together for 4.5s
+
+#define BUTTON_EVENT_QUEUE_SIZE 8       // Must be a power of 2
+
+/* Only these buttons generate events. The float switch is a state,
+ * read it with buttonsState() */
+#define BUTTON_EVENT_MASK (BTN_BACK | BTN_OK | BTN_DOWN | BTN_UP)
+/* Only these buttons repeat while they are held down */
+#define BUTTON_REPEAT_MASK (BTN_DOWN | BTN_UP)
+#define BUTTON_CHORD_MASK (BTN_DOWN | BTN_UP)
+
+typedef enum _button_event_type {
+  BTN_EVENT_PRESS = 0,
+  BTN_EVENT_RELEASE,
+  BTN_EVENT_LONG,     // Held alone for BUTTON_LONG_PRESS_TICKS. Sent once per press.
+  BTN_EVENT_REPEAT,   // Held alone, sent every BUTTON_REPEAT_TICKS
+  BTN_EVENT_CHORD     // All the buttons of BUTTON_CHORD_MASK held for BUTTON_CHORD_TICKS
+} button_event_type;
+
+typedef struct _button_event {
+  uint8_t type;    // One of button_event_type
+  uint8_t buttons; // push_buttons bit(s) of the event
+  uint8_t repeats; // 1, 2, 3... for BTN_EVENT_REPEAT (saturates at 255), otherwise 0
+} button_event;
+
+/***f* buttonsTick
+ *
+ * Call from the 10ms Timer1 ISR with the raw value of readButtons().
+ * Debounces the buttons and queues the events.
+ */
+void buttonsTick(IN uint8_t raw);
+
+/***f* buttonsState
+ *
+ * Returns the debounced state of the buttons and the float switch,
+ * in the same format as readButtons().
+ */
+uint8_t buttonsState();
+
+/***f* buttonsGetEvent
+ *
+ * Takes the oldest event from the queue. Returns false
+ * if the queue is empty.
+ */
+bool buttonsGetEvent(OUT button_event *ev);
+
+/***f* buttonsEventPending
+ *
+ * Returns true if the queue has an event, without taking it.
+ */
+bool buttonsEventPending();
+
+/***f* buttonsClicked
+ *
+ * Returns the buttons that the event asks to act upon:
+ * the button of a press or repeat, 0 for any other event.
+ */
+uint8_t buttonsClicked(IN const button_event *ev);
+
+#endif // endif __cpluscplus
+#endif // endif buttons_h
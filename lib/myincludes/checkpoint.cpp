@@ -0,0 +1,150 @@
+#include "checkpoint.h"
+#include "eeprom_layout.h"
+#include "eeprom_log.h"
+#include "settings.h"
+#include "temperature.h"
+#include "metrics.h"
+#include "NetEEPROM.h"
+#include <util/crc16.h>
+
+#define CHECKPOINT_RAM_MAGIC 0x4350 // "CP"
+
+static_assert(sizeof(cook_checkpoint) + EEPROM_LOG_OVERHEAD <= CHECKPOINT_SLOT_SIZE,
+              "The checkpoint doesn't fit in a slot. Increase CHECKPOINT_SLOT_SIZE.");
+static_assert(EEPROM_CHECKPOINT_SIZE / CHECKPOINT_SLOT_SIZE >= 2,
+              "The checkpoints need at least two slots");
+static_assert(EEPROM_CHECKPOINT_ADDR >= EEPROM_SETTINGS_ADDR + EEPROM_SETTINGS_SIZE &&
+              EEPROM_CHECKPOINT_ADDR + EEPROM_CHECKPOINT_SIZE <= NET_EEPROM_OFFSET,
+              "The checkpoints overlap with another EEPROM region");
+
+/* Defined in main.cpp. Updated by the Timer1 ISR. */
+extern double pidIntegral;
+
+typedef struct _ram_checkpoint {
+  uint16_t magic;
+  cook_checkpoint cp;
+  uint16_t crc;           // CRC-16 of everything above
+} ram_checkpoint;
+
+/* Not cleared at boot */
+static ram_checkpoint ramCheckpoint __attribute__((section(".noinit")));
+
+static uint8_t logBuffer[CHECKPOINT_SLOT_SIZE];
+static eeprom_log checkpointLog = EEPROM_LOG(EEPROM_CHECKPOINT_ADDR, EEPROM_CHECKPOINT_SIZE,
+                                             CHECKPOINT_SLOT_SIZE, logBuffer);
+
+static bool wasOn = false;
+static unsigned long cookStart = 0;       // millis() when the device was turned on
+static uint32_t cookElapsedBase = 0;      // Seconds before the resume
+static unsigned long lastRamCheckpoint = 0;
+static unsigned long lastEepromCheckpoint = 0;
+
+static uint16_t ramCrc() {
+  uint16_t crc = 0xFFFF;
+  const uint8_t *p = (const uint8_t *)&ramCheckpoint;
+
+  for (uint8_t i = 0; i < offsetof(ram_checkpoint, crc); i++)
+    crc = _crc16_update(crc, p[i]);
+
+  return crc;
+}
+
+bool checkpointInit(OUT cook_checkpoint *cp) {
+  cook_checkpoint stored;
+  uint8_t version;
+  bool found = false;
+
+  /* Always load the log, so that the next record goes after the newest */
+  memset(&stored, 0, sizeof(stored));
+  if (eepromLogLoad(&checkpointLog, &stored, sizeof(stored), &version) &&
+      version == CHECKPOINT_VERSION) {
+    *cp = stored;
+    found = true;
+  }
+
+  /* The RAM checkpoint is never older than the EEPROM one */
+  if (ramCheckpoint.magic == CHECKPOINT_RAM_MAGIC && ramCheckpoint.crc == ramCrc()) {
+    *cp = ramCheckpoint.cp;
+    found = true;
+    Serial.println(F("Checkpoint: found in RAM"));
+  }
+  ramCheckpoint.magic = 0;
+
+  if (!found || !cp->on)
+    return false;
+
+  /* Whether the cook resumes or not, it was on. If it doesn't resume,
+   * the first checkpointTask() records that it is off now. */
+  wasOn = true;
+  cookStart = millis();
+  cookElapsedBase = cp->elapsed_s;
+
+  uint8_t window = settingsGet()->resume_window;
+  if (window == 0) {
+    Serial.println(F("Checkpoint: resuming is disabled"));
+    return false;
+  }
+  if (cp->setpoint < MIN_TEMPERATURE || cp->setpoint > MAX_TEMPERATURE)
+    return false;
+  if ((cp->setpoint - current_temperature) * 10 > window) {
+    Serial.println(F("Checkpoint: the water has cooled down. Not resuming."));
+    return false;
+  }
+
+  Serial.println(F("Checkpoint: resuming the cook"));
+  return true;
+}
+
+/***f* takeCheckpoint
+ *
+ * Fills 'cp' with the current state of the cook.
+ */
+static void takeCheckpoint(OUT cook_checkpoint *cp,
+                           IN bool on) {
+  cp->on = on;
+  cp->elapsed_s = checkpointCookSeconds();
+
+  /* Both are 4 byte doubles that the Timer1 ISR changes */
+  uint8_t oldSREG = SREG;
+  cli();
+  cp->setpoint = desired_temperature;
+  cp->pid_integral = pidIntegral;
+  SREG = oldSREG;
+
+  programSaveState(&cp->program);
+}
+
+void checkpointTask(IN bool on) {
+  unsigned long now = millis();
+  bool changed = (on != wasOn);
+
+  if (eepromLogTask(&checkpointLog))
+    metricsIncrement(METRIC_CHECKPOINT_WRITES);
+
+  if (changed && on) {
+    cookStart = now;
+    cookElapsedBase = 0;
+  }
+  wasOn = on;
+
+  if (!changed && now - lastRamCheckpoint < CHECKPOINT_RAM_PERIOD_MS)
+    return;
+
+  lastRamCheckpoint = now;
+  takeCheckpoint(&ramCheckpoint.cp, on);
+  ramCheckpoint.magic = CHECKPOINT_RAM_MAGIC;
+  ramCheckpoint.crc = ramCrc();
+
+  /* While off, only the moment of turning off is recorded */
+  if (changed || (on && now - lastEepromCheckpoint >= CHECKPOINT_EEPROM_PERIOD_MS)) {
+    lastEepromCheckpoint = now;
+    eepromLogAppend(&checkpointLog, &ramCheckpoint.cp, sizeof(cook_checkpoint),
+                    CHECKPOINT_VERSION);
+  }
+}
+
+uint32_t checkpointCookSeconds() {
+  if (!wasOn)
+    return 0;
+  return cookElapsedBase + (millis() - cookStart) / 1000;
+}
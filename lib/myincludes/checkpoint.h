@@ -0,0 +1,60 @@
+#ifndef checkpoint_h
+#define checkpoint_h
+#ifdef __cplusplus
+
+#include "common.h"
+#include "program.h"
+
+/* Checkpoints of a running cook, so that it continues after a reset.
+ *
+ * A checkpoint is kept in .noinit RAM, which the C runtime doesn't
+ * clear, so it survives software_Reset() and the watchdog. It is
+ * refreshed every CHECKPOINT_RAM_PERIOD_MS. Every
+ * CHECKPOINT_EEPROM_PERIOD_MS while cooking, and whenever the device is
+ * turned on or off, it is also appended to a log in the EEPROM (see
+ * eeprom_log.h), which survives a power loss.
+ *
+ * At boot the RAM checkpoint is used if its CRC is good, and the EEPROM
+ * one otherwise. There is no clock that runs while the power is off, so
+ * the water temperature tells if the interruption was short: the cook
+ * resumes only if the water is still within the resume_window setting
+ * below the setpoint.
+ */
+#define CHECKPOINT_VERSION 1
+#define CHECKPOINT_SLOT_SIZE 96
+#define CHECKPOINT_RAM_PERIOD_MS 1000
+#define CHECKPOINT_EEPROM_PERIOD_MS 60000
+
+typedef struct _cook_checkpoint {
+  bool on;                    // The device was cooking
+  float setpoint;             // desired_temperature
+  float pid_integral;         // The integral term of the PID, for a bumpless restart
+  uint32_t elapsed_s;         // Since the device was turned on
+  program_checkpoint program;
+} cook_checkpoint;
+
+/***f* checkpointInit
+ *
+ * Finds the newest checkpoint and returns true if it is a cook that
+ * should be resumed. Call from setup() after settingsInit(), once
+ * current_temperature has a reading, and before the PID is put in
+ * AUTOMATIC mode.
+ */
+bool checkpointInit(OUT cook_checkpoint *cp);
+
+/***f* checkpointTask
+ *
+ * Call from loop() with whether the device is on. Takes the
+ * checkpoints and writes them in the EEPROM a byte at a time.
+ */
+void checkpointTask(IN bool on);
+
+/***f* checkpointCookSeconds
+ *
+ * Returns the seconds since the device was turned on, counting the
+ * time before a resume, or 0 if it is off.
+ */
+uint32_t checkpointCookSeconds();
+
+#endif // endif __cpluscplus
+#endif // endif checkpoint_h
@@ -5,34 +5,37 @@
 #include "Arduino.h"
 #include "elapsedMillis.h"
 
-/* Includes for the LCD */
-#include <Wire.h>
-#include <LiquidCrystal_I2C.h>
-
 #define IN  // Use for marking a function parameter if it is an input
 #define OUT // Use for marking a function parameter if it is an output
 
 #define DEBUG 1
+#ifndef PROFILING
+#define PROFILING 0 // Set to 1 to compile in the loop profiler (see profiler.h)
+#endif
+#ifndef TRACING
+#define TRACING 0   // Set to 1 to record the inputs for tools/replay (see trace.h)
+#endif
+
+/* The pins, sensors and LCD of the enclosure that we build for */
+#include "board.h"
 
 /* Define the pin number where different hardware
- * components are connected to
+ * components are connected to. All of them come from the
+ * board description in board.h
  */
-#define RGB_LED_B 2 // must be connected on a PWM pin
-#define RGB_LED_G 4 // must be connected on a PWM pin
-#define RGB_LED_R 6 // must be connected on a PWM pin
-#define SSR_PIN 8   // Solid State Relay must be connected on a PWM pin
-#define FLOAT_SWITCH_PIN 22
-#define PUMPRELAY_PIN 24
-#define TEMP_SENSOR_1_PIN 32   // Temperature sensor Front 1
-#define TEMP_SENSOR_2_PIN 34   // Temperature sensor Front 2
-#define TEMP_SENSOR_3_PIN 36   // Temperature sensor Rear 1
-#define TEMP_SENSOR_4_PIN 38   // Temperature sensor Rear 2
-#define PUSH_BTN_MENU_BACK_PIN 40
-#define PUSH_BTN_MENU_OK_PIN 42
-#define PUSH_BTN_MENU_DOWN_PIN 44
-#define PUSH_BTN_MENU_UP_PIN 46
-
-#define LCD_I2C_ADDR 0x27
+constexpr uint8_t RGB_LED_R = BOARD.rgb_led_pins[0];
+constexpr uint8_t RGB_LED_G = BOARD.rgb_led_pins[1];
+constexpr uint8_t RGB_LED_B = BOARD.rgb_led_pins[2];
+constexpr uint8_t SSR_PIN = BOARD.ssr_pin;
+constexpr uint8_t PUMPRELAY_PIN = BOARD.pump_relay_pin;
+constexpr uint8_t PUSH_BTN_MENU_BACK_PIN = BOARD.button_pins[0];
+constexpr uint8_t PUSH_BTN_MENU_OK_PIN = BOARD.button_pins[1];
+constexpr uint8_t PUSH_BTN_MENU_DOWN_PIN = BOARD.button_pins[2];
+constexpr uint8_t PUSH_BTN_MENU_UP_PIN = BOARD.button_pins[3];
+constexpr uint8_t FLOAT_SWITCH_PIN = BOARD.button_pins[4];
+
+constexpr uint8_t LCD_I2C_ADDR = BOARD.lcd_i2c_addr;
+/* The pins of the PCF8574 I2C expander of the LCD module */
 #define LCD_BACKLIGHT_PIN 3
 #define LCD_RS_PIN 0
 #define LCD_RW_PIN 1
@@ -42,11 +45,14 @@
 #define LCD_D6_PIN 6
 #define LCD_D7_PIN 7
 
+/* Include the LCD driver after the pins of the expander are defined */
+#include "lcd_twi.h"
+
 #define LCD_ON HIGH
 #define LCD_OFF LOW
 
-#define LCD_COLS 16 // Change this if your LCD has more columns
-#define LCD_ROWS 2  // Change this if your LCD has more rows
+constexpr uint8_t LCD_COLS = BOARD.lcd_cols; // Change lcd_cols in board.h if your LCD has more columns
+constexpr uint8_t LCD_ROWS = BOARD.lcd_rows; // Change lcd_rows in board.h if your LCD has more rows
 #define LCD_COLS_CHAR_LIMIT (LCD_COLS + 1)  // The LCD can print X chars, but a predefined string
                                             //in C has X+1 char because of the termination character
 
@@ -72,7 +78,8 @@ extern const uint8_t RGB_LED_VIOLET[3];
 extern const uint8_t RGB_LED_CYAN[3];
 extern const uint8_t RGB_LED_OFF[3];
 
-extern LiquidCrystal_I2C lcd;
+class LcdTwi;
+extern LcdTwi lcd;
 
 /***f* software_Reset
  *
@@ -86,6 +93,13 @@ void software_Reset();
  */
 void pump_operate(IN bool on);
 
+/***f* pump_is_on
+ *
+ * Returns true if the pump was turned on by the last
+ * call of pump_operate()
+ */
+bool pump_is_on();
+
 /***f* ssr_operate
  *
  * Turns on/off the solid state relay.
@@ -114,10 +128,12 @@ static void _setRgbLedColor(IN uint8_t R,
  */
 void setRgbLed(IN const uint8_t* RGB);
 
-/***f*
+/***f* readButtons
  *
  * Reads all the input buttons plus the floating switch
- * that essentially works as a button.
+ * that essentially works as a button. The reading is not
+ * debounced: it is only called from the Timer1 ISR, everything
+ * else uses buttonsState() and the events of buttons.h.
  */
 uint8_t readButtons();
 
@@ -143,24 +159,5 @@ bool isLcdBacklightOn();
  */
 void setLcdBacklight(IN uint8_t backlight_on);
 
-/***f* printLcdLine
- *
- * I do not want to use the lcd.clear() function because it is very
- * slow, so what I do is to pass the char array that needs to be printed
- * in this function, the string is printed and filled until the end of
- * each line with white spaces.
- *
- * If we want to print only one line of the string, then choose the line
- * with the printLineNo parameter. The first line is 1, 2nd line is 2 and
- * so on. When printLineNo == 0, all lines in the str array will be printed
- *
- * Whenever you call this function call like like this:
- *
- * char *str[LCD_ROWS] = {"Press the \"OK\"", "button to start"};
- * printLcdLine(str);
- */
-void printLcdLine(IN const char * const str[LCD_ROWS],
-                  IN uint8_t printLineNo = 0);
-
 #endif // endif __cpluscplus
 #endif // endif common_h
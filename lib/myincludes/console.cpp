@@ -0,0 +1,47 @@
+#include "console.h"
+#include "profiler.h"
+#include "memory.h"
+#include "trace.h"
+
+static void printHelp() {
+  Serial.println(F("Commands:"));
+  Serial.println(F("  h  this help"));
+  Serial.println(F("  m  print the heap/stack figures"));
+  Serial.println(F("  p  print the loop profile"));
+  Serial.println(F("  r  reset the loop profile"));
+#if TRACING
+  Serial.println(F("  t  print the recorded trace (binary)"));
+  Serial.println(F("  T  stream the trace instead of the log"));
+#endif
+}
+
+void processSerialCommands() {
+  while (Serial.available() > 0) {
+    switch (Serial.read()) {
+      case 'h':
+        printHelp();
+        break;
+      case 'm':
+        memoryPrint(Serial);
+        break;
+      case 'p':
+        profilePrint(Serial);
+        break;
+      case 'r':
+        profileReset();
+        Serial.println(F("Profile reset"));
+        break;
+#if TRACING
+      case 't':
+        tracePrint(Serial, 0, traceSize());
+        break;
+      case 'T':
+        traceStream();
+        break;
+#endif
+      default:
+        /* Ignore new lines and unknown commands */
+        break;
+    }
+  }
+}
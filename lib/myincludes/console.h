@@ -0,0 +1,24 @@
+#ifndef console_h
+#define console_h
+#ifdef __cplusplus
+
+#include "common.h"
+
+/***f* processSerialCommands
+ *
+ * Reads the commands that are received over the serial port and
+ * executes them. Every command is a single character:
+ *
+ *   h  Print the list of the available commands
+ *   m  Print the heap/stack figures
+ *   p  Print the loop profile (min/avg/max/count per stage)
+ *   r  Reset the loop profile
+ *   t  Print the recorded trace, in binary (with TRACING, see trace.h)
+ *   T  Stream the trace to the serial port from now on (with TRACING)
+ *
+ * Call it from loop(). It doesn't block if nothing has been received.
+ */
+void processSerialCommands();
+
+#endif // endif __cpluscplus
+#endif // endif console_h
@@ -0,0 +1,101 @@
+#include "controller.h"
+
+/* Only touched from the Timer1 ISR, or with the interrupts disabled */
+static double kp = 0, ki = 0, kd = 0;
+static double integral = 0;
+static double lastInput = 0;
+static double inputRate = 0;        // Celsius per second, filtered
+static unsigned long lastAt_ms = 0;
+static bool haveLast = false;       // lastInput and lastAt_ms are valid
+static uint8_t mode = CONTROLLER_AUTOMATIC;
+static uint8_t applied = 0;         // The output of the last tick
+static controller_terms terms;
+
+static double clampOutput(IN double value) {
+  if (value > CONTROLLER_OUTPUT_MAX)
+    return CONTROLLER_OUTPUT_MAX;
+  if (value < CONTROLLER_OUTPUT_MIN)
+    return CONTROLLER_OUTPUT_MIN;
+  return value;
+}
+
+void controllerSetTunings(IN double p,
+                          IN double i,
+                          IN double d) {
+  if (p < 0 || i < 0 || d < 0)
+    return;
+  kp = p;
+  ki = i;
+  kd = d;
+}
+
+void controllerStart(IN double integral_term) {
+  mode = CONTROLLER_AUTOMATIC;
+  integral = clampOutput(integral_term);
+  inputRate = 0;
+  haveLast = false;
+  terms.output = integral;
+  terms.p = 0;
+  terms.i = integral;
+  terms.d = 0;
+}
+
+void controllerSetMode(IN uint8_t new_mode) {
+  /* Bumpless: the integral term already follows the applied output */
+  mode = new_mode;
+}
+
+void controllerTrack(IN uint8_t output) {
+  applied = output;
+  if (mode == CONTROLLER_MANUAL)
+    integral = clampOutput(output);
+}
+
+void controllerSample(IN double input,
+                      IN double setpoint,
+                      IN unsigned long at_ms) {
+  double error = setpoint - input;
+
+  if (haveLast) {
+    long dt_ms = at_ms - lastAt_ms;
+
+    if (dt_ms <= 0)
+      return;
+    if (dt_ms <= CONTROLLER_DT_MAX_MS) {
+      double dt = dt_ms / 1000.0;
+      /* First-order low-pass filter of the slope, discretized with
+       * the actual dt */
+      inputRate += ((input - lastInput) / dt - inputRate) *
+                   dt_ms / (CONTROLLER_D_FILTER_MS + dt_ms);
+      /* Conditional integration: not further into the saturation */
+      double next = integral + ki * error * dt;
+      double output = kp * error + next - kd * inputRate;
+      if (mode == CONTROLLER_AUTOMATIC &&
+          !(output > CONTROLLER_OUTPUT_MAX && error > 0) &&
+          !(output < CONTROLLER_OUTPUT_MIN && error < 0))
+        integral = clampOutput(next);
+    } else {
+      /* The slope across a gap means nothing */
+      inputRate = 0;
+    }
+  }
+  lastInput = input;
+  lastAt_ms = at_ms;
+  haveLast = true;
+
+  terms.p = kp * error;
+  terms.i = integral;
+  terms.d = -kd * inputRate;
+  if (mode == CONTROLLER_AUTOMATIC)
+    terms.output = clampOutput(terms.p + terms.i + terms.d);
+  else
+    terms.output = applied;
+}
+
+uint8_t controllerOutput() {
+  return terms.output;
+}
+
+void controllerGetTerms(OUT controller_terms *t) {
+  *t = terms;
+}
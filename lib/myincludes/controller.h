@@ -0,0 +1,104 @@
+#ifndef controller_h
+#define controller_h
+#ifdef __cplusplus
+
+#include "common.h"
+
+/* The PID controller of the heater. It runs once per temperature sample
+ * (see temperatureTakeSample() in temperature.h), with the time between
+ * the conversions of the samples as dt, instead of on a clock of its own
+ * that mostly recomputes the same sample:
+ *  - the proportional term acts on the error,
+ *  - the integral term is clamped to the output range, and doesn't
+ *    grow while the output is saturated in the direction of the error
+ *    (conditional integration), so that it doesn't wind up while the
+ *    heater is at full power,
+ *  - the derivative term acts on the measurement, so that a setpoint
+ *    change doesn't kick it, through a first-order low-pass filter,
+ *    because the 1/16 Celsius steps of the DS18B20 turn into spikes.
+ *
+ * While the heater is kept off (the device is off, out of the water,
+ * in devMode or faulted) the controller is in CONTROLLER_MANUAL: it
+ * follows the samples, and its integral term follows the output that
+ * is applied (controllerTrack()). Back in CONTROLLER_AUTOMATIC it
+ * continues from there: the integral term isn't stale or wound up,
+ * and the derivative term has no step to kick on.
+ *
+ * The tunings are those of the PID library that it replaces: ki per
+ * second and kd in seconds, so the stored settings still apply.
+ */
+#define CONTROLLER_OUTPUT_MIN 0
+#define CONTROLLER_OUTPUT_MAX 255      // The duty cycle of the SSR, as ssr_operate() takes it
+#define CONTROLLER_D_FILTER_MS 1500    // The time constant of the derivative filter
+#define CONTROLLER_DT_MAX_MS 5000      // A longer gap between two samples (a sensor that
+                                       // dropped out, the heater off) restarts dt
+
+typedef enum _controller_mode {
+  CONTROLLER_MANUAL = 0,   // The output isn't applied. Follow the one that is.
+  CONTROLLER_AUTOMATIC     // The output is applied
+} controller_mode;
+
+/* The output of the last computation and its terms */
+typedef struct _controller_terms {
+  double output;
+  double p, i, d;
+} controller_terms;
+
+/***f* controllerSetTunings
+ *
+ * Sets the tunings. Negative tunings are ignored. The Timer1 ISR
+ * computes with them, so call with the interrupts disabled.
+ */
+void controllerSetTunings(IN double kp,
+                          IN double ki,
+                          IN double kd);
+
+/***f* controllerStart
+ *
+ * Starts the controller in CONTROLLER_AUTOMATIC with 'integral' as the
+ * integral term, e.g. the checkpointed one of an interrupted cook, and
+ * that as its output until the first sample arrives. The first sample
+ * only starts dt.
+ */
+void controllerStart(IN double integral);
+
+/***f* controllerSetMode
+ *
+ * Call from the Timer1 ISR with the controller_mode of every tick. The
+ * switch to CONTROLLER_AUTOMATIC starts from the output that was last
+ * applied.
+ */
+void controllerSetMode(IN uint8_t mode);
+
+/***f* controllerTrack
+ *
+ * Call from the Timer1 ISR with the output that is applied to the SSR
+ * in this tick, whatever the mode.
+ */
+void controllerTrack(IN uint8_t applied);
+
+/***f* controllerSample
+ *
+ * Call from the Timer1 ISR for every new sample: 'input' was converted
+ * at 'at_ms' (millis()), in either mode. Computes the output for
+ * 'setpoint'. A sample that isn't newer than the previous one is
+ * ignored.
+ */
+void controllerSample(IN double input,
+                      IN double setpoint,
+                      IN unsigned long at_ms);
+
+/***f* controllerOutput
+ *
+ * Returns the output of the last computation, as ssr_operate() takes it.
+ */
+uint8_t controllerOutput();
+
+/***f* controllerGetTerms
+ *
+ * Copies the output of the last computation and its terms into 't'.
+ */
+void controllerGetTerms(OUT controller_terms *t);
+
+#endif // endif __cpluscplus
+#endif // endif controller_h
@@ -0,0 +1,26 @@
+#ifndef eeprom_layout_h
+#define eeprom_layout_h
+#ifdef __cplusplus
+
+#include "common.h"
+
+/* Where everything is stored in the 4KB EEPROM of the Mega 2560.
+ *
+ * NetEEPROM keeps the network configuration in the last
+ * EEPROM_NET_SIZE bytes (NET_EEPROM_OFFSET). Every other user of the
+ * EEPROM gets a fixed region here, and checks with a static_assert
+ * that what it stores fits in it.
+ */
+#define EEPROM_PRESETS_ADDR 0
+#define EEPROM_PRESETS_SIZE 512
+
+#define EEPROM_SETTINGS_ADDR 512
+#define EEPROM_SETTINGS_SIZE 1024
+
+#define EEPROM_CHECKPOINT_ADDR 1536
+#define EEPROM_CHECKPOINT_SIZE 1536
+
+#define EEPROM_NET_SIZE 32
+
+#endif // endif __cpluscplus
+#endif // endif eeprom_layout_h
@@ -0,0 +1,115 @@
+#include "eeprom_log.h"
+#include "EEPROM.h"
+#include <util/crc16.h>
+
+static uint16_t slotAddr(IN const eeprom_log *log,
+                         IN uint8_t slot) {
+  return log->addr + slot * log->slot_size;
+}
+
+/***f* readSlot
+ *
+ * Reads the header of the slot and checks the CRC of the record.
+ */
+static bool readSlot(IN const eeprom_log *log,
+                     IN uint8_t slot,
+                     OUT eeprom_log_header *header) {
+  uint16_t addr = slotAddr(log, slot);
+  uint8_t *h = (uint8_t *)header;
+  uint16_t crc = 0xFFFF;
+
+  for (uint8_t i = 0; i < sizeof(eeprom_log_header); i++) {
+    h[i] = EEPROM.read(addr + i);
+    crc = _crc16_update(crc, h[i]);
+  }
+
+  if (header->size == 0 || header->size > log->slot_size - EEPROM_LOG_OVERHEAD)
+    return false;
+
+  addr += sizeof(eeprom_log_header);
+  for (uint8_t i = 0; i < header->size; i++)
+    crc = _crc16_update(crc, EEPROM.read(addr + i));
+
+  uint16_t stored = EEPROM.read(addr + header->size) |
+                    (EEPROM.read(addr + header->size + 1) << 8);
+  return crc == stored;
+}
+
+bool eepromLogLoad(OUT eeprom_log *log,
+                   OUT void *data,
+                   IN uint8_t size,
+                   OUT uint8_t *version) {
+  eeprom_log_header header;
+  uint8_t size_found = 0;
+  bool found = false;
+
+  for (uint8_t slot = 0; slot < log->slots; slot++) {
+    if (!readSlot(log, slot, &header))
+      continue;
+    if (found && header.sequence <= log->last_sequence)
+      continue;
+
+    found = true;
+    log->last_slot = slot;
+    log->last_sequence = header.sequence;
+    size_found = header.size;
+    *version = header.version;
+  }
+
+  if (!found)
+    return false;
+
+  uint16_t addr = slotAddr(log, log->last_slot) + sizeof(eeprom_log_header);
+  uint8_t *d = (uint8_t *)data;
+  for (uint8_t i = 0; i < size_found && i < size; i++)
+    d[i] = EEPROM.read(addr + i);
+  return true;
+}
+
+void eepromLogAppend(OUT eeprom_log *log,
+                     IN const void *data,
+                     IN uint8_t size,
+                     IN uint8_t version) {
+  eeprom_log_header header;
+  uint16_t crc = 0xFFFF;
+
+  /* An unfinished record is overwritten in its slot. The record
+   * before it stays the current one until this one is complete. */
+  if (!log->write_len)
+    log->last_slot = (log->last_slot + 1) % log->slots;
+
+  header.sequence = ++log->last_sequence;
+  header.version = version;
+  header.size = size;
+
+  memcpy(log->buffer, &header, sizeof(header));
+  memcpy(log->buffer + sizeof(header), data, size);
+  log->write_len = sizeof(header) + size;
+  for (uint8_t i = 0; i < log->write_len; i++)
+    crc = _crc16_update(crc, log->buffer[i]);
+  log->buffer[log->write_len++] = crc & 0xFF;
+  log->buffer[log->write_len++] = crc >> 8;
+  log->write_pos = 0;
+}
+
+bool eepromLogTask(OUT eeprom_log *log) {
+  if (!log->write_len)
+    return false;
+
+  /* eeprom_write_byte() waits for the previous write to finish.
+   * Don't let it. */
+  if (!eeprom_is_ready())
+    return false;
+
+  EEPROM.update(slotAddr(log, log->last_slot) + log->write_pos,
+                log->buffer[log->write_pos]);
+  if (++log->write_pos < log->write_len)
+    return false;
+
+  log->write_len = 0;
+  return true;
+}
+
+bool eepromLogBusy(IN const eeprom_log *log) {
+  return log->write_len != 0;
+}
@@ -0,0 +1,85 @@
+#ifndef eeprom_log_h
+#define eeprom_log_h
+#ifdef __cplusplus
+
+#include "common.h"
+
+/* An append-only log of records in an EEPROM region, for data that is
+ * rewritten often. The region is split in slots of the same size and
+ * every record goes to the slot after the previous one, so the writes
+ * are spread over all the slots.
+ *
+ * A record is a header (sequence number, version and size of the
+ * data), the data and a CRC-16 of both. The valid record with the
+ * highest sequence number is the current one. A record that a reset
+ * cuts in half has a bad CRC, so the one before it is used instead.
+ *
+ * Records are written one byte per eepromLogTask() call, and only when
+ * the EEPROM is ready, so the loop never waits the 3.3ms of a byte
+ * write. Several logs can be written at the same time.
+ */
+typedef struct _eeprom_log_header {
+  uint32_t sequence;  // Increased on every record. The highest one is the newest.
+  uint8_t version;    // The version of the data
+  uint8_t size;       // The size of the data
+} eeprom_log_header;
+
+#define EEPROM_LOG_OVERHEAD (sizeof(eeprom_log_header) + sizeof(uint16_t))
+
+typedef struct _eeprom_log {
+  uint16_t addr;          // The first byte of the region
+  uint8_t slots;
+  uint8_t slot_size;      // At least the largest record
+  uint8_t *buffer;        // slot_size bytes for the record that is being written
+
+  uint8_t last_slot;      // The slot of the current record
+  uint32_t last_sequence;
+  uint8_t write_pos;      // The next byte of buffer to write
+  uint8_t write_len;      // 0 when idle
+} eeprom_log;
+
+/* Initializer for an eeprom_log variable */
+#define EEPROM_LOG(addr, size, slot_size, buffer) \
+  {(addr), (uint8_t)((size) / (slot_size)), (slot_size), (buffer), \
+   (uint8_t)((size) / (slot_size) - 1), 0, 0, 0}
+
+/***f* eepromLogLoad
+ *
+ * Finds the current record of the log and copies its data in 'data'.
+ * If the record is shorter than 'size' (written by an older version),
+ * the rest of 'data' isn't touched, and if it is longer it is cut.
+ * Returns false if the log has no valid record.
+ * Call once before appending to the log.
+ */
+bool eepromLogLoad(OUT eeprom_log *log,
+                   OUT void *data,
+                   IN uint8_t size,
+                   OUT uint8_t *version);
+
+/***f* eepromLogAppend
+ *
+ * Starts writing 'data' as a new record in the next slot. The data is
+ * copied, so it can change right after the call. If a record is
+ * already being written, it is abandoned and the new one takes its
+ * slot.
+ */
+void eepromLogAppend(OUT eeprom_log *log,
+                     IN const void *data,
+                     IN uint8_t size,
+                     IN uint8_t version);
+
+/***f* eepromLogTask
+ *
+ * Writes the next byte of the record if the EEPROM is ready. Returns
+ * true when the last byte of a record has just been written.
+ */
+bool eepromLogTask(OUT eeprom_log *log);
+
+/***f* eepromLogBusy
+ *
+ * Returns true while a record is being written.
+ */
+bool eepromLogBusy(IN const eeprom_log *log);
+
+#endif // endif __cpluscplus
+#endif // endif eeprom_log_h
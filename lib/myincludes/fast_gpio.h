@@ -0,0 +1,84 @@
+#ifndef fast_gpio_h
+#define fast_gpio_h
+#ifdef __cplusplus
+
+#include "common.h"
+#include "avr_pins.h"
+
+/* For the registers below 0x40 (the lower I/O space) a read-modify-write
+ * of a single bit compiles to one sbi/cbi instruction. Above that
+ * (ports H - L) it takes lds/ori/sts and an interrupt in the middle could
+ * undo a write of the ISR to the same port. */
+#define AVR_SBI_SPACE_END 0x40
+
+/* Digital I/O on a pin that is known at compile time.
+ *
+ * digitalRead()/digitalWrite() look up the timer, the port and the bit
+ * of the pin in flash on every call. Here they are template constants,
+ * so read() compiles to a load and a bit test and write() to a single
+ * sbi/cbi for the pins of the ports A - G.
+ *
+ * Unlike digitalWrite(), write() doesn't turn off the PWM of the pin,
+ * so don't use it on pins that are driven with analogWrite().
+ */
+template <uint8_t Pin>
+struct FastGpio {
+  static_assert(avrPinValid(Pin), "FastGpio: the pin doesn't exist on the Mega 2560");
+
+  static constexpr uint8_t mask = avrPinBit(Pin);
+
+  /***f* readPort
+   *
+   * Returns the whole PINx register of the pin, so that several pins
+   * of the same port can be tested with one read.
+   */
+  static inline uint8_t readPort() {
+    return _SFR_MEM8(avrPinInputReg(Pin));
+  }
+
+  static inline bool read() {
+    return readPort() & mask;
+  }
+
+  static inline void write(IN bool high) {
+    if (avrPinOutputReg(Pin) < AVR_SBI_SPACE_END) {
+      if (high)
+        _SFR_MEM8(avrPinOutputReg(Pin)) |= mask;
+      else
+        _SFR_MEM8(avrPinOutputReg(Pin)) &= ~mask;
+    } else {
+      uint8_t oldSREG = SREG;
+      cli();
+      if (high)
+        _SFR_MEM8(avrPinOutputReg(Pin)) |= mask;
+      else
+        _SFR_MEM8(avrPinOutputReg(Pin)) &= ~mask;
+      SREG = oldSREG;
+    }
+  }
+
+  static inline void setOutput(IN bool output) {
+    uint8_t oldSREG = SREG;
+    cli();
+    if (output)
+      _SFR_MEM8(avrPinDirReg(Pin)) |= mask;
+    else
+      _SFR_MEM8(avrPinDirReg(Pin)) &= ~mask;
+    SREG = oldSREG;
+  }
+};
+
+/***f* fastGpioPortSnapshot
+ *
+ * Returns the PINx register of Pin. If Pin is on the same port as
+ * PrevPin, 'prev' (the PINx value that was already read for PrevPin)
+ * is returned instead, so that a group of pins costs one read per port
+ * as long as the pins of the same port are read one after the other.
+ */
+template <uint8_t Pin, uint8_t PrevPin>
+inline uint8_t fastGpioPortSnapshot(IN uint8_t prev) {
+  return (avrPinPort(Pin) == avrPinPort(PrevPin)) ? prev : FastGpio<Pin>::readPort();
+}
+
+#endif // endif __cpluscplus
+#endif // endif fast_gpio_h
@@ -0,0 +1,220 @@
+#include "faults.h"
+#include "log.h"
+
+/* The DS18B20 returns its power-on value when a conversion didn't run */
+#define DS18B20_POWER_ON_C 85.0
+#define SENSOR_MIN_C -20
+#define SENSOR_MAX_C 125
+
+static const char fault_sensor_stale[] PROGMEM = "sensor_stale";
+static const char fault_sensor_disagree[] PROGMEM = "sensor_disagree";
+static const char fault_over_temperature[] PROGMEM = "over_temperature";
+static const char fault_rise_rate[] PROGMEM = "rise_rate";
+static const char fault_ssr_stuck[] PROGMEM = "ssr_stuck";
+static const char fault_heater_no_effect[] PROGMEM = "heater_no_effect";
+static const char fault_watchdog[] PROGMEM = "watchdog_reset";
+static const char fault_network_init[] PROGMEM = "network_init";
+
+static const char * const FAULT_NAMES[FAULT_COUNT] PROGMEM = {
+  fault_sensor_stale, fault_sensor_disagree, fault_over_temperature,
+  fault_rise_rate, fault_ssr_stuck, fault_heater_no_effect,
+  fault_watchdog, fault_network_init
+};
+
+/* The last reading, handed from loop() to the ISR */
+static volatile bool newReading = false;
+static bool readingValid;
+static float readingAvg, readingMin, readingMax;
+
+/* Only touched from the ISR, or with the interrupts disabled */
+static volatile uint8_t latched = 0;
+static uint16_t counts[FAULT_COUNT];
+static bool haveTemperature = false;
+static float lastTemperature;
+static uint16_t staleTicks = 0;
+static uint8_t disagreeReadings = 0;
+static uint16_t rateTicks = FAULT_RATE_WINDOW_TICKS;
+static float rateRef;
+static uint16_t stuckTicks = 0;
+static float stuckRef;
+static uint16_t effectTicks = 0;
+static float effectRef;
+static uint16_t settleTicks = 0;    // Ticks since 'on', up to FAULT_SETTLE_TICKS
+static uint8_t offTicks = 0;        // Ticks since 'off', up to FAULT_SETTLE_OFF_TICKS
+
+static void latch(IN uint8_t code) {
+  if (latched & (1 << code))
+    return;
+  latched |= (1 << code);
+  counts[code]++;
+  LOG(LOG_FAULT, code);
+}
+
+void faultsSensorReading(IN const float *temperatures,
+                         IN uint8_t count) {
+  bool valid = true;
+  float sum = 0, tmin = temperatures[0], tmax = temperatures[0];
+
+  for (uint8_t i = 0; i < count; i++) {
+    float t = temperatures[i];
+    if (t < SENSOR_MIN_C || t > SENSOR_MAX_C || t == DS18B20_POWER_ON_C)
+      valid = false;
+    sum += t;
+    tmin = min(tmin, t);
+    tmax = max(tmax, t);
+  }
+
+  uint8_t oldSREG = SREG;
+  cli();
+  readingValid = valid;
+  readingAvg = sum / count;
+  readingMin = tmin;
+  readingMax = tmax;
+  newReading = true;
+  SREG = oldSREG;
+}
+
+/***f* checkReading
+ *
+ * The checks that need a new reading.
+ */
+static void checkReading() {
+  staleTicks = 0;
+  lastTemperature = readingAvg;
+  haveTemperature = true;
+
+  if (readingMax > FAULT_OVER_TEMPERATURE_C)
+    latch(FAULT_OVER_TEMPERATURE);
+
+  if (readingMax - readingMin > FAULT_DISAGREE_C) {
+    if (++disagreeReadings >= FAULT_DISAGREE_READINGS)
+      latch(FAULT_SENSOR_DISAGREE);
+  } else {
+    disagreeReadings = 0;
+  }
+
+  /* Compare with a reading of up to FAULT_RATE_WINDOW_TICKS ago. Not
+   * while the device is off, it may be put in hot water, nor while the
+   * probe settles in it. */
+  if (settleTicks < FAULT_SETTLE_TICKS || rateTicks >= FAULT_RATE_WINDOW_TICKS) {
+    rateRef = readingAvg;
+    rateTicks = 0;
+  }
+  if (readingAvg - rateRef > FAULT_MAX_RISE_C)
+    latch(FAULT_RISE_RATE);
+}
+
+bool faultsTick(IN bool on,
+                IN uint8_t heater_output) {
+  /* The probe settles again only after it has been out for a while,
+   * not after every bounce of the float switch */
+  if (!on) {
+    if (offTicks < FAULT_SETTLE_OFF_TICKS)
+      offTicks++;
+    else
+      settleTicks = 0;
+  } else {
+    offTicks = 0;
+    if (settleTicks < FAULT_SETTLE_TICKS)
+      settleTicks++;
+  }
+
+  if (staleTicks < FAULT_STALE_TICKS)
+    staleTicks++;
+  else
+    latch(FAULT_SENSOR_STALE);
+
+  if (rateTicks < FAULT_RATE_WINDOW_TICKS)
+    rateTicks++;
+
+  if (newReading) {
+    newReading = false;
+    if (readingValid)
+      checkReading();
+  }
+
+  if (!haveTemperature || !on) {
+    stuckTicks = 0;
+    effectTicks = 0;
+    return latched & FAULTS_SAFE_STATE;
+  }
+
+  /* The temperature rises while the heater is off */
+  if (heater_output == 0) {
+    if (stuckTicks == 0)
+      stuckRef = lastTemperature;
+    if (++stuckTicks >= FAULT_SSR_STUCK_TICKS) {
+      if (lastTemperature - stuckRef > FAULT_SSR_STUCK_RISE_C)
+        latch(FAULT_SSR_STUCK);
+      stuckTicks = 0;
+    }
+  } else {
+    stuckTicks = 0;
+  }
+
+  /* The temperature doesn't rise while the heater is on */
+  if (heater_output >= FAULT_NO_EFFECT_OUTPUT) {
+    if (effectTicks == 0)
+      effectRef = lastTemperature;
+    if (++effectTicks >= FAULT_NO_EFFECT_TICKS) {
+      if (lastTemperature - effectRef < FAULT_NO_EFFECT_RISE_C)
+        latch(FAULT_HEATER_NO_EFFECT);
+      effectTicks = 0;
+    }
+  } else {
+    effectTicks = 0;
+  }
+
+  return latched & FAULTS_SAFE_STATE;
+}
+
+void faultsRaise(IN uint8_t code) {
+  uint8_t oldSREG = SREG;
+  cli();
+  latch(code);
+  SREG = oldSREG;
+}
+
+void faultsRelease(IN uint8_t code) {
+  uint8_t oldSREG = SREG;
+  cli();
+  latched &= ~(1 << code);
+  SREG = oldSREG;
+}
+
+uint8_t faultsActive() {
+  return latched;
+}
+
+uint8_t faultsFirst() {
+  uint8_t active = latched;
+
+  for (uint8_t code = 0; code < FAULT_COUNT; code++)
+    if (active & (1 << code))
+      return code;
+  return FAULT_COUNT;
+}
+
+void faultsClear() {
+  uint8_t oldSREG = SREG;
+  cli();
+  latched = 0;
+  staleTicks = 0;
+  disagreeReadings = 0;
+  rateTicks = FAULT_RATE_WINDOW_TICKS;
+  stuckTicks = 0;
+  effectTicks = 0;
+  SREG = oldSREG;
+}
+
+const char *faultName(IN uint8_t code) {
+  return (const char *)pgm_read_word(&FAULT_NAMES[code]);
+}
+
+uint16_t faultsCount(IN uint8_t code) {
+  uint8_t oldSREG = SREG;
+  cli();
+  uint16_t count = counts[code];
+  SREG = oldSREG;
+  return count;
+}
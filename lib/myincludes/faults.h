@@ -0,0 +1,132 @@
+#ifndef faults_h
+#define faults_h
+#ifdef __cplusplus
+
+#include "common.h"
+#include "temperature.h"
+
+/* The fault monitor runs in the 10ms Timer1 ISR (faultsTick()). A fault
+ * is latched when it is detected, and while one of the FAULTS_SAFE_STATE
+ * faults is latched, the ISR keeps the heater and the pump off. The
+ * faults are cleared when the user turns the device off (faultsClear()),
+ * and are latched again if the cause is still there.
+ *
+ * The time from the cause to the safe state is bounded by:
+ *
+ *   FAULT_SENSOR_STALE      FAULT_STALE_TICKS                     3.01s
+ *   FAULT_SENSOR_DISAGREE   FAULT_DISAGREE_READINGS conversions   2.26s
+ *   FAULT_OVER_TEMPERATURE  one conversion                        0.76s
+ *   FAULT_RISE_RATE         FAULT_RATE_WINDOW_TICKS + conversion  10.76s
+ *                           + FAULT_SETTLE_TICKS after turning on 40.76s
+ *   FAULT_SSR_STUCK         FAULT_SSR_STUCK_TICKS + conversion    120.76s
+ *   FAULT_HEATER_NO_EFFECT  FAULT_NO_EFFECT_TICKS + conversion    600.76s
+ *
+ * (one conversion is TempSensorModel::conversion_ms, 750ms at 12 bits,
+ * and one tick for the ISR to act). A stuck SSR can't be turned off by
+ * the firmware, so that fault only alarms. The check of the rise rate
+ * starts FAULT_SETTLE_TICKS after the device is turned on or put in the
+ * water, since the probe warms up to the water as fast as a fault would.
+ * The device has to be off or out of the water for FAULT_SETTLE_OFF_TICKS
+ * first, so that a bouncing float switch doesn't keep it from starting.
+ */
+#define FAULT_TICK_MS 10
+
+#define FAULT_STALE_TICKS 300               // No valid reading for 3s
+#define FAULT_DISAGREE_C 3.0                // The sensors differ by more than this
+#define FAULT_DISAGREE_READINGS 3           // in this many readings in a row
+#define FAULT_OVER_TEMPERATURE_C (MAX_TEMPERATURE + 5)
+#define FAULT_RATE_WINDOW_TICKS 1000        // 10s
+#define FAULT_MAX_RISE_C 1.5                // in FAULT_RATE_WINDOW_TICKS. The heater
+                                            // can't do that to a water bath.
+#define FAULT_SSR_STUCK_TICKS 12000         // 2 minutes with the heater off
+#define FAULT_SSR_STUCK_RISE_C 1.0          // and a rise of more than this
+#define FAULT_NO_EFFECT_TICKS 60000         // 10 minutes with the heater
+#define FAULT_NO_EFFECT_OUTPUT 250          // at (nearly) full power
+#define FAULT_NO_EFFECT_RISE_C 0.5          // and a rise of less than this
+#define FAULT_SETTLE_TICKS 3000             // 30s, six time constants of the probe
+#define FAULT_SETTLE_OFF_TICKS 100          // 1s. The probe cools by less than
+                                            // FAULT_MAX_RISE_C in the air meanwhile.
+
+typedef enum _fault_code {
+  FAULT_SENSOR_STALE = 0,  // No valid temperature reading
+  FAULT_SENSOR_DISAGREE,   // The sensors read different temperatures
+  FAULT_OVER_TEMPERATURE,  // The water is too hot
+  FAULT_RISE_RATE,         // The temperature rises faster than the heater can heat water
+  FAULT_SSR_STUCK,         // The temperature rises with the heater off
+  FAULT_HEATER_NO_EFFECT,  // The temperature doesn't rise with the heater on
+  FAULT_WATCHDOG,          // The watchdog has reset the board
+  FAULT_NETWORK_INIT,      // The Ethernet controller doesn't respond
+  FAULT_COUNT
+} fault_code;
+
+/* The faults that turn the heater and the pump off. The
+ * others are only shown. */
+#define FAULTS_SAFE_STATE ((1 << FAULT_SENSOR_STALE) | (1 << FAULT_SENSOR_DISAGREE) | \
+                           (1 << FAULT_OVER_TEMPERATURE) | (1 << FAULT_RISE_RATE) | \
+                           (1 << FAULT_SSR_STUCK) | (1 << FAULT_HEATER_NO_EFFECT))
+
+static_assert(FAULT_COUNT <= 8, "The faults are bits of a uint8_t");
+
+/***f* faultsSensorReading
+ *
+ * Call from loop() after every reading of the temperature sensors.
+ */
+void faultsSensorReading(IN const float *temperatures,
+                         IN uint8_t count);
+
+/***f* faultsTick
+ *
+ * Call from the Timer1 ISR before the heater is driven, with the
+ * heater output of the previous tick. 'on' is true while the device
+ * is on and in the water; the checks of the temperature rise run only
+ * then. Returns true if the heater and the pump must be kept off.
+ */
+bool faultsTick(IN bool on,
+                IN uint8_t heater_output);
+
+/***f* faultsRaise
+ *
+ * Latches a fault that is detected outside the monitor.
+ */
+void faultsRaise(IN uint8_t code);
+
+/***f* faultsRelease
+ *
+ * Clears a fault that is detected outside the monitor,
+ * once its cause has gone.
+ */
+void faultsRelease(IN uint8_t code);
+
+/***f* faultsActive
+ *
+ * Returns the latched faults, one bit per fault_code.
+ */
+uint8_t faultsActive();
+
+/***f* faultsFirst
+ *
+ * Returns the fault_code of the lowest latched fault,
+ * or FAULT_COUNT if there is none.
+ */
+uint8_t faultsFirst();
+
+/***f* faultsClear
+ *
+ * Clears the latched faults and restarts the monitor.
+ */
+void faultsClear();
+
+/***f* faultName
+ *
+ * Returns the name of the fault (a PROGMEM string).
+ */
+const char *faultName(IN uint8_t code);
+
+/***f* faultsCount
+ *
+ * Returns how many times 'code' has been latched since boot.
+ */
+uint16_t faultsCount(IN uint8_t code);
+
+#endif // endif __cpluscplus
+#endif // endif faults_h
@@ -1,6 +1,9 @@
 #include "Arduino.h"
 #include "common.h"
 
+/* All the screens below have two lines */
+static_assert(LCD_ROWS == 2, "The LCD strings are written for a 2 lines LCD");
+
 /* Read the following link to understand why we define the PROGMEM variables the way we do
  * http://www.atmel.com/webdoc/AVRLibcReferenceManual/pgmspace_1pgmspace_strings.html */
 
@@ -61,3 +64,57 @@ const char str11_3[] PROGMEM = "temp sensors";
 
 const char * const LCD_STR_INIT_NETWORK[LCD_ROWS] PROGMEM = {str11_1, str11_2};
 const char * const LCD_STR_INIT_TEMP_SENSORS[LCD_ROWS] PROGMEM = {str11_1, str11_3};
+
+const char str12_1[] PROGMEM = "No presets";
+const char str12_2[] PROGMEM = "Add from web";
+const char str_empty[] PROGMEM = "";
+
+/* The name of the preset is rendered in the first line */
+const char * const LCD_STR_PRESET[LCD_ROWS] PROGMEM = {str_empty, str5};
+const char * const LCD_STR_NO_PRESETS[LCD_ROWS] PROGMEM = {str12_1, str12_2};
+
+const char str13_1[] PROGMEM = "IP address";
+const char str13_2[] PROGMEM = "Netmask";
+const char str13_3[] PROGMEM = "Gateway";
+const char str13_4[] PROGMEM = "Ethernet link";
+const char str13_5[] PROGMEM = "up";
+const char str13_6[] PROGMEM = "down";
+
+/* The pages of the network information screen. The addresses
+ * are rendered in the second line. The last page shows the link. */
+const char * const LCD_STR_NET_INFO[3][LCD_ROWS] PROGMEM = {
+  {str13_1, str_empty},
+  {str13_2, str_empty},
+  {str13_3, str_empty}
+};
+
+const char * const LCD_STR_NET_LINK[2][LCD_ROWS] PROGMEM = {
+  {str13_4, str13_6},
+  {str13_4, str13_5}
+};
+
+const char str14_1[] PROGMEM = "Ramp stage";
+const char str14_2[] PROGMEM = "Heating stage";
+const char str14_3[] PROGMEM = "Hold stage";
+const char str14_4[] PROGMEM = "Program done";
+const char str14_5[] PROGMEM = "Press a button";
+
+/* The screens of the running cook program, in the order of program_state
+ * from PROGRAM_RAMP. The stage number is rendered at the end of the
+ * first line, and the target or the time left in the second. */
+const char * const LCD_STR_PROGRAM[3][LCD_ROWS] PROGMEM = {
+  {str14_1, str5},
+  {str14_2, str5},
+  {str14_3, str_empty}
+};
+
+const char * const LCD_STR_PROGRAM_DONE[LCD_ROWS] PROGMEM = {str14_4, str14_5};
+
+const char str15_1[] PROGMEM = "Fault E";
+
+/* The fault screens. The fault code is rendered after "Fault E",
+ * and the name of the fault in the second line. */
+const char * const LCD_STR_FAULT[2][LCD_ROWS] PROGMEM = {
+  {str15_1, str_empty},
+  {str2_1, str2_2}
+};
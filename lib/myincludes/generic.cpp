@@ -1,4 +1,5 @@
 #include "common.h"
+#include "fast_gpio.h"
 
 const uint8_t RGB_LED_RED[3] = {160, 0, 0};
 const uint8_t RGB_LED_GREEN[3] = {0, 160, 0};
@@ -16,18 +17,15 @@ const uint8_t RGB_LED_OFF[3] = {0, 0, 0};
  */
 static bool lcdBacklightIsOn = false;
 
-/* The order of the button pins must be matching
- * the order of the push_buttons enum
- */
-static const uint8_t buttonPins[] = {
-  PUSH_BTN_MENU_BACK_PIN,
-  PUSH_BTN_MENU_OK_PIN,
-  PUSH_BTN_MENU_DOWN_PIN,
-  PUSH_BTN_MENU_UP_PIN,
-  FLOAT_SWITCH_PIN
-};
+/* pumpIsOn keeps the state that was last set with pump_operate() */
+static volatile bool pumpIsOn = false;
 
-static const uint8_t numButtons = sizeof(buttonPins) / sizeof(uint8_t);
+typedef FastGpio<PUSH_BTN_MENU_BACK_PIN> BtnBackGpio;
+typedef FastGpio<PUSH_BTN_MENU_OK_PIN> BtnOkGpio;
+typedef FastGpio<PUSH_BTN_MENU_DOWN_PIN> BtnDownGpio;
+typedef FastGpio<PUSH_BTN_MENU_UP_PIN> BtnUpGpio;
+typedef FastGpio<FLOAT_SWITCH_PIN> FloatSwitchGpio;
+typedef FastGpio<PUMPRELAY_PIN> PumpRelayGpio;
 
 byte degree_symbol[8] = {
   B00110, B01001, B01001, B00110,
@@ -40,9 +38,14 @@ void software_Reset() {
 
 void pump_operate(IN bool on) {
  if(on)
-  digitalWrite(PUMPRELAY_PIN, LOW);
+  PumpRelayGpio::write(LOW);
  else
-  digitalWrite(PUMPRELAY_PIN, HIGH);
+  PumpRelayGpio::write(HIGH);
+ pumpIsOn = on;
+}
+
+bool pump_is_on() {
+  return pumpIsOn;
 }
 
 void ssr_operate(IN uint8_t analog_on) {
@@ -64,17 +67,30 @@ void setRgbLed(IN const uint8_t* RGB) {
 }
 
 uint8_t readButtons() {
-   uint8_t reply = 0x1F;
-
-   for (uint8_t i = 0; i < numButtons; i++)
-     reply &= ~((digitalRead(buttonPins[i])) << i);
+   /* Read every port only once (see board.h for the order of the pins) */
+   uint8_t back = BtnBackGpio::readPort();
+   uint8_t ok = fastGpioPortSnapshot<PUSH_BTN_MENU_OK_PIN, PUSH_BTN_MENU_BACK_PIN>(back);
+   uint8_t down = fastGpioPortSnapshot<PUSH_BTN_MENU_DOWN_PIN, PUSH_BTN_MENU_OK_PIN>(ok);
+   uint8_t up = fastGpioPortSnapshot<PUSH_BTN_MENU_UP_PIN, PUSH_BTN_MENU_DOWN_PIN>(down);
+   uint8_t float_sw = fastGpioPortSnapshot<FLOAT_SWITCH_PIN, PUSH_BTN_MENU_UP_PIN>(up);
+   uint8_t reply = 0;
+
+   /* The buttons pull the pin low when they are pressed */
+   if (!(back & BtnBackGpio::mask))
+     reply |= BTN_BACK;
+   if (!(ok & BtnOkGpio::mask))
+     reply |= BTN_OK;
+   if (!(down & BtnDownGpio::mask))
+     reply |= BTN_DOWN;
+   if (!(up & BtnUpGpio::mask))
+     reply |= BTN_UP;
 
    /* The float switch has reverse logic when compared to the other
-    * buttons. So flip the bit that represents the float switch, so
-    * that the reply returns zero when the float switch is out of
-    * the water and one when it's in the water (pressed)
+    * buttons, so that the reply returns zero when the float switch is
+    * out of the water and one when it's in the water (pressed)
     */
-   reply ^= (BTN_FLOAT_SW);
+   if (float_sw & FloatSwitchGpio::mask)
+     reply |= BTN_FLOAT_SW;
 
    return reply;
 }
@@ -99,23 +115,3 @@ void setLcdBacklight(IN uint8_t backlight_on) {
     lcdBacklightIsOn = false;
   }
 }
-
-void printLcdLine(IN const char * const str[LCD_ROWS],
-                  IN uint8_t printLineNo) {
-  char line_buffer[LCD_COLS_CHAR_LIMIT];
-  char whiteSpaceFiller[LCD_COLS];
-  memset(whiteSpaceFiller, ' ', LCD_COLS * sizeof(char));
-
-  uint8_t startRow = 0, endRow = LCD_ROWS - 1;
-  if (printLineNo != 0)
-    startRow = endRow = printLineNo - 1;
-
-  for (uint8_t r = startRow; r <= endRow; r++) {
-    lcd.setCursor(0, r);
-    strcpy_P(line_buffer, (char *)pgm_read_word(&(str[r])));
-    lcd.print(line_buffer);
-    /* if str[r] length is less than LCD_COLS, the following line will
-     * fill the remaining LCD blocks in line 'r' with whitespaces */
-    lcd.print(whiteSpaceFiller);
-  }
-}
@@ -0,0 +1,100 @@
+#include "lcd_buffer.h"
+#include "profiler.h"
+
+/* What we want to show and what is currently shown on the LCD */
+static uint8_t lcdTarget[LCD_ROWS][LCD_COLS];
+static uint8_t lcdShown[LCD_ROWS][LCD_COLS];
+
+/* Where the LCD cursor is, or LCD_COLS if we don't know. The HD44780
+ * moves the cursor to the next column after every character. */
+static uint8_t cursorCol = LCD_COLS, cursorRow = 0;
+
+/* lcd.resyncs() at the last flush */
+static uint16_t lcdResyncs = 0;
+
+void lcdBufferInit() {
+  memset(lcdTarget, ' ', sizeof(lcdTarget));
+  /* Nothing that we render can be 0xFF, so everything is repainted */
+  memset(lcdShown, 0xFF, sizeof(lcdShown));
+  cursorCol = LCD_COLS;
+  lcdResyncs = lcd.resyncs();
+}
+
+void printLcdLine(IN const char * const str[LCD_ROWS],
+                  IN uint8_t printLineNo) {
+  uint8_t startRow = 0, endRow = LCD_ROWS - 1;
+  if (printLineNo != 0)
+    startRow = endRow = printLineNo - 1;
+
+  for (uint8_t r = startRow; r <= endRow; r++) {
+    const char *line = (const char *)pgm_read_word(&(str[r]));
+    uint8_t c = 0;
+    char ch;
+    while (c < LCD_COLS && (ch = pgm_read_byte(line + c)) != '\0')
+      lcdTarget[r][c++] = ch;
+    /* if str[r] length is less than LCD_COLS, fill the remaining
+     * LCD blocks in line 'r' with whitespaces */
+    while (c < LCD_COLS)
+      lcdTarget[r][c++] = ' ';
+  }
+}
+
+void lcdBufferWrite(IN uint8_t col,
+                    IN uint8_t row,
+                    IN const char *str) {
+  while (col < LCD_COLS && *str != '\0')
+    lcdTarget[row][col++] = *str++;
+}
+
+void lcdBufferWriteChar(IN uint8_t col,
+                        IN uint8_t row,
+                        IN uint8_t c) {
+  if (col < LCD_COLS)
+    lcdTarget[row][col] = c;
+}
+
+void lcdBufferWriteFloat(IN uint8_t col,
+                         IN uint8_t row,
+                         IN float value) {
+  char str_value[LCD_COLS_CHAR_LIMIT];
+  lcdBufferWrite(col, row, dtostrf(value, 1, 2, str_value));
+}
+
+void lcdBufferFlush() {
+  PROFILE_SCOPE(PROFILE_LCD_FLUSH);
+
+  /* Nothing reaches the LCD after an I2C failure until it is
+   * resynchronized. Keep the changes until then. */
+  if (!lcd.ready())
+    return;
+
+  /* The failure dropped characters and cursor moves */
+  uint16_t resyncs = lcd.resyncs();
+  if (resyncs != lcdResyncs) {
+    lcdResyncs = resyncs;
+    memset(lcdShown, 0xFF, sizeof(lcdShown));
+    cursorCol = LCD_COLS;
+  }
+
+  for (uint8_t r = 0; r < LCD_ROWS; r++) {
+    for (uint8_t c = 0; c < LCD_COLS; c++) {
+      if (lcdTarget[r][c] == lcdShown[r][c])
+        continue;
+
+      /* Room for a cursor move and the character */
+      if (!lcd.canQueue(2))
+        return;
+
+      if (cursorRow != r || cursorCol != c)
+        lcd.setCursor(c, r);
+      lcd.write(lcdTarget[r][c]);
+      lcdShown[r][c] = lcdTarget[r][c];
+      cursorRow = r;
+      cursorCol = c + 1;
+    }
+  }
+}
+
+uint32_t lcdI2cBytes() {
+  return lcd.i2cBytes();
+}
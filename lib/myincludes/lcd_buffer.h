@@ -0,0 +1,85 @@
+#ifndef lcd_buffer_h
+#define lcd_buffer_h
+#ifdef __cplusplus
+
+#include "common.h"
+
+/* The degree symbol is stored in the location 0 of the LCD CGRAM */
+#define LCD_CHAR_DEGREE 0
+
+/* All the screens are rendered in a RAM copy of the LCD (the shadow
+ * buffer) instead of the LCD itself. lcdBufferFlush() compares the
+ * shadow buffer with what is currently shown, and sends only the
+ * characters that have changed. Repainting the same screen costs
+ * nothing, so the screens can be redrawn completely every time.
+ */
+
+/***f* lcdBufferInit
+ *
+ * Clears the shadow buffer and forces a complete repaint on the
+ * next flush. Call once after lcd.begin().
+ */
+void lcdBufferInit();
+
+/***f* printLcdLine
+ *
+ * Renders the PROGMEM strings of 'str' in the shadow buffer. Each line
+ * is filled until the end with white spaces.
+ *
+ * If we want to print only one line of the string, then choose the line
+ * with the printLineNo parameter. The first line is 1, 2nd line is 2 and
+ * so on. When printLineNo == 0, all lines in the str array will be printed
+ *
+ * Whenever you call this function call like like this:
+ *
+ * char *str[LCD_ROWS] = {"Press the \"OK\"", "button to start"};
+ * printLcdLine(str);
+ */
+void printLcdLine(IN const char * const str[LCD_ROWS],
+                  IN uint8_t printLineNo = 0);
+
+/***f* lcdBufferWrite
+ *
+ * Renders the RAM string 'str' in the shadow buffer starting from
+ * column 'col' of row 'row'. Characters beyond the end of the row
+ * are dropped.
+ */
+void lcdBufferWrite(IN uint8_t col,
+                    IN uint8_t row,
+                    IN const char *str);
+
+/***f* lcdBufferWriteChar
+ *
+ * Renders a single character (or a custom character such as
+ * LCD_CHAR_DEGREE) in the shadow buffer.
+ */
+void lcdBufferWriteChar(IN uint8_t col,
+                        IN uint8_t row,
+                        IN uint8_t c);
+
+/***f* lcdBufferWriteFloat
+ *
+ * Renders 'value' with two decimals in the shadow buffer.
+ */
+void lcdBufferWriteFloat(IN uint8_t col,
+                         IN uint8_t row,
+                         IN float value);
+
+/***f* lcdBufferFlush
+ *
+ * Queues the characters that differ between the shadow buffer and
+ * the LCD. The cursor is moved only when the next changed character
+ * doesn't follow the previous one. It never waits for the I2C: if the
+ * queue of the LCD driver is full, the rest of the changes are sent
+ * by the next call.
+ */
+void lcdBufferFlush();
+
+/***f* lcdI2cBytes
+ *
+ * Returns the number of bytes sent to the LCD over I2C since boot.
+ */
+uint32_t lcdI2cBytes();
+
+#endif // endif __cpluscplus
+#endif // endif lcd_buffer_h
@@ -0,0 +1,330 @@
+#include "lcd_twi.h"
+#include <util/twi.h>
+
+/* HD44780 commands */
+#define LCD_CLEARDISPLAY   0x01
+#define LCD_ENTRYMODESET   0x04
+#define LCD_ENTRYLEFT      0x02
+#define LCD_DISPLAYCONTROL 0x08
+#define LCD_DISPLAYON      0x04
+#define LCD_FUNCTIONSET    0x20
+#define LCD_4BITMODE       0x00
+#define LCD_2LINE          0x08
+#define LCD_5x8DOTS        0x00
+#define LCD_SETCGRAMADDR   0x40
+#define LCD_SETDDRAMADDR   0x80
+
+static_assert(LCD_D5_PIN == LCD_D4_PIN + 1 && LCD_D6_PIN == LCD_D4_PIN + 2 &&
+              LCD_D7_PIN == LCD_D4_PIN + 3, "The LCD data pins must be consecutive");
+
+#define LCD_MODE_COMMAND 0
+#define LCD_MODE_DATA    (1 << LCD_RS_PIN)
+
+/* The queue and the state of the transfer are shared with the TWI ISR */
+static volatile uint8_t twiQueue[LCD_TWI_QUEUE_SIZE];
+static volatile uint8_t twiHead = 0; // Next byte to send. Written by the ISR.
+static volatile uint8_t twiTail = 0; // Next free slot. Written by the producer.
+static volatile bool twiBusy = false;
+static volatile uint32_t twiBytes = 0;
+static volatile uint16_t twiErrors = 0;
+static volatile bool twiResync = false; // The LCD may have lost the 4-bit phase
+static uint8_t twiAddr;
+
+static inline uint8_t queueUsed() {
+  return (uint8_t)(twiTail - twiHead) & (LCD_TWI_QUEUE_SIZE - 1);
+}
+
+static inline uint8_t queueFree() {
+  /* One slot is always left empty to tell a full queue from an empty one */
+  return LCD_TWI_QUEUE_SIZE - 1 - queueUsed();
+}
+
+/***f* twiBusReset
+ *
+ * Gives up on a stuck bus (SDA or SCL held low). The TWI is disabled,
+ * the queue dropped and the LCD marked for a resync. Nine clock pulses
+ * make a slave that holds SDA low in the middle of a byte release it.
+ */
+static void twiBusReset() {
+  uint8_t sreg = SREG;
+  cli();
+  TWCR = 0;
+  twiHead = twiTail;
+  twiBusy = false;
+  twiErrors++;
+  twiResync = true;
+  SREG = sreg;
+
+  pinMode(SDA, INPUT_PULLUP);
+  for (uint8_t i = 0; i < 9; i++) {
+    pinMode(SCL, OUTPUT);
+    digitalWrite(SCL, LOW);
+    delayMicroseconds(5);
+    pinMode(SCL, INPUT_PULLUP);
+    delayMicroseconds(5);
+  }
+  TWCR = (1 << TWEN);
+}
+
+/***f* twiStart
+ *
+ * Sends a START condition if no transfer is running. The rest of
+ * the transfer is driven by the TWI interrupt.
+ */
+static void twiStart() {
+  bool stuck = false;
+  uint8_t sreg = SREG;
+  cli();
+  if (!twiBusy && queueUsed() > 0) {
+    /* Wait for the STOP of the previous transfer to go out. The
+     * interrupts are off, so don't wait for long. */
+    uint16_t spins = LCD_TWI_STOP_SPINS;
+    while ((TWCR & (1 << TWSTO)) && --spins)
+      ;
+    if (spins) {
+      twiBusy = true;
+      TWCR = (1 << TWINT) | (1 << TWSTA) | (1 << TWEN) | (1 << TWIE);
+    } else {
+      stuck = true;
+    }
+  }
+  SREG = sreg;
+
+  if (stuck)
+    twiBusReset();
+}
+
+static void twiStop() {
+  TWCR = (1 << TWINT) | (1 << TWSTO) | (1 << TWEN);
+  twiBusy = false;
+}
+
+static void enqueue(IN uint8_t b) {
+  /* Nothing goes out until the LCD is resynchronized (see ready()) */
+  if (twiResync)
+    return;
+  /* Wait for the interrupt to make room. Nobody writes to the LCD
+   * from an ISR, so the interrupts are enabled here. */
+  unsigned long start = micros();
+  while (queueFree() == 0) {
+    if (micros() - start > LCD_TWI_TIMEOUT_US) {
+      twiBusReset();
+      return;
+    }
+    twiStart();
+  }
+  twiQueue[twiTail] = b;
+  twiTail = (twiTail + 1) & (LCD_TWI_QUEUE_SIZE - 1);
+}
+
+ISR(TWI_vect)
+{
+  switch (TW_STATUS) {
+    case TW_START:
+    case TW_REP_START:
+      TWDR = (twiAddr << 1) | TW_WRITE;
+      TWCR = (1 << TWINT) | (1 << TWEN) | (1 << TWIE);
+      twiBytes++;
+      break;
+    case TW_MT_SLA_ACK:
+    case TW_MT_DATA_ACK:
+      if (twiHead != twiTail) {
+        /* The PCF8574 latches every byte of the same transaction on
+         * its outputs, so keep on sending while we have data */
+        TWDR = twiQueue[twiHead];
+        twiHead = (twiHead + 1) & (LCD_TWI_QUEUE_SIZE - 1);
+        TWCR = (1 << TWINT) | (1 << TWEN) | (1 << TWIE);
+        twiBytes++;
+      } else {
+        twiStop();
+      }
+      break;
+    default:
+      /* NACK, lost arbitration or a bus error. Drop what is queued,
+       * otherwise a missing LCD would block the callers forever. That
+       * can cut a command between its two nibbles, so the LCD has to
+       * be resynchronized before the next one (see ready()). */
+      twiErrors++;
+      twiHead = twiTail;
+      twiResync = true;
+      twiStop();
+      break;
+  }
+}
+
+LcdTwi::LcdTwi(IN uint8_t i2c_addr) {
+  twiAddr = i2c_addr;
+  _backlight = 0;
+  _functionSet = LCD_FUNCTIONSET;
+  _retryMs = LCD_TWI_RETRY_MIN_MS;
+  _lastRetry = 0;
+  _resyncs = 0;
+}
+
+void LcdTwi::begin(IN uint8_t cols,
+                   IN uint8_t rows) {
+  _rowOffsets[0] = 0x00;
+  _rowOffsets[1] = 0x40;
+  _rowOffsets[2] = 0x00 + cols;
+  _rowOffsets[3] = 0x40 + cols;
+
+  /* Enable the internal pull-ups of SDA and SCL (pins 20 and 21
+   * on the Mega) and set the bit rate without prescaler */
+  digitalWrite(SDA, HIGH);
+  digitalWrite(SCL, HIGH);
+  TWSR &= ~((1 << TWPS0) | (1 << TWPS1));
+  TWBR = ((F_CPU / LCD_TWI_FREQ) - 16) / 2;
+  TWCR = (1 << TWEN);
+
+  /* The HD44780 initialization in 4-bit mode, see figure 24 of the
+   * datasheet. The LCD needs more than 40ms after power on. */
+  delay(50);
+  enqueue(_backlight);
+  flush();
+  delay(1);
+
+  write4bits(0x03, LCD_MODE_COMMAND);
+  flush();
+  delayMicroseconds(4500);
+  write4bits(0x03, LCD_MODE_COMMAND);
+  flush();
+  delayMicroseconds(4500);
+  write4bits(0x03, LCD_MODE_COMMAND);
+  flush();
+  delayMicroseconds(150);
+  write4bits(0x02, LCD_MODE_COMMAND);
+
+  _functionSet = LCD_FUNCTIONSET | LCD_4BITMODE | (rows > 1 ? LCD_2LINE : 0) | LCD_5x8DOTS;
+  send(_functionSet, LCD_MODE_COMMAND);
+  send(LCD_DISPLAYCONTROL | LCD_DISPLAYON, LCD_MODE_COMMAND);
+  send(LCD_CLEARDISPLAY, LCD_MODE_COMMAND);
+  flush();
+  delayMicroseconds(2000); // The clear command takes 1.52ms
+  send(LCD_ENTRYMODESET | LCD_ENTRYLEFT, LCD_MODE_COMMAND);
+  flush();
+}
+
+void LcdTwi::setCursor(IN uint8_t col,
+                       IN uint8_t row) {
+  send(LCD_SETDDRAMADDR | (col + _rowOffsets[row & 0x03]), LCD_MODE_COMMAND);
+}
+
+size_t LcdTwi::write(IN uint8_t c) {
+  send(c, LCD_MODE_DATA);
+  return 1;
+}
+
+void LcdTwi::createChar(IN uint8_t location,
+                        IN uint8_t charmap[]) {
+  send(LCD_SETCGRAMADDR | ((location & 0x07) << 3), LCD_MODE_COMMAND);
+  for (uint8_t i = 0; i < 8; i++)
+    write(charmap[i]);
+}
+
+void LcdTwi::setBacklight(IN uint8_t on) {
+  _backlight = on ? (1 << LCD_BACKLIGHT_PIN) : 0;
+  /* With EN low the data lines are ignored by the LCD */
+  enqueue(_backlight);
+  twiStart();
+}
+
+bool LcdTwi::canQueue(IN uint8_t ops) {
+  return queueFree() >= (uint16_t)ops * LCD_TWI_BYTES_PER_OP;
+}
+
+void LcdTwi::flush() {
+  twiStart();
+  unsigned long start = micros();
+  while (twiBusy) {
+    if (micros() - start > LCD_TWI_TIMEOUT_US) {
+      twiBusReset();
+      return;
+    }
+  }
+}
+
+uint32_t LcdTwi::i2cBytes() {
+  uint8_t sreg = SREG;
+  cli();
+  uint32_t bytes = twiBytes;
+  SREG = sreg;
+  return bytes;
+}
+
+uint16_t LcdTwi::errors() {
+  uint8_t sreg = SREG;
+  cli();
+  uint16_t errors = twiErrors;
+  SREG = sreg;
+  return errors;
+}
+
+bool LcdTwi::ready() {
+  if (!twiResync)
+    return true;
+  if (millis() - _lastRetry < _retryMs)
+    return false;
+
+  _lastRetry = millis();
+  if (resync()) {
+    _retryMs = LCD_TWI_RETRY_MIN_MS;
+    _resyncs++;
+    return true;
+  }
+  if (_retryMs < LCD_TWI_RETRY_MAX_MS)
+    _retryMs *= 2;
+  return false;
+}
+
+uint16_t LcdTwi::resyncs() {
+  return _resyncs;
+}
+
+void LcdTwi::send(IN uint8_t value,
+                  IN uint8_t mode) {
+  queue(value, mode);
+  twiStart();
+}
+
+void LcdTwi::queue(IN uint8_t value,
+                   IN uint8_t mode) {
+  write4bits(value >> 4, mode);
+  write4bits(value & 0x0F, mode);
+}
+
+bool LcdTwi::resync() {
+  twiResync = false;
+  /* A probe first. Without an ACK nothing else is sent. */
+  enqueue(_backlight);
+  flush();
+  if (twiResync)
+    return false;
+
+  /* From either phase of the 4-bit mode, three 0x03 nibbles switch the
+   * HD44780 to 8-bit mode and 0x02 back to 4-bit mode, in phase. The
+   * first nibble may complete a command that was cut in half, e.g. a
+   * return home, which takes 1.52ms. The others take 37us. */
+  write4bits(0x03, LCD_MODE_COMMAND);
+  flush();
+  delayMicroseconds(2000);
+  write4bits(0x03, LCD_MODE_COMMAND);
+  flush();
+  delayMicroseconds(150);
+  write4bits(0x03, LCD_MODE_COMMAND);
+  flush();
+  delayMicroseconds(150);
+  write4bits(0x02, LCD_MODE_COMMAND);
+  queue(_functionSet, LCD_MODE_COMMAND);
+  queue(LCD_DISPLAYCONTROL | LCD_DISPLAYON, LCD_MODE_COMMAND);
+  queue(LCD_ENTRYMODESET | LCD_ENTRYLEFT, LCD_MODE_COMMAND);
+  flush();
+  return !twiResync;
+}
+
+void LcdTwi::write4bits(IN uint8_t nibble,
+                        IN uint8_t mode) {
+  uint8_t b = (nibble << LCD_D4_PIN) | mode | _backlight;
+  /* The LCD latches the nibble on the falling edge of EN */
+  enqueue(b | (1 << LCD_EN_PIN));
+  enqueue(b);
+}
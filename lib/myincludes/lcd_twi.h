@@ -0,0 +1,130 @@
+#ifndef lcd_twi_h
+#define lcd_twi_h
+#ifdef __cplusplus
+
+#include "common.h"
+
+/* Size of the queue with the bytes for the PCF8574 I2C expander.
+ * Must be a power of 2. Every character or command takes 4 bytes
+ * (two nibbles, each written with EN high and then EN low).
+ */
+#define LCD_TWI_QUEUE_SIZE 128
+#define LCD_TWI_BYTES_PER_OP 4
+#define LCD_TWI_FREQ 100000L // The PCF8574 supports up to 100kHz
+#define LCD_TWI_TIMEOUT_US 20000L  // Longer than sending a full queue (11.5ms at 100kHz)
+#define LCD_TWI_STOP_SPINS 1000    // Iterations (about 500us) to wait for a STOP, interrupts off
+#define LCD_TWI_RETRY_MIN_MS 250   // After an I2C failure, try to resynchronize the LCD after
+#define LCD_TWI_RETRY_MAX_MS 8000  // this long, doubled up to this after every failed try
+
+/* Non-blocking driver for an HD44780 LCD behind a PCF8574 I2C expander.
+ *
+ * LiquidCrystal_I2C writes through Wire, which waits until every byte
+ * has been sent. This driver only puts the expander bytes in a ring
+ * buffer. The TWI interrupt sends them in a single I2C write transaction
+ * for as long as the queue has data, so the loop can serve the network
+ * and the sensors in the meantime.
+ *
+ * The driver owns the TWI hardware and its interrupt, so Wire must not
+ * be used together with it.
+ */
+class LcdTwi : public Print {
+  public:
+    LcdTwi(IN uint8_t i2c_addr);
+
+    /***f* begin
+     *
+     * Initializes the TWI and the LCD in 4-bit mode. It blocks for
+     * about 60ms, so call it only from setup().
+     */
+    void begin(IN uint8_t cols,
+               IN uint8_t rows);
+
+    void setCursor(IN uint8_t col,
+                   IN uint8_t row);
+
+    virtual size_t write(IN uint8_t c);
+    using Print::write;
+
+    /***f* createChar
+     *
+     * Stores a custom 5x8 character in the CGRAM location 0 - 7.
+     */
+    void createChar(IN uint8_t location,
+                    IN uint8_t charmap[]);
+
+    void setBacklight(IN uint8_t on);
+
+    /***f* canQueue
+     *
+     * Back-pressure for the callers that shouldn't wait: returns true if
+     * 'ops' characters/commands fit in the queue right now. Otherwise the
+     * write functions wait until the interrupt makes room.
+     */
+    bool canQueue(IN uint8_t ops);
+
+    /***f* flush
+     *
+     * Barrier: waits until everything that has been queued is sent.
+     */
+    virtual void flush();
+
+    /***f* i2cBytes
+     *
+     * Returns the number of bytes (address and data) that
+     * have been sent over I2C since boot.
+     */
+    uint32_t i2cBytes();
+
+    /***f* errors
+     *
+     * Returns the number of failed I2C transactions (NACK, lost
+     * arbitration, a stuck bus). The queued bytes are dropped on a
+     * failure, and so is everything that is written until ready()
+     * resynchronizes the 4-bit mode of the LCD.
+     */
+    uint16_t errors();
+
+    /***f* ready
+     *
+     * Returns true if the writes reach the LCD. After an I2C failure it
+     * tries to resynchronize the LCD, at most once per LCD_TWI_RETRY_MIN_MS
+     * and less often while that keeps failing (a missing LCD). A try
+     * that fails costs one probe byte, one that succeeds blocks for
+     * about 3ms.
+     */
+    bool ready();
+
+    /***f* resyncs
+     *
+     * Returns the number of times the LCD has been resynchronized.
+     * The characters and the cursor position are lost each time, so
+     * repaint the whole screen when this changes.
+     */
+    uint16_t resyncs();
+
+  private:
+    void send(IN uint8_t value,
+              IN uint8_t mode);
+    void queue(IN uint8_t value,
+               IN uint8_t mode);
+    void write4bits(IN uint8_t nibble,
+                    IN uint8_t mode);
+
+    /***f* resync
+     *
+     * Brings the LCD back in phase after an I2C failure, which may
+     * have dropped one of the two nibbles of a command. Returns false
+     * if the LCD didn't acknowledge it.
+     */
+    bool resync();
+
+    uint8_t _backlight;
+    uint8_t _functionSet;
+    uint16_t _retryMs;
+    unsigned long _lastRetry;
+    uint16_t _resyncs;
+    uint8_t _rowOffsets[4];
+};
+
+#endif // endif __cpluscplus
+#endif // endif lcd_twi_h
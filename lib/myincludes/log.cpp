@@ -0,0 +1,116 @@
+#include "log.h"
+#include "trace.h"
+
+static_assert(LOG_BUFFER_SIZE == 256, "The ring buffer indices wrap at 256");
+
+/* The size of the records of every event */
+#define LOG_EVENT_SIZE(name, level, format) LOG_RECORD_OVERHEAD + name##_NARGS * sizeof(uint32_t),
+static const uint8_t recordSize[LOG_EVENT_COUNT] PROGMEM = {
+  LOG_EVENTS(LOG_EVENT_SIZE)
+};
+
+static uint8_t ring[LOG_BUFFER_SIZE];
+static volatile uint8_t head = 0;   // Written by logWrite() with the interrupts disabled
+static uint8_t tail = 0;            // Written by logTask() only
+static uint32_t dropped = 0;
+static uint16_t unreported = 0;     // Dropped since the last LOG_DROPPED record
+
+/***f* put
+ *
+ * Appends 'size' bytes to the ring buffer, and adds them to 'sum'.
+ */
+static void put(IN const void *data,
+                IN uint8_t size,
+                OUT uint8_t *sum) {
+  const uint8_t *p = (const uint8_t *)data;
+
+  for (uint8_t i = 0; i < size; i++) {
+    ring[(uint8_t)(head + i)] = p[i];
+    *sum += p[i];
+  }
+  head += size;
+}
+
+/***f* append
+ *
+ * Appends a record to the ring buffer, if it fits.
+ * Call with the interrupts disabled.
+ */
+static bool append(IN uint8_t id,
+                   IN const uint32_t *args,
+                   IN uint8_t count) {
+  uint8_t size = LOG_RECORD_OVERHEAD + count * sizeof(uint32_t);
+  uint8_t used = head - tail;
+  uint8_t sum = 0;
+
+  if (LOG_BUFFER_SIZE - 1 - used < size)
+    return false;
+
+  uint32_t now = millis();
+  ring[head++] = LOG_SYNC;
+  put(&id, 1, &sum);
+  put(&now, sizeof(now), &sum);
+  put(args, count * sizeof(uint32_t), &sum);
+  ring[head++] = sum;
+  return true;
+}
+
+bool logWrite(IN uint8_t id,
+              IN const uint32_t *args,
+              IN uint8_t count) {
+  uint8_t oldSREG = SREG;
+  cli();
+  bool written = append(id, args, count);
+  if (!written) {
+    dropped++;
+    unreported++;
+  }
+  SREG = oldSREG;
+  return written;
+}
+
+void logTask() {
+  /* Tell the decoder where records are missing */
+  uint8_t oldSREG = SREG;
+  cli();
+  if (unreported) {
+    uint32_t count = unreported;
+    if (append(LOG_DROPPED, &count, LOG_DROPPED_NARGS))
+      unreported = 0;
+  }
+  SREG = oldSREG;
+
+  /* The serial port carries the trace. Keep the records until
+   * the ring buffer is full, and count the rest as dropped. */
+  if (traceStreaming())
+    return;
+
+  /* Only what fits in the transmit buffer, so that Serial.write()
+   * never waits, and whole records only, so that the text that the
+   * console prints can't land in the middle of one. logWrite() appends
+   * whole records, so the ring buffer starts with one. */
+  int room = Serial.availableForWrite();
+  while (tail != head) {
+    uint8_t id = ring[(uint8_t)(tail + 1)];
+    uint8_t size = (id < LOG_EVENT_COUNT) ? pgm_read_byte(&recordSize[id]) : 1;
+    if (size > room)
+      break;
+    room -= size;
+    while (size-- > 0)
+      Serial.write(ring[tail++]);
+  }
+}
+
+uint32_t logDropped() {
+  uint8_t oldSREG = SREG;
+  cli();
+  uint32_t count = dropped;
+  SREG = oldSREG;
+  return count;
+}
+
+uint32_t logIp(IN const uint8_t *ip) {
+  uint32_t packed;
+  memcpy(&packed, ip, sizeof(packed));
+  return packed;
+}
@@ -0,0 +1,139 @@
+#ifndef log_h
+#define log_h
+#ifdef __cplusplus
+
+#include "common.h"
+
+/* Binary logging that never blocks.
+ *
+ * LOG() writes a compact record in a RAM ring buffer, and logTask()
+ * sends it to the serial port from loop(), only as many whole records
+ * as fit in the transmit buffer of the Serial. If the ring buffer is full the
+ * record is dropped and counted, so LOG() can be used from the Timer1
+ * ISR too. A record is:
+ *
+ *   LOG_SYNC, id, millis() (4 bytes), the arguments (4 bytes each),
+ *   checksum (the sum of the bytes from the id on)
+ *
+ * in little endian. tools/logdecode.py turns the records back to text
+ * with the formats of log_events.h, and passes through the text that
+ * the console prints in between.
+ */
+#define LOG_LEVEL_ERROR 0
+#define LOG_LEVEL_WARN 1
+#define LOG_LEVEL_INFO 2
+#define LOG_LEVEL_DEBUG 3
+
+/* The events above this level are compiled out. Can be
+ * given from the build flags, like -DLOG_LEVEL=1 */
+#ifndef LOG_LEVEL
+#if DEBUG
+#define LOG_LEVEL LOG_LEVEL_DEBUG
+#else
+#define LOG_LEVEL LOG_LEVEL_INFO
+#endif
+#endif
+
+#define LOG_BUFFER_SIZE 256     // The indices are uint8_t that wrap around
+#define LOG_SYNC 0xFE           // Never sent by the console, which prints ASCII
+#define LOG_RECORD_OVERHEAD 7   // LOG_SYNC, id, timestamp and checksum
+
+#include "log_events.h"
+
+/***f* logCountArgs
+ *
+ * Returns the number of conversions in the format 'f'.
+ * Runs at compile time only.
+ */
+constexpr uint8_t logCountArgs(IN const char *f) {
+  return *f == '\0' ? 0 :
+         *f == '%' ? 1 + logCountArgs(f + 2) : logCountArgs(f + 1);
+}
+
+#define LOG_EVENT_ID(name, level, format) name,
+#define LOG_EVENT_LEVEL(name, level, format) name##_LEVEL = level,
+#define LOG_EVENT_NARGS(name, level, format) name##_NARGS = logCountArgs(format),
+
+typedef enum _log_event {
+  LOG_EVENTS(LOG_EVENT_ID)
+  LOG_EVENT_COUNT
+} log_event;
+
+enum { LOG_EVENTS(LOG_EVENT_LEVEL) };
+enum { LOG_EVENTS(LOG_EVENT_NARGS) };
+
+static_assert(LOG_EVENT_COUNT <= 256, "The log event ids are uint8_t");
+
+/***f* logWrite
+ *
+ * Appends a record to the ring buffer. Returns false if it didn't fit
+ * and was dropped. Use the LOG() macros instead.
+ */
+bool logWrite(IN uint8_t id,
+              IN const uint32_t *args,
+              IN uint8_t count);
+
+/***f* logTask
+ *
+ * Call from loop(). Sends the buffered records to the serial port
+ * without waiting for it.
+ */
+void logTask();
+
+/***f* logDropped
+ *
+ * Returns how many records have been dropped since boot.
+ */
+uint32_t logDropped();
+
+/***f* logIp
+ *
+ * Packs an IPv4 address in a single %I argument.
+ */
+uint32_t logIp(IN const uint8_t *ip);
+
+/* The arguments are stored as 4 bytes: floats (and the doubles,
+ * which are floats on the AVR) as they are, anything else as an
+ * integer. */
+static inline uint32_t logArg(IN float value) {
+  uint32_t bits;
+  memcpy(&bits, &value, sizeof(bits));
+  return bits;
+}
+
+static inline uint32_t logArg(IN double value) {
+  return logArg((float)value);
+}
+
+template <typename T>
+static inline uint32_t logArg(IN T value) {
+  return (uint32_t)value;
+}
+
+template <uint8_t N, typename... T>
+static inline void logRecord(IN uint8_t id,
+                             IN T... args) {
+  static_assert(sizeof...(T) == N, "The arguments don't match the format in log_events.h");
+  uint32_t values[] = {0, logArg(args)...};
+  logWrite(id, values + 1, N);
+}
+
+/* LOG(LOG_PID, output, p, i, d) logs the event LOG_PID of log_events.h */
+#define LOG(name, ...) \
+  do { \
+    if (name##_LEVEL <= LOG_LEVEL) \
+      logRecord<name##_NARGS>(name, ##__VA_ARGS__); \
+  } while (0)
+
+/* Like LOG(), but at most once every 'interval_ms' from this place */
+#define LOG_LIMIT(interval_ms, name, ...) \
+  do { \
+    static unsigned long _log_last = 0; \
+    if (name##_LEVEL <= LOG_LEVEL && millis() - _log_last >= (interval_ms)) { \
+      _log_last = millis(); \
+      logRecord<name##_NARGS>(name, ##__VA_ARGS__); \
+    } \
+  } while (0)
+
+#endif // endif __cpluscplus
+#endif // endif log_h
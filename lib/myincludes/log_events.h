@@ -0,0 +1,44 @@
+#ifndef log_events_h
+#define log_events_h
+#ifdef __cplusplus
+
+/* The log events, one per line:
+ *
+ *   LOG_EVENT(name, level, "format")
+ *
+ * The id of an event is its position in this list, and the records
+ * carry only the id. So add new events at the end, and rename the
+ * ones that are not used any more to LOG_UNUSED_<n> instead of
+ * removing them, or the older logs can't be decoded.
+ *
+ * The formats are not stored in the firmware. tools/logdecode.py reads
+ * them from this file. Their conversions give the number and the types
+ * of the arguments:
+ *
+ *   %d  int32     %u  uint32     %x  uint32 in hex
+ *   %f  float     %I  IPv4 address (logIp())
+ */
+#define LOG_EVENTS(LOG_EVENT) \
+  LOG_EVENT(LOG_DROPPED,           LOG_LEVEL_WARN,  "%u log records dropped") \
+  LOG_EVENT(LOG_PID,               LOG_LEVEL_DEBUG, "PID output %f (p %f, i %f, d %f)") \
+  LOG_EVENT(LOG_TEMPERATURE,       LOG_LEVEL_DEBUG, "Temperature of the sensor on pin %d is %f") \
+  LOG_EVENT(LOG_BACKLIGHT_ON,      LOG_LEVEL_DEBUG, "Backlight is OFF. Turning on.") \
+  LOG_EVENT(LOG_FAULT,             LOG_LEVEL_ERROR, "Fault E%d latched") \
+  LOG_EVENT(LOG_HEAP_GREW,         LOG_LEVEL_WARN,  "Heap grew after setup: %u bytes") \
+  LOG_EVENT(LOG_LOW_HEADROOM,      LOG_LEVEL_WARN,  "Low memory headroom: %u bytes") \
+  LOG_EVENT(LOG_ETH_NO_CONTROLLER, LOG_LEVEL_ERROR, "Failed to access Ethernet controller") \
+  LOG_EVENT(LOG_ETH_LINK_UP,       LOG_LEVEL_INFO,  "Ethernet link is up.") \
+  LOG_EVENT(LOG_ETH_LINK_DOWN,     LOG_LEVEL_INFO,  "Ethernet link is down.") \
+  LOG_EVENT(LOG_DHCP_START,        LOG_LEVEL_INFO,  "Try DHCP") \
+  LOG_EVENT(LOG_DHCP_FAILED,       LOG_LEVEL_WARN,  "DHCP failed") \
+  LOG_EVENT(LOG_STATIC_IP,         LOG_LEVEL_INFO,  "Static IP") \
+  LOG_EVENT(LOG_NET_UP,            LOG_LEVEL_INFO,  "IP %I netmask %I gateway %I DNS %I") \
+  LOG_EVENT(LOG_NET_TRY,           LOG_LEVEL_INFO,  "Trying the new network configuration") \
+  LOG_EVENT(LOG_NET_STORED,        LOG_LEVEL_INFO,  "The new network configuration works. Storing it.") \
+  LOG_EVENT(LOG_NET_ROLLBACK,      LOG_LEVEL_WARN,  "The new network configuration wasn't reached. Rolling back.") \
+  LOG_EVENT(LOG_NET_BAD_MASK,      LOG_LEVEL_WARN,  "subnet is not a valid mask!") \
+  LOG_EVENT(LOG_HTTP_REQUEST,      LOG_LEVEL_DEBUG, "HTTP request from %I") \
+  LOG_EVENT(LOG_HTTP_ROUTE,        LOG_LEVEL_DEBUG, "HTTP route %d")
+
+#endif // endif __cpluscplus
+#endif // endif log_events_h
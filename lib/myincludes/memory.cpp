@@ -0,0 +1,108 @@
+#include "memory.h"
+#include "log.h"
+
+/* Symbols from the linker script and avr-libc's malloc */
+extern uint8_t _end;
+extern uint8_t __stack;
+extern uint8_t __heap_start;
+extern void *__brkval;
+
+struct __freelist {
+  size_t sz;
+  struct __freelist *nx;
+};
+extern struct __freelist *__flp;
+
+static memory_stats lastScan;
+static unsigned long lastTimeScanned = 0;
+
+/***f* paintStack
+ *
+ * Fills the memory from the end of the static variables (_end) up to the
+ * top of the stack (__stack) with STACK_PAINT_BYTE. It runs in .init1,
+ * before the stack pointer and r1 are set up by the C runtime, so it
+ * is written in assembly and cannot call anything.
+ */
+void paintStack(void) __attribute__ ((naked)) __attribute__ ((used)) __attribute__ ((section (".init1")));
+void paintStack(void) {
+  __asm volatile ("    ldi r30, lo8(_end)\n"
+                  "    ldi r31, hi8(_end)\n"
+                  "    ldi r24, %0\n"
+                  "    ldi r25, hi8(__stack)\n"
+                  "    rjmp 2f\n"
+                  "1:\n"
+                  "    st Z+, r24\n"
+                  "2:\n"
+                  "    cpi r30, lo8(__stack)\n"
+                  "    cpc r31, r25\n"
+                  "    brlo 1b\n"
+                  "    breq 1b\n"
+                  :: "i" (STACK_PAINT_BYTE));
+}
+
+static uint8_t *heapEnd() {
+  return __brkval ? (uint8_t *)__brkval : &__heap_start;
+}
+
+void memoryMarkSetupDone() {
+  lastScan.heap_size_at_setup = heapEnd() - &__heap_start;
+}
+
+void memoryMonitor() {
+  if (millis() - lastTimeScanned < MEMORY_SCAN_INTERVAL_MS)
+    return;
+  lastTimeScanned = millis();
+
+  /* Everything above the heap that still has the paint has never been
+   * touched by the stack, so the first byte without the paint is the
+   * deepest point the stack has reached. */
+  uint8_t *p = heapEnd();
+  while (p <= &__stack && *p == STACK_PAINT_BYTE)
+    p++;
+
+  uint16_t heap_size = heapEnd() - &__heap_start;
+  if (heap_size != lastScan.heap_size && heap_size > lastScan.heap_size_at_setup) {
+    LOG(LOG_HEAP_GREW, heap_size);
+  }
+  lastScan.heap_size = heap_size;
+  lastScan.stack_peak = &__stack - p + 1;
+
+  uint16_t headroom = p - heapEnd();
+  if (lastScan.headroom_min == 0 || headroom < lastScan.headroom_min) {
+    lastScan.headroom_min = headroom;
+    if (headroom < MEMORY_HEADROOM_WARN_BYTES) {
+      lastScan.low_headroom_warnings++;
+      LOG(LOG_LOW_HEADROOM, headroom);
+    }
+  }
+
+  uint16_t free_list = 0;
+  for (struct __freelist *fp = __flp; fp; fp = fp->nx)
+    free_list += fp->sz;
+  lastScan.heap_free_list = free_list;
+}
+
+void memoryGetStats(OUT memory_stats *stats) {
+  uint8_t top_of_stack;
+
+  *stats = lastScan;
+  stats->free_now = &top_of_stack - heapEnd();
+}
+
+void memoryPrint(OUT Print &out) {
+  memory_stats stats;
+  memoryGetStats(&stats);
+
+  out.print(F("heap_size "));
+  out.println(stats.heap_size);
+  out.print(F("heap_size_at_setup "));
+  out.println(stats.heap_size_at_setup);
+  out.print(F("heap_free_list "));
+  out.println(stats.heap_free_list);
+  out.print(F("free_now "));
+  out.println(stats.free_now);
+  out.print(F("stack_peak "));
+  out.println(stats.stack_peak);
+  out.print(F("headroom_min "));
+  out.println(stats.headroom_min);
+}
@@ -0,0 +1,58 @@
+#ifndef memory_h
+#define memory_h
+#ifdef __cplusplus
+
+#include "common.h"
+
+/* The free SRAM between the heap and the stack is painted with
+ * STACK_PAINT_BYTE before main() runs (see memory.cpp). Every
+ * MEMORY_SCAN_INTERVAL_MS we count how many painted bytes are still
+ * untouched, which is the lowest headroom that we ever had.
+ */
+#define STACK_PAINT_BYTE 0xC5
+#define MEMORY_SCAN_INTERVAL_MS 1000
+#define MEMORY_HEADROOM_WARN_BYTES 512 // Log a warning if the headroom gets lower than this
+
+typedef struct _memory_stats {
+  uint16_t heap_size;          // Bytes between __heap_start and the heap break
+  uint16_t heap_size_at_setup; // heap_size when setup() finished. Nothing should
+                               // be allocated after that, so both must be equal.
+  uint16_t heap_free_list;     // Bytes in the free list of malloc (holes in the heap)
+  uint16_t free_now;           // Bytes between the heap break and the stack pointer
+  uint16_t stack_peak;         // The deepest the stack has ever been, in bytes
+  uint16_t headroom_min;       // The least bytes that were ever free between heap and stack
+  uint16_t low_headroom_warnings; // How many times we logged a low headroom warning
+} memory_stats;
+
+/***f* memoryMarkSetupDone
+ *
+ * Call at the end of setup(). Remembers the size of the heap, so
+ * that memoryMonitor() can warn about allocations in loop().
+ */
+void memoryMarkSetupDone();
+
+/***f* memoryMonitor
+ *
+ * Scans the painted memory for the high-water mark once every
+ * MEMORY_SCAN_INTERVAL_MS and logs a warning in the Serial if the
+ * headroom gets lower than MEMORY_HEADROOM_WARN_BYTES, or if the heap
+ * has grown after setup().
+ * Call it from loop().
+ */
+void memoryMonitor();
+
+/***f* memoryGetStats
+ *
+ * Returns the figures of the last scan. The free_now
+ * value is always calculated on the spot.
+ */
+void memoryGetStats(OUT memory_stats *stats);
+
+/***f* memoryPrint
+ *
+ * Prints the memory figures in out (Serial or an HTTP reply).
+ */
+void memoryPrint(OUT Print &out);
+
+#endif // endif __cpluscplus
+#endif // endif memory_h
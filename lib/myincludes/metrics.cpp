@@ -0,0 +1,386 @@
+#include "metrics.h"
+#include "temperature.h"
+#include "memory.h"
+#include "lcd_buffer.h"
+#include "checkpoint.h"
+#include "faults.h"
+#include "watchdog.h"
+#include "network.h"
+#include "log.h"
+
+static uint32_t counters[METRIC_COUNTER_COUNT];
+static uint32_t httpRequests[HTTP_ROUTE_COUNT];
+
+/* Updated from loop() */
+static histogram loopHistogram;
+static unsigned long lastLoopStart_us = 0;
+static histogram sampleHistogram;
+static uint8_t opState = 0;
+
+/* Updated from the Timer1 ISR. Copy them with the interrupts
+ * disabled before reading them from loop() */
+static histogram jitterHistogram;
+static unsigned long lastControlTick_us = 0;
+static uint32_t controlTicks = 0;
+static uint32_t heaterOn_ms = 0;
+static uint16_t heaterOnResidual = 0; // in 1/255 ms
+static double pidOutput, pidP, pidI, pidD;
+
+/* The label values of the http_route enum */
+static const char route_main[] PROGMEM = "main";
+static const char route_temp[] PROGMEM = "temp";
+static const char route_ipconfig[] PROGMEM = "ipconfig";
+static const char route_ipconfig_post[] PROGMEM = "ipconfig_post";
+static const char route_metrics[] PROGMEM = "metrics";
+static const char route_profile[] PROGMEM = "profile";
+static const char route_presets[] PROGMEM = "presets";
+static const char route_presets_post[] PROGMEM = "presets_post";
+static const char route_program[] PROGMEM = "program";
+static const char route_program_post[] PROGMEM = "program_post";
+static const char route_settings[] PROGMEM = "settings";
+static const char route_settings_post[] PROGMEM = "settings_post";
+static const char route_not_found[] PROGMEM = "not_found";
+static const char route_unauthorized[] PROGMEM = "unauthorized";
+static const char route_trace[] PROGMEM = "trace";
+
+static const char * const httpRouteNames[HTTP_ROUTE_COUNT] PROGMEM = {
+  route_main, route_temp, route_ipconfig, route_ipconfig_post,
+  route_metrics, route_profile, route_presets, route_presets_post,
+  route_program, route_program_post, route_settings, route_settings_post,
+  route_not_found, route_unauthorized, route_trace
+};
+
+static const char metrics_sensor_type[] PROGMEM =
+  "# TYPE vagvide_sensor_temperature_celsius gauge\n"
+  "# TYPE vagvide_sensor_read_errors_total counter\n"
+  ;
+
+static const char metrics_sensor[] PROGMEM =
+  "vagvide_sensor_temperature_celsius{sensor=\"$D\"} $S\n"
+  "vagvide_sensor_read_errors_total{sensor=\"$D\"} $L\n"
+  ;
+
+static const char metrics_temperature[] PROGMEM =
+  "# TYPE vagvide_temperature_celsius gauge\n"
+  "vagvide_temperature_celsius $S\n"
+  "# TYPE vagvide_setpoint_celsius gauge\n"
+  "vagvide_setpoint_celsius $S\n"
+  "# TYPE vagvide_cook_elapsed_seconds gauge\n"
+  "vagvide_cook_elapsed_seconds $L\n"
+  ;
+
+static const char metrics_control[] PROGMEM =
+  "# TYPE vagvide_pid_output gauge\n"
+  "vagvide_pid_output $S\n"
+  "# TYPE vagvide_pid_term gauge\n"
+  "vagvide_pid_term{term=\"p\"} $S\n"
+  "vagvide_pid_term{term=\"i\"} $S\n"
+  "vagvide_pid_term{term=\"d\"} $S\n"
+  "# TYPE vagvide_heater_on_seconds_total counter\n"
+  "vagvide_heater_on_seconds_total $L.$S\n"
+  "# TYPE vagvide_control_ticks_total counter\n"
+  "vagvide_control_ticks_total $L\n"
+  "# TYPE vagvide_pump_on gauge\n"
+  "vagvide_pump_on $D\n"
+  "# TYPE vagvide_opstate gauge\n"
+  "vagvide_opstate $D\n"
+  "# TYPE vagvide_lcd_i2c_bytes_total counter\n"
+  "vagvide_lcd_i2c_bytes_total $L\n"
+  "# TYPE vagvide_lcd_i2c_errors_total counter\n"
+  "vagvide_lcd_i2c_errors_total $D\n"
+  ;
+
+static const char metrics_http_type[] PROGMEM =
+  "# TYPE vagvide_http_requests_total counter\n"
+  ;
+
+static const char metrics_http_route[] PROGMEM =
+  "vagvide_http_requests_total{route=\"$F\"} $L\n"
+  ;
+
+static const char metrics_net[] PROGMEM =
+  "# TYPE vagvide_net_state gauge\n"
+  "vagvide_net_state $D\n"
+  "# TYPE vagvide_net_rollbacks_total counter\n"
+  "vagvide_net_rollbacks_total $L\n"
+  "# TYPE vagvide_http_duplicates_total counter\n"
+  "vagvide_http_duplicates_total $L\n"
+  "# TYPE vagvide_eth_frames_received_total counter\n"
+  "vagvide_eth_frames_received_total $L\n"
+  "# TYPE vagvide_eth_tcp_payloads_total counter\n"
+  "vagvide_eth_tcp_payloads_total $L\n"
+  "# TYPE vagvide_eth_frames_discarded_total counter\n"
+  "vagvide_eth_frames_discarded_total $L\n"
+  "# TYPE vagvide_eth_drain_cut_total counter\n"
+  "vagvide_eth_drain_cut_total $L\n"
+  ;
+
+static const char metrics_memory[] PROGMEM =
+  "# TYPE vagvide_memory_heap_bytes gauge\n"
+  "vagvide_memory_heap_bytes $D\n"
+  "# TYPE vagvide_memory_heap_at_setup_bytes gauge\n"
+  "vagvide_memory_heap_at_setup_bytes $D\n"
+  "# TYPE vagvide_memory_heap_free_list_bytes gauge\n"
+  "vagvide_memory_heap_free_list_bytes $D\n"
+  "# TYPE vagvide_memory_free_bytes gauge\n"
+  "vagvide_memory_free_bytes $D\n"
+  "# TYPE vagvide_memory_stack_peak_bytes gauge\n"
+  "vagvide_memory_stack_peak_bytes $D\n"
+  "# TYPE vagvide_memory_headroom_min_bytes gauge\n"
+  "vagvide_memory_headroom_min_bytes $D\n"
+  "# TYPE vagvide_memory_low_headroom_warnings_total counter\n"
+  "vagvide_memory_low_headroom_warnings_total $D\n"
+  "# TYPE vagvide_settings_eeprom_writes_total counter\n"
+  "vagvide_settings_eeprom_writes_total $L\n"
+  "# TYPE vagvide_checkpoint_eeprom_writes_total counter\n"
+  "vagvide_checkpoint_eeprom_writes_total $L\n"
+  "# TYPE vagvide_log_records_dropped_total counter\n"
+  "vagvide_log_records_dropped_total $L\n"
+  ;
+
+static const char metrics_fault_type[] PROGMEM =
+  "# TYPE vagvide_fault_active gauge\n"
+  "# TYPE vagvide_faults_total counter\n"
+  ;
+
+static const char metrics_fault[] PROGMEM =
+  "vagvide_fault_active{fault=\"$F\"} $D\n"
+  "vagvide_faults_total{fault=\"$F\"} $D\n"
+  ;
+
+static const char metrics_reset_cause[] PROGMEM =
+  "# TYPE vagvide_reset_cause gauge\n"
+  "vagvide_reset_cause $D\n"
+  ;
+
+static const char metrics_loop_name[] PROGMEM = "vagvide_loop_duration_seconds";
+static const char metrics_jitter_name[] PROGMEM = "vagvide_control_tick_jitter_seconds";
+static const char metrics_sample_name[] PROGMEM = "vagvide_sample_jitter_seconds";
+
+static const char metrics_histogram_type[] PROGMEM =
+  "# TYPE $F histogram\n"
+  ;
+
+static const char metrics_histogram_bucket[] PROGMEM =
+  "$F_bucket{le=\"$S\"} $L\n"
+  ;
+
+static const char metrics_histogram_tail[] PROGMEM =
+  "$F_bucket{le=\"+Inf\"} $L\n"
+  "$F_sum $L.$S\n"
+  "$F_count $L\n"
+  ;
+
+static void histogramObserve(IN histogram *h,
+                             IN uint8_t base_shift,
+                             IN uint32_t value_us) {
+  /* Find the bucket. This runs at most HISTOGRAM_BUCKETS - 1 times
+   * no matter how large the value is. */
+  uint32_t bound = (uint32_t)1 << base_shift;
+  uint8_t i = 0;
+  while (i < HISTOGRAM_BUCKETS - 1 && value_us > bound) {
+    bound <<= 1;
+    i++;
+  }
+
+  h->buckets[i]++;
+  h->count++;
+  h->sum_us += value_us % 1000;
+  h->sum_ms += value_us / 1000;
+  if (h->sum_us >= 1000) {
+    h->sum_us -= 1000;
+    h->sum_ms++;
+  }
+}
+
+/***f* fmtFraction
+ *
+ * Writes 'value' (0 - 999) as three zero padded digits in buf, so that
+ * it can be printed after the decimal point of a seconds value.
+ */
+static char *fmtFraction(IN uint16_t value,
+                         OUT char buf[4]) {
+  buf[0] = '0' + value / 100;
+  buf[1] = '0' + (value / 10) % 10;
+  buf[2] = '0' + value % 10;
+  buf[3] = '\0';
+  return buf;
+}
+
+static void emitHistogram(IN const histogram *h,
+                          IN const char *name,
+                          IN uint8_t base_shift,
+                          OUT BufferFiller &buf) {
+  char str_bound[12], str_frac[4];
+  uint32_t cumulative = 0;
+
+  buf.emit_p(metrics_histogram_type, name);
+  for (uint8_t i = 0; i < HISTOGRAM_BUCKETS - 1; i++) {
+    cumulative += h->buckets[i];
+    dtostrf(((uint32_t)1 << (base_shift + i)) / 1e6, 1, 6, str_bound);
+    buf.emit_p(metrics_histogram_bucket, name, str_bound, cumulative);
+  }
+  buf.emit_p(metrics_histogram_tail,
+             name, h->count,
+             name, h->sum_ms / 1000, fmtFraction(h->sum_ms % 1000, str_frac),
+             name, h->count);
+}
+
+void metricsIncrement(IN metrics_counter counter) {
+  counters[counter]++;
+}
+
+void metricsHttpRequest(IN http_route route) {
+  httpRequests[route]++;
+}
+
+void metricsLoopIteration(IN unsigned long now_us) {
+  if (lastLoopStart_us != 0)
+    histogramObserve(&loopHistogram, LOOP_HISTOGRAM_BASE_SHIFT, now_us - lastLoopStart_us);
+  lastLoopStart_us = now_us;
+}
+
+void metricsControlTick(IN unsigned long now_us,
+                        IN uint8_t ssr_output) {
+  if (lastControlTick_us != 0) {
+    unsigned long period = now_us - lastControlTick_us;
+    histogramObserve(&jitterHistogram, JITTER_HISTOGRAM_BASE_SHIFT,
+                     period > CONTROL_TICK_PERIOD_US ? period - CONTROL_TICK_PERIOD_US
+                                                     : CONTROL_TICK_PERIOD_US - period);
+  }
+  lastControlTick_us = now_us;
+  controlTicks++;
+
+  /* The SSR is driven with a duty cycle of ssr_output/255, so in a
+   * 10ms tick the heater is on for ssr_output * 10 / 255 ms */
+  heaterOnResidual += (uint16_t)ssr_output * 10;
+  heaterOn_ms += heaterOnResidual / 255;
+  heaterOnResidual %= 255;
+}
+
+void metricsSampleInterval(IN unsigned long interval_ms) {
+  unsigned long nominal_ms = TempSensorModel::conversion_ms;
+
+  histogramObserve(&sampleHistogram, SAMPLE_HISTOGRAM_BASE_SHIFT,
+                   (interval_ms > nominal_ms ? interval_ms - nominal_ms
+                                             : nominal_ms - interval_ms) * 1000);
+}
+
+void metricsSetPid(IN double output,
+                   IN double p_term,
+                   IN double i_term,
+                   IN double d_term) {
+  pidOutput = output;
+  pidP = p_term;
+  pidI = i_term;
+  pidD = d_term;
+}
+
+void metricsSetOpState(IN uint8_t op_state) {
+  opState = op_state;
+}
+
+void metricsEmitSection(IN uint8_t section,
+                        OUT BufferFiller &buf) {
+  char str_a[12], str_b[12], str_c[12], str_d[12];
+
+  switch (section) {
+    case 0:
+      buf.emit_p(metrics_sensor_type);
+      for (uint8_t i = 0; i < numSensors; i++)
+        buf.emit_p(metrics_sensor,
+                   i + 1, dtostrf(temperature[i], 1, 2, str_a),
+                   i + 1, tempSensorReadErrors[i]);
+      buf.emit_p(metrics_temperature,
+                 dtostrf(current_temperature, 1, 2, str_a),
+                 dtostrf(getDesiredTemperature(), 1, 2, str_b),
+                 checkpointCookSeconds());
+      break;
+    case 1:
+    {
+      /* Take a consistent copy of the values updated by the ISR */
+      double output, p, i, d;
+      uint32_t ticks, on_ms;
+      cli();
+      output = pidOutput;
+      p = pidP;
+      i = pidI;
+      d = pidD;
+      ticks = controlTicks;
+      on_ms = heaterOn_ms;
+      sei();
+
+      char str_frac[4];
+      buf.emit_p(metrics_control,
+                 dtostrf(output, 1, 2, str_a),
+                 dtostrf(p, 1, 2, str_b),
+                 dtostrf(i, 1, 2, str_c),
+                 dtostrf(d, 1, 2, str_d),
+                 on_ms / 1000, fmtFraction(on_ms % 1000, str_frac),
+                 ticks,
+                 pump_is_on() ? 1 : 0,
+                 opState,
+                 lcdI2cBytes(),
+                 lcd.errors());
+      break;
+    }
+    case 2:
+      buf.emit_p(metrics_http_type);
+      for (uint8_t r = 0; r < HTTP_ROUTE_COUNT; r++)
+        buf.emit_p(metrics_http_route,
+                   (const char *)pgm_read_word(&httpRouteNames[r]),
+                   httpRequests[r]);
+      buf.emit_p(metrics_net,
+                 networkState(),
+                 counters[METRIC_NET_ROLLBACKS],
+                 counters[METRIC_HTTP_DUPLICATES],
+                 counters[METRIC_ETH_FRAMES_RX],
+                 counters[METRIC_ETH_TCP_PAYLOADS],
+                 counters[METRIC_ETH_DISCARDED],
+                 counters[METRIC_ETH_DRAIN_CUT]);
+      break;
+    case 3:
+      emitHistogram(&loopHistogram, metrics_loop_name, LOOP_HISTOGRAM_BASE_SHIFT, buf);
+      break;
+    case 4:
+    {
+      histogram jitter;
+      cli();
+      jitter = jitterHistogram;
+      sei();
+      emitHistogram(&jitter, metrics_jitter_name, JITTER_HISTOGRAM_BASE_SHIFT, buf);
+      break;
+    }
+    case 5:
+    {
+      memory_stats mem;
+      memoryGetStats(&mem);
+      buf.emit_p(metrics_memory,
+                 mem.heap_size,
+                 mem.heap_size_at_setup,
+                 mem.heap_free_list,
+                 mem.free_now,
+                 mem.stack_peak,
+                 mem.headroom_min,
+                 mem.low_headroom_warnings,
+                 counters[METRIC_SETTINGS_WRITES],
+                 counters[METRIC_CHECKPOINT_WRITES],
+                 logDropped());
+      break;
+    }
+    case 6:
+    {
+      uint8_t active = faultsActive();
+      buf.emit_p(metrics_fault_type);
+      for (uint8_t f = 0; f < FAULT_COUNT; f++)
+        buf.emit_p(metrics_fault,
+                   faultName(f), (active & (1 << f)) ? 1 : 0,
+                   faultName(f), faultsCount(f));
+      buf.emit_p(metrics_reset_cause, watchdogResetCause());
+      break;
+    }
+    case 7:
+      emitHistogram(&sampleHistogram, metrics_sample_name, SAMPLE_HISTOGRAM_BASE_SHIFT, buf);
+      break;
+  }
+}
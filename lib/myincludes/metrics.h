@@ -0,0 +1,130 @@
+#ifndef metrics_h
+#define metrics_h
+#ifdef __cplusplus
+
+#include "common.h"
+#include "EtherCard.h"
+
+/* Every histogram has HISTOGRAM_BUCKETS buckets. The upper bound of the
+ * first bucket is (1 << base_shift) microseconds and every following bucket
+ * doubles the bound of the previous one. The last bucket is the +Inf bucket.
+ */
+#define HISTOGRAM_BUCKETS 10
+
+#define LOOP_HISTOGRAM_BASE_SHIFT 7   // First bucket: <= 128us
+#define JITTER_HISTOGRAM_BASE_SHIFT 3 // First bucket: <= 8us
+#define SAMPLE_HISTOGRAM_BASE_SHIFT 10 // First bucket: <= 1.024ms
+
+#define CONTROL_TICK_PERIOD_US 10000  // The Timer1 overflow ISR runs every 10ms
+
+/* The routes served by the web server. Used for counting
+ * the HTTP requests per route.
+ */
+typedef enum _http_route {
+  HTTP_ROUTE_MAIN = 0,
+  HTTP_ROUTE_TEMP,
+  HTTP_ROUTE_IPCONFIG,
+  HTTP_ROUTE_IPCONFIG_POST,
+  HTTP_ROUTE_METRICS,
+  HTTP_ROUTE_PROFILE,
+  HTTP_ROUTE_PRESETS,
+  HTTP_ROUTE_PRESETS_POST,
+  HTTP_ROUTE_PROGRAM,
+  HTTP_ROUTE_PROGRAM_POST,
+  HTTP_ROUTE_SETTINGS,
+  HTTP_ROUTE_SETTINGS_POST,
+  HTTP_ROUTE_NOT_FOUND,
+  HTTP_ROUTE_UNAUTHORIZED,
+  HTTP_ROUTE_TRACE,
+  HTTP_ROUTE_COUNT
+} http_route;
+
+/* Plain counters that are only increased by one */
+typedef enum _metrics_counter {
+  METRIC_ETH_FRAMES_RX = 0,  // Frames returned by ether.packetReceive()
+  METRIC_ETH_TCP_PAYLOADS,   // Frames that carried TCP payload for us
+  METRIC_HTTP_DUPLICATES,    // Duplicate HTTP requests (same TCP seq)
+  METRIC_SETTINGS_WRITES,    // Settings records written in the EEPROM
+  METRIC_CHECKPOINT_WRITES,  // Cook checkpoints written in the EEPROM
+  METRIC_NET_ROLLBACKS,      // New network configurations that were rolled back
+  METRIC_ETH_DISCARDED,      // Frames dropped before parsing: not for us
+  METRIC_ETH_DRAIN_CUT,      // Receive drains stopped by the budget or a control deadline
+  METRIC_COUNTER_COUNT
+} metrics_counter;
+
+typedef struct _histogram {
+  uint32_t buckets[HISTOGRAM_BUCKETS]; // Not cumulative. Accumulated while rendering.
+  uint32_t count;
+  uint32_t sum_ms;                     // The sum is split in milliseconds and the
+  uint16_t sum_us;                     // remaining microseconds (< 1000) so that it
+                                       // doesn't wrap after 71 minutes.
+} histogram;
+
+/* The metrics are rendered in a few sections. Every section fits in
+ * a single TCP segment and is sent as soon as it has been rendered.
+ */
+#define METRICS_SECTION_COUNT 8
+
+/***f* metricsIncrement
+ *
+ * Increases the counter by one.
+ */
+void metricsIncrement(IN metrics_counter counter);
+
+/***f* metricsHttpRequest
+ *
+ * Increases the HTTP request counter of the given route by one.
+ */
+void metricsHttpRequest(IN http_route route);
+
+/***f* metricsLoopIteration
+ *
+ * Call once at the beginning of every loop() with the current
+ * micros(). The time since the previous call is recorded in the
+ * loop iteration histogram.
+ */
+void metricsLoopIteration(IN unsigned long now_us);
+
+/***f* metricsControlTick
+ *
+ * Call from the 10ms Timer1 ISR with the current micros() and the
+ * value that is applied to the SSR in this tick. The deviation from
+ * the nominal tick period is recorded in the jitter histogram and the
+ * heater on-time is accumulated.
+ */
+void metricsControlTick(IN unsigned long now_us,
+                        IN uint8_t ssr_output);
+
+/***f* metricsSampleInterval
+ *
+ * Call from loop() with the time between the conversions of two
+ * temperature samples. The deviation from the conversion time is
+ * recorded in the sample jitter histogram.
+ */
+void metricsSampleInterval(IN unsigned long interval_ms);
+
+/***f* metricsSetPid
+ *
+ * Stores the latest PID output and the individual PID terms.
+ */
+void metricsSetPid(IN double output,
+                   IN double p_term,
+                   IN double i_term,
+                   IN double d_term);
+
+/***f* metricsSetOpState
+ *
+ * Stores the current operating state.
+ */
+void metricsSetOpState(IN uint8_t op_state);
+
+/***f* metricsEmitSection
+ *
+ * Renders the section 'section' (0 to METRICS_SECTION_COUNT - 1)
+ * of the metrics in the Prometheus text format into buf.
+ */
+void metricsEmitSection(IN uint8_t section,
+                        OUT BufferFiller &buf);
+
+#endif // endif __cpluscplus
+#endif // endif metrics_h
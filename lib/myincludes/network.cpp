@@ -2,6 +2,17 @@
 /* All the web page strings that I serve from Arduino */
 #include "web_page_strings.h"
 #include "temperature.h"
+#include "metrics.h"
+#include "profiler.h"
+#include "presets.h"
+#include "program.h"
+#include "settings.h"
+#include "watchdog.h"
+#include "faults.h"
+#include "log.h"
+#include "trace.h"
+#include "buttons.h"
+#include "controller.h"
 
 // Variable to store the previous TCP sequence number
 // and compare it with the TCP sequence of a newly arrived
@@ -11,61 +22,836 @@ static unsigned int PREV_TCP_SEQ_NUM = 0;
 static BufferFiller bfill;
 // TCP/IP send/receive buffer
 byte Ethernet::buffer[2000];
+// Start a new TCP segment when a multi-segment reply has more than
+// this many bytes in the current one
+#define HTTP_SEGMENT_FILL 1000
+#define DHCP_CLIENT_PORT 68
+/* The fields of a DHCP message in the UDP payload (RFC 2131) */
+#define DHCP_CHADDR_P (UDP_DATA_P + 28)
+#define DHCP_OPTIONS_P (UDP_DATA_P + 240)   // After the magic cookie
+#define DHCP_OPTION_PAD 0
+#define DHCP_OPTION_LEASE_TIME 51
+#define DHCP_OPTION_MESSAGE_TYPE 53
+#define DHCP_OPTION_END 255
+#define DHCP_MESSAGE_ACK 5
+#define DHCP_INFINITE_LEASE 0xFFFFFFFFUL
 //
 byte myip[4], gwip[4], dnsip[4], netmask[4], mymac[6];
 
+static uint8_t netState = NET_STATE_NO_CONTROLLER;
+static bool skipController = false;
+static unsigned long lastBeginAttempt = 0;
+static unsigned long dhcpStart = 0;
+
+/* The last DHCP lease. EtherCard doesn't tell its lease time, so it
+ * is taken from the DHCP ACK that it receives. */
+static net_settings lease;
+static bool haveLease = false;
+static unsigned long leaseAt = 0;    // millis() of the last ACK
+static uint32_t leaseSeconds = 0;
+static bool leaseAcked = false;      // An ACK since the DHCP state began
+
+/* A network configuration from POST /ipconfig that is being tried */
+typedef enum _net_reconfig_state {
+  NET_RECONFIG_NONE = 0,
+  NET_RECONFIG_SCHEDULED,  // Apply it after the reply has been sent
+  NET_RECONFIG_TRIAL       // Applied. Store it when a request reaches it.
+} net_reconfig_state;
+
+static uint8_t reconfigState = NET_RECONFIG_NONE;
+static net_settings stagedNet;
+static unsigned long reconfigStart = 0;
+
+static bool startController();
+static void netUp();
+
 void resetEepromNetworkConfig() {
   // To reset the ip configuration, write the
   // value 0 to NET_EEPROM_OFFSET.
   EEPROM.write(NET_EEPROM_OFFSET, 0);
 }
 
-void initNetworkModule() {
+bool initNetworkModule(IN bool skip_controller) {
   NetEeprom.init(mymac);
 
   Serial.print("MAC: ");
   print_macAddress(mymac);
   Serial.println();
 
-  while (ether.begin(sizeof Ethernet::buffer, mymac, ETH_SPI_CHIP_SELECT_PIN) == 0)
-  {
-    /* TODO: If the EN28J60 module is not powered up, the begin() function will never
-     *       return because the initialize() function in the file enc28j60.cpp that
-     *       is called by the begin function is running in an etternal while loop
-     *       until it gets a response from the hardware. We should have a way to
-     *       notify the user in the LCD that there is a problem with the Ethernet in
-     *       case the ether.begin takes a very long time.
-     */
-    Serial.println( "Failed to access Ethernet controller");
-    delay(5000);
+  skipController = skip_controller;
+  if (skip_controller)
+    return false;
+
+  return startController();
+}
+
+/***f* startController
+ *
+ * One attempt to start the Ethernet controller. If the EN28J60 module
+ * is not powered up, the begin() function never returns, because the
+ * initialize() function in the file enc28j60.cpp waits in an eternal
+ * loop for a response from the hardware. The watchdog resets the board
+ * then, and the next boot skips the controller (see watchdogHungIn()).
+ * So mark the network stage around it, also when networkTask() retries.
+ */
+static bool startController() {
+  lastBeginAttempt = millis();
+
+  watchdogBootStage(BOOT_STAGE_NETWORK);
+  bool started = (ether.begin(sizeof Ethernet::buffer, mymac, ETH_SPI_CHIP_SELECT_PIN) != 0);
+  watchdogBootStage(BOOT_STAGE_DONE);
+
+  if (!started) {
+    LOG(LOG_ETH_NO_CONTROLLER);
+    return false;
   }
+  netState = NET_STATE_LINK_DOWN;
+  return true;
+}
+
+/***f* activeNet
+ *
+ * Returns the network configuration that is in use: the one that is
+ * being tried after a POST /ipconfig, or else the stored one.
+ */
+static const net_settings *activeNet() {
+  if (reconfigState != NET_RECONFIG_NONE)
+    return &stagedNet;
+  return settingsNet();
+}
+
+/***f* leaseValid
+ *
+ * Returns true if the last DHCP lease hasn't expired.
+ */
+static bool leaseValid() {
+  return haveLease && (leaseSeconds == DHCP_INFINITE_LEASE ||
+                       (millis() - leaseAt) / 1000 < leaseSeconds);
 }
 
-void initNetworkAddr() {
-  if (NetEeprom.isDhcp())
+/***f* startNetworkAddr
+ *
+ * Configures the network addresses when the link comes up, or when
+ * the configuration changes. A static configuration is applied right
+ * away. For DHCP, ether.dhcpSetup() isn't used, since it waits up to
+ * a minute for the lease. The EtherCard DHCP state machine that it
+ * runs is driven from networkTask() instead, one received packet at
+ * a time.
+ */
+static void startNetworkAddr() {
+  const net_settings *net = activeNet();
+
+  if (net->dhcp)
   {
-    Serial.println("Try DHCP");
-    if (!ether.dhcpSetup())
-      Serial.println( "DHCP failed");
+    LOG(LOG_DHCP_START);
+    /* EtherCard's DHCP state machine can't be restarted, and it
+     * doesn't run while the addresses are static. After a switch from
+     * static addresses, take the lease it already has if it is still
+     * valid; the state machine renews it when it expires. An expired
+     * one may be somebody else's address by now, so wait without an
+     * address instead: the renewal of the state machine fails and it
+     * starts a new discovery. */
+    leaseAcked = false;
+    if (leaseValid()) {
+      ether.staticSetup(lease.ip, lease.gateway, lease.dns, lease.netmask);
+      leaseAcked = true;
+    } else {
+      memset(ether.myip, 0, 4);
+    }
+    netState = NET_STATE_DHCP;
+    dhcpStart = millis();
+    return;
   }
-  else
-  {
-    NetEeprom.readIp(myip);
-    NetEeprom.readGateway(gwip);
-    NetEeprom.readDns(dnsip);
-    NetEeprom.readSubnet(netmask);
-    Serial.println("Static IP");
-    ether.staticSetup(myip, gwip, dnsip, netmask);
+
+  memcpy(myip, net->ip, 4);
+  memcpy(gwip, net->gateway, 4);
+  memcpy(dnsip, net->dns, 4);
+  memcpy(netmask, net->netmask, 4);
+  LOG(LOG_STATIC_IP);
+  ether.staticSetup(myip, gwip, dnsip, netmask);
+  netUp();
+}
+
+/***f* netUp
+ *
+ * The addresses have been configured.
+ */
+static void netUp() {
+  netState = NET_STATE_UP;
+  if (activeNet()->dhcp) {
+    ether.copyIp(lease.ip, ether.myip);
+    ether.copyIp(lease.gateway, ether.gwip);
+    ether.copyIp(lease.dns, ether.dnsip);
+    ether.copyIp(lease.netmask, ether.netmask);
+    haveLease = true;
+  }
+  LOG(LOG_NET_UP, logIp(ether.myip), logIp(ether.netmask),
+      logIp(ether.gwip), logIp(ether.dnsip));
+}
+
+/***f* stageNetConfig
+ *
+ * Schedules a new network configuration. networkTask() applies it
+ * after the reply has been sent, and stores it once an HTTP request
+ * reaches the new address. If none does in NET_CONFIRM_TIMEOUT_MS,
+ * the stored configuration is applied again.
+ */
+static void stageNetConfig(IN const net_settings *net) {
+  stagedNet = *net;
+  reconfigState = NET_RECONFIG_SCHEDULED;
+}
+
+/***f* reconfigTask
+ *
+ * Applies, confirms or rolls back a staged network configuration.
+ * 'served' is true if an HTTP request has just been served.
+ */
+static void reconfigTask(IN bool served) {
+  switch (reconfigState) {
+    case NET_RECONFIG_SCHEDULED:
+      LOG(LOG_NET_TRY);
+      reconfigState = NET_RECONFIG_TRIAL;
+      reconfigStart = millis();
+      if (netState == NET_STATE_DHCP || netState == NET_STATE_UP)
+        startNetworkAddr();
+      break;
+    case NET_RECONFIG_TRIAL:
+      if (served && netState == NET_STATE_UP) {
+        LOG(LOG_NET_STORED);
+        reconfigState = NET_RECONFIG_NONE;
+        if (stagedNet.dhcp)
+          settingsSetNetDhcp();
+        else
+          settingsSetNetStatic(stagedNet.ip, stagedNet.gateway,
+                               stagedNet.netmask, stagedNet.dns);
+      } else if (millis() - reconfigStart > NET_CONFIRM_TIMEOUT_MS) {
+        LOG(LOG_NET_ROLLBACK);
+        metricsIncrement(METRIC_NET_ROLLBACKS);
+        reconfigState = NET_RECONFIG_NONE;
+        if (netState == NET_STATE_DHCP || netState == NET_STATE_UP)
+          startNetworkAddr();
+      }
+      break;
+  }
+}
+
+/***f* receiveFrame
+ *
+ * Receives the next frame in Ethernet::buffer and returns its length.
+ * The frame is terminated, because the HTTP parsers take the payload as
+ * a string.
+ */
+static uint16_t receiveFrame() {
+  uint16_t len = ether.packetReceive();
+
+  if (len >= sizeof(Ethernet::buffer))
+    len = sizeof(Ethernet::buffer) - 1;
+  Ethernet::buffer[len] = '\0';
+  return len;
+}
+
+/***f* dhcpAckLease
+ *
+ * If the frame of 'len' bytes is a DHCP ACK for us, stores its lease
+ * time in 'seconds' and returns true.
+ */
+static bool dhcpAckLease(IN uint16_t len,
+                         OUT uint32_t *seconds) {
+  const byte *b = Ethernet::buffer;
+  bool ack = false, have_time = false;
+
+  if (len <= DHCP_OPTIONS_P || b[IP_PROTO_P] != IP_PROTO_UDP_V ||
+      b[UDP_DST_PORT_H_P] != 0 || b[UDP_DST_PORT_L_P] != DHCP_CLIENT_PORT ||
+      memcmp(b + DHCP_CHADDR_P, ether.mymac, 6) != 0)
+    return false;
+
+  for (uint16_t i = DHCP_OPTIONS_P; i < len && b[i] != DHCP_OPTION_END; ) {
+    if (b[i] == DHCP_OPTION_PAD) {
+      i++;
+      continue;
+    }
+    if (i + 2 > len || i + 2 + b[i + 1] > len)
+      break;
+    if (b[i] == DHCP_OPTION_MESSAGE_TYPE && b[i + 1] == 1) {
+      ack = (b[i + 2] == DHCP_MESSAGE_ACK);
+    } else if (b[i] == DHCP_OPTION_LEASE_TIME && b[i + 1] == 4) {
+      *seconds = ((uint32_t)b[i + 2] << 24) | ((uint32_t)b[i + 3] << 16) |
+                 ((uint32_t)b[i + 4] << 8) | b[i + 5];
+      have_time = true;
+    }
+    i += 2 + b[i + 1];
+  }
+  return ack && have_time;
+}
+
+static bool haveIp() {
+  return ether.myip[0] != 0 || ether.myip[1] != 0 ||
+         ether.myip[2] != 0 || ether.myip[3] != 0;
+}
+
+/***f* frameForUs
+ *
+ * Early classification of the received frame, on the headers alone:
+ * ARP for our address, IPv4 to our address, and the DHCP replies, which
+ * may be broadcast. Everything else (IPv6, the other broadcasts, the
+ * frames of other hosts) is dropped before packetLoop() parses it.
+ */
+static bool frameForUs(IN uint16_t len) {
+  const byte *b = Ethernet::buffer;
+
+  if (b[ETH_TYPE_H_P] == ETHTYPE_ARP_H_V && b[ETH_TYPE_L_P] == ETHTYPE_ARP_L_V)
+    return len >= ETH_ARP_DST_IP_P + 4 &&
+           memcmp(b + ETH_ARP_DST_IP_P, ether.myip, 4) == 0;
+
+  if (b[ETH_TYPE_H_P] != ETHTYPE_IP_H_V || b[ETH_TYPE_L_P] != ETHTYPE_IP_L_V ||
+      len < UDP_DST_PORT_L_P + 1)
+    return false;
+  if (memcmp(b + IP_DST_P, ether.myip, 4) == 0)
+    return true;
+  return b[IP_PROTO_P] == IP_PROTO_UDP_V && b[UDP_DST_PORT_H_P] == 0 &&
+         b[UDP_DST_PORT_L_P] == DHCP_CLIENT_PORT;
+}
+
+/***f* controlDue
+ *
+ * Returns true if loop() has work that comes before the network.
+ */
+static bool controlDue() {
+  return temperatureReadingDue() || buttonsEventPending();
+}
+
+void networkTask() {
+  if (netState == NET_STATE_NO_CONTROLLER) {
+    /* A hung begin() can't be retried, a failed one can */
+    if (skipController || millis() - lastBeginAttempt < NET_BEGIN_RETRY_MS)
+      return;
+    if (startController())
+      faultsRelease(FAULT_NETWORK_INIT);
+    return;
+  }
+
+  if (!eth_link_state_up()) {
+    if (netState != NET_STATE_LINK_DOWN) {
+      netState = NET_STATE_LINK_DOWN;
+      LOG(LOG_ETH_LINK_DOWN);
+    }
+    return;
+  }
+
+  if (netState == NET_STATE_LINK_DOWN) {
+    LOG(LOG_ETH_LINK_UP);
+    startNetworkAddr();
+    return;
+  }
+
+  unsigned long drainStart = micros();
+  uint8_t frames = 0;
+
+  do {
+    /* Copy received packets to data buffer Ethernet::buffer
+     * and return the uint16_t Size of received data (which is needed by
+     * ether.packetLoop). */
+    uint16_t len, pos;
+    {
+      PROFILE_SCOPE(PROFILE_ETH_RECEIVE);
+      len = receiveFrame();
+    }
+    if (len) {
+      metricsIncrement(METRIC_ETH_FRAMES_RX);
+      frames++;
+      /* While DHCP has no address yet, every frame goes to it */
+      if (netState == NET_STATE_UP && !frameForUs(len)) {
+        metricsIncrement(METRIC_ETH_DISCARDED);
+        continue;
+      }
+    }
+
+    /* Discovery, and the renewal of the lease later. EtherCard only
+     * does the renewal in packetLoop() after ether.dhcpSetup(). */
+    if (activeNet()->dhcp) {
+      uint32_t seconds = 0;
+      if (len && dhcpAckLease(len, &seconds)) {
+        leaseAt = millis();
+        leaseSeconds = seconds;
+        leaseAcked = true;
+      }
+      ether.DhcpStateMachine(len);
+      /* A renewal that failed starts a new discovery without an address */
+      if (netState == NET_STATE_UP && !haveIp()) {
+        LOG(LOG_DHCP_START);
+        netState = NET_STATE_DHCP;
+        dhcpStart = millis();
+        leaseAcked = false;
+      }
+    }
+
+    /* Parse received data and return the uint16_t Offset of TCP payload data
+     * in data buffer Ethernet::buffer, or zero if packet processed */
+    {
+      PROFILE_SCOPE(PROFILE_ETH_PACKET_LOOP);
+      pos = ether.packetLoop(len);
+    }
+
+    if (netState == NET_STATE_DHCP) {
+      if (leaseAcked && haveIp()) {
+        netUp();
+      } else if (millis() - dhcpStart > NET_DHCP_TIMEOUT_MS) {
+        /* EtherCard keeps on trying. Only report it. */
+        LOG(LOG_DHCP_FAILED);
+        dhcpStart = millis();
+      }
+      reconfigTask(false);
+      return;
+    }
+
+    if (pos)
+      tracePacket(Ethernet::buffer, pos);
+    {
+      PROFILE_SCOPE(PROFILE_ETH_PROCESS);
+      processEthernetPacket(pos);
+    }
+    reconfigTask(pos != 0);
+    /* No frame left, or a new configuration from POST /ipconfig */
+    if (!len || netState != NET_STATE_UP)
+      return;
+  } while (frames < NET_DRAIN_MAX_FRAMES &&
+           micros() - drainStart < NET_DRAIN_BUDGET_US && !controlDue());
+
+  /* Frames may be waiting. The next loop() takes them. */
+  metricsIncrement(METRIC_ETH_DRAIN_CUT);
+}
+
+uint8_t networkState() {
+  return netState;
+}
+
+/***f* httpFormBody
+ *
+ * Returns the body of the HTTP POST request 'data'. Some clients send
+ * the body in a packet of its own, so if it is empty the next packet
+ * is received here.
+ */
+static char *httpFormBody(IN char *data) {
+  char *body = strstr_P(data, PSTR("\r\n\r\n"));
+
+  if (body == NULL)
+    return data + strlen(data);
+
+  body += 4;
+  if (*body == '\0') {
+    uint16_t pos = ether.packetLoop(receiveFrame());
+    if (pos) {
+      tracePacket(Ethernet::buffer, pos);
+      body = (char *) Ethernet::buffer + pos;
+    }
+  }
+  return body;
+}
+
+/***f* hexValue
+ *
+ * Returns the value of the hex digit c, or -1 if c is not one.
+ */
+static int8_t hexValue(IN char c) {
+  if (c >= '0' && c <= '9')
+    return c - '0';
+  c |= 0x20;
+  if (c >= 'a' && c <= 'f')
+    return c - 'a' + 10;
+  return -1;
+}
+
+/***f* httpFormValue
+ *
+ * Finds the field 'name' (a PROGMEM string) in the url-encoded form
+ * 'body' and copies its decoded value in 'value'. Values longer than
+ * value_size - 1 are truncated. Returns false if the field is missing.
+ *
+ * With an 'index' (0 - 9) the field is 'name' followed by the digit,
+ * for forms that repeat the same fields, such as "t0", "t1" etc.
+ */
+static bool httpFormValue(IN const char *body,
+                          IN const char *name,
+                          OUT char *value,
+                          IN uint8_t value_size,
+                          IN int8_t index = -1) {
+  uint8_t name_len = strlen_P(name);
+  const char *p = body;
+
+  /* The length of the name with the index */
+  uint8_t field_len = name_len + (index < 0 ? 0 : 1);
+
+  while (*p != '\0') {
+    if (strncmp_P(p, name, name_len) == 0 &&
+        (index < 0 || p[name_len] == '0' + index) &&
+        p[field_len] == '=') {
+      uint8_t j = 0;
+      p += field_len + 1;
+      while (*p != '\0' && *p != '&' && *p != ' ' && *p != '\r' && *p != '\n') {
+        char c = *p++;
+        if (c == '+') {
+          c = ' ';
+        } else if (c == '%' && hexValue(p[0]) >= 0 && hexValue(p[1]) >= 0) {
+          c = (hexValue(p[0]) << 4) | hexValue(p[1]);
+          p += 2;
+        }
+        if (j < value_size - 1)
+          value[j++] = c;
+      }
+      value[j] = '\0';
+      return true;
+    }
+
+    /* Skip to the next field */
+    while (*p != '\0' && *p != '&')
+      p++;
+    if (*p == '&')
+      p++;
+  }
+  return false;
+}
+
+/***f* parseTenths
+ *
+ * Parses a decimal number with at most one decimal digit, such as
+ * "56" or "56.5", in tenths (560 and 565). Returns false if 'str' is
+ * not such a number.
+ */
+static bool parseTenths(IN const char *str,
+                        OUT int16_t *tenths) {
+  int32_t value = 0;
+  uint8_t digits = 0;
+
+  while (*str >= '0' && *str <= '9' && digits < 4) {
+    value = value * 10 + (*str++ - '0');
+    digits++;
+  }
+  if (digits == 0)
+    return false;
+
+  value *= 10;
+  if (*str == '.' || *str == ',') {
+    str++;
+    if (*str >= '0' && *str <= '9')
+      value += *str++ - '0';
+  }
+
+  if (value > 0x7FFF)
+    return false;
+  *tenths = value;
+  return *str == '\0';
+}
+
+/***f* emitMainPage
+ *
+ * Sends the main page. With a long hostname it doesn't fit in one TCP
+ * segment, so it is sent in two and closes the connection itself.
+ */
+static void emitMainPage(IN const char *hostname) {
+  ether.httpServerReplyAck();
+  bfill = ether.tcpOffset();
+  bfill.emit_p(http_OK_200);
+  bfill.emit_p(webpage_main_head);
+  ether.httpServerReply_with_flags(bfill.position(), TCP_FLAGS_ACK_V);
+  bfill = ether.tcpOffset();
+  bfill.emit_p(webpage_main_body,
+               hostname, hostname, hostname, hostname,
+               hostname, hostname, hostname);
+  ether.httpServerReply_with_flags(bfill.position(), TCP_FLAGS_ACK_V | TCP_FLAGS_FIN_V);
+}
+
+/***f* emitPresetsPage
+ *
+ * Sends the preset list with an edit form for every preset and one for
+ * a new preset. It doesn't fit in one TCP segment, so it is sent like
+ * the metrics and closes the connection itself.
+ */
+static void emitPresetsPage(IN const char *hostname,
+                            IN const char *status) {
+  char str_temp[8];
+
+  ether.httpServerReplyAck();
+  bfill = ether.tcpOffset();
+  bfill.emit_p(http_OK_200);
+  bfill.emit_p(webpage_presets_head, hostname, status,
+               pidProfileName(PID_PROFILE_DEFAULT),
+               pidProfileName(PID_PROFILE_SMALL_BATH),
+               pidProfileName(PID_PROFILE_LARGE_BATH));
+
+  for (uint8_t i = 0; i < presetCount(); i++) {
+    const preset *p = presetGet(i);
+
+    if (bfill.position() > HTTP_SEGMENT_FILL) {
+      ether.httpServerReply_with_flags(bfill.position(), TCP_FLAGS_ACK_V);
+      bfill = ether.tcpOffset();
+    }
+    bfill.emit_p(webpage_preset_form, i, p->name,
+                 dtostrf(presetTemperature(p), 1, 1, str_temp),
+                 p->duration, p->pid_profile,
+                 webpage_preset_buttons_edit);
   }
 
-  ether.printIp("My IP: ", ether.myip);
-  ether.printIp("Netmask: ", ether.netmask);
-  ether.printIp("GW IP: ", ether.gwip);
-  ether.printIp("DNS IP: ", ether.dnsip);
+  if (presetCount() < PRESET_MAX)
+    bfill.emit_p(webpage_preset_form, PRESET_NONE, "", "", 0, PID_PROFILE_DEFAULT,
+                 webpage_preset_buttons_new);
+  bfill.emit_p(webpage_presets_tail);
+  ether.httpServerReply_with_flags(bfill.position(), TCP_FLAGS_ACK_V | TCP_FLAGS_FIN_V);
+}
+
+/***f* presetsFormPost
+ *
+ * Handles a POST of one of the forms of the presets page and
+ * returns the status message (a PROGMEM string) for the reply.
+ */
+static const char *presetsFormPost(IN char *body) {
+  char value[PRESET_NAME_SIZE];
+  char op[8];
+  uint8_t index = PRESET_NONE;
+
+  if (httpFormValue(body, PSTR("i"), value, sizeof(value))) {
+    int i = atoi(value);
+    if (i >= 0 && i < PRESET_NONE)
+      index = i;
+  }
+  if (!httpFormValue(body, PSTR("op"), op, sizeof(op)))
+    return presets_status_invalid;
+
+  if (strcmp_P(op, PSTR("apply")) == 0) {
+    if (presetApply(index))
+      return presets_status_applied;
+  } else if (strcmp_P(op, PSTR("delete")) == 0) {
+    if (presetDelete(index))
+      return presets_status_deleted;
+  } else if (strcmp_P(op, PSTR("save")) == 0) {
+    preset p;
+    memset(&p, 0, sizeof(p));
+
+    httpFormValue(body, PSTR("name"), p.name, sizeof(p.name));
+    /* The name is shown on the LCD and in the page. Keep it to
+     * printable ASCII without the HTML special characters. */
+    for (uint8_t i = 0; p.name[i] != '\0'; i++)
+      if (p.name[i] < ' ' || p.name[i] > '~' || strchr_P(PSTR("<>&\""), p.name[i]))
+        p.name[i] = '?';
+
+    if (!httpFormValue(body, PSTR("temp"), value, sizeof(value)) ||
+        !parseTenths(value, &p.temperature))
+      return presets_status_invalid;
+    if (httpFormValue(body, PSTR("dur"), value, sizeof(value))) {
+      long duration = atol(value);
+      p.duration = constrain(duration, 0, 0xFFFF);
+    }
+    if (httpFormValue(body, PSTR("pid"), value, sizeof(value))) {
+      /* Not into the uint8_t directly, where 257 would become 1 */
+      long profile = atol(value);
+      if (profile < 0 || profile >= PID_PROFILE_COUNT)
+        return presets_status_invalid;
+      p.pid_profile = profile;
+    }
+
+    if (presetSave(index, &p) != PRESET_NONE)
+      return presets_status_saved;
+  }
+
+  return presets_status_invalid;
+}
+
+/***f* emitIpConfigPage
+ *
+ * Fills bfill with the IP configuration form. The stored configuration
+ * comes from the RAM copy of the settings, not from the EEPROM.
+ */
+static void emitIpConfigPage(IN const char *hostname) {
+  const net_settings *net = settingsNet();
+
+  bfill.emit_p(http_OK_200);
+  bfill.emit_p(webpage_ipconfig,
+               hostname,
+               net->dhcp ? "checked" : "",
+               net->ip[0], net->ip[1], net->ip[2], net->ip[3],
+               net->netmask[0], net->netmask[1], net->netmask[2], net->netmask[3],
+               net->gateway[0], net->gateway[1], net->gateway[2], net->gateway[3],
+               net->dns[0], net->dns[1], net->dns[2], net->dns[3]);
+}
+
+/***f* emitSettingsPage
+ *
+ * Fills bfill with the settings form.
+ */
+static void emitSettingsPage(IN const char *hostname,
+                             IN const char *status) {
+  const settings *s = settingsGet();
+  char kp[12], ki[12], kd[12], resume[8];
+  uint32_t backlight = (s->lcd_backlight_timeout == SETTINGS_BACKLIGHT_ALWAYS_ON) ?
+                       0 : s->lcd_backlight_timeout / 1000;
+
+  bfill.emit_p(http_OK_200);
+  bfill.emit_p(webpage_settings, hostname, status,
+               backlight, s->menu_return_timeout / 1000,
+               dtostrf(s->resume_window / 10.0, 1, 1, resume),
+               dtostrf(s->kp, 1, 3, kp),
+               dtostrf(s->ki, 1, 3, ki),
+               dtostrf(s->kd, 1, 3, kd));
+}
+
+/***f* settingsFormPost
+ *
+ * Handles a POST of the settings form and returns the
+ * status message (a PROGMEM string) for the reply.
+ */
+static const char *settingsFormPost(IN char *body) {
+  char value[12];
+  long backlight, menu;
+  int16_t resume;
+  float kp, ki, kd;
+
+  if (!httpFormValue(body, PSTR("backlight"), value, sizeof(value)))
+    return settings_status_invalid;
+  backlight = atol(value);
+  if (!httpFormValue(body, PSTR("menu"), value, sizeof(value)))
+    return settings_status_invalid;
+  menu = atol(value);
+  if (backlight < 0 || backlight > 86400L || menu < 1 || menu > 65)
+    return settings_status_invalid;
+  if (!httpFormValue(body, PSTR("resume"), value, sizeof(value)) ||
+      !parseTenths(value, &resume) || resume > 0xFF)
+    return settings_status_invalid;
+
+  if (!httpFormValue(body, PSTR("kp"), value, sizeof(value)))
+    return settings_status_invalid;
+  kp = atof(value);
+  if (!httpFormValue(body, PSTR("ki"), value, sizeof(value)))
+    return settings_status_invalid;
+  ki = atof(value);
+  if (!httpFormValue(body, PSTR("kd"), value, sizeof(value)))
+    return settings_status_invalid;
+  kd = atof(value);
+  /* controllerSetTunings() ignores negative tunings, NaN fails every comparison */
+  if (!(kp >= 0 && ki >= 0 && kd >= 0))
+    return settings_status_invalid;
+
+  settingsSetTimeouts(backlight ? backlight * 1000 : SETTINGS_BACKLIGHT_ALWAYS_ON,
+                      menu * 1000);
+  settingsSetTunings(kp, ki, kd);
+  settingsSetResumeWindow(resume);
+
+  /* The Timer1 ISR computes with the tunings */
+  uint8_t oldSREG = SREG;
+  cli();
+  controllerSetTunings(kp, ki, kd);
+  SREG = oldSREG;
+
+  return settings_status_saved;
+}
+
+/***f* emitProgramPage
+ *
+ * Sends the state of the cook program and a form with its stages.
+ * Sent in several TCP segments, like the presets page.
+ */
+static void emitProgramPage(IN const char *hostname,
+                            IN const char *status) {
+  char str_a[8], str_b[8];
+  program_status st;
+  uint8_t num_stages;
+  const program_stage *stages = programGetStages(&num_stages);
+
+  programGetStatus(&st);
+
+  ether.httpServerReplyAck();
+  bfill = ether.tcpOffset();
+  bfill.emit_p(http_OK_200);
+  bfill.emit_p(webpage_program_head, hostname, status,
+               (const char *)pgm_read_word(&program_state_names[st.state]),
+               st.stage + 1, st.num_stages, st.hold_left_s,
+               dtostrf(getDesiredTemperature(), 1, 2, str_a));
+
+  for (uint8_t i = 0; i < PROGRAM_MAX_STAGES; i++) {
+    if (bfill.position() > HTTP_SEGMENT_FILL) {
+      ether.httpServerReply_with_flags(bfill.position(), TCP_FLAGS_ACK_V);
+      bfill = ether.tcpOffset();
+    }
+
+    /* Empty rows for adding stages */
+    if (i >= num_stages) {
+      bfill.emit_p(webpage_program_stage, i + 1, i, "", i, "", i, 0, i, STAGE_END_NEXT);
+      continue;
+    }
+
+    bfill.emit_p(webpage_program_stage, i + 1,
+                 i, dtostrf(stages[i].temperature / 10.0, 1, 1, str_a),
+                 i, dtostrf(stages[i].ramp_rate / 10.0, 1, 1, str_b),
+                 i, stages[i].hold,
+                 i, stages[i].end_action);
+  }
+
+  bfill.emit_p(webpage_program_tail);
+  ether.httpServerReply_with_flags(bfill.position(), TCP_FLAGS_ACK_V | TCP_FLAGS_FIN_V);
+}
+
+/***f* programFormPost
+ *
+ * Handles a POST of the cook program form and returns the
+ * status message (a PROGMEM string) for the reply.
+ */
+static const char *programFormPost(IN char *body) {
+  char value[8];
+
+  if (!httpFormValue(body, PSTR("op"), value, sizeof(value)))
+    return program_status_invalid;
+
+  if (strcmp_P(value, PSTR("stop")) == 0) {
+    programStop();
+    return program_status_stopped;
+  }
+  if (strcmp_P(value, PSTR("next")) == 0) {
+    programNextStage();
+    return program_status_next;
+  }
+
+  bool start = (strcmp_P(value, PSTR("start")) == 0);
+  if (!start && strcmp_P(value, PSTR("save")) != 0)
+    return program_status_invalid;
+
+  /* Read the stages up to the first one without a temperature */
+  program_stage stages[PROGRAM_MAX_STAGES];
+  uint8_t num_stages = 0;
+  for (uint8_t i = 0; i < PROGRAM_MAX_STAGES; i++) {
+    program_stage *s = &stages[num_stages];
+    int16_t ramp_rate = 0;
+    long hold = 0;
+    long end_action = 0;
+
+    if (!httpFormValue(body, PSTR("t"), value, sizeof(value), i) || value[0] == '\0')
+      break;
+    if (!parseTenths(value, &s->temperature))
+      return program_status_invalid;
+    if (httpFormValue(body, PSTR("r"), value, sizeof(value), i) && value[0] != '\0' &&
+        !parseTenths(value, &ramp_rate))
+      return program_status_invalid;
+    if (httpFormValue(body, PSTR("h"), value, sizeof(value), i))
+      hold = atol(value);
+    if (httpFormValue(body, PSTR("e"), value, sizeof(value), i))
+      end_action = atol(value);
+    if (ramp_rate < 0 || hold < 0 || hold > PROGRAM_MAX_HOLD ||
+        end_action < 0 || end_action >= STAGE_END_COUNT)
+      return program_status_invalid;
+    s->ramp_rate = ramp_rate;
+    s->hold = hold;
+    s->end_action = end_action;
+    num_stages++;
+  }
+
+  if (!programSetStages(stages, num_stages))
+    return program_status_invalid;
+  if (start && programStart())
+    return program_status_started;
+  return program_status_saved;
 }
 
 void processEthernetPacket(IN uint16_t payload_pos) {
   if (payload_pos) {
+    metricsIncrement(METRIC_ETH_TCP_PAYLOADS);
+
     /* Get the current TCP seq number */
     unsigned int CURRENT_TCP_SEQ_NUM = get_TCP_seq(Ethernet::buffer);
 
@@ -95,79 +881,123 @@ void processEthernetPacket(IN uint16_t payload_pos) {
       char hostname_client_connected[HOSTNAME_MAX_SIZE];
       memset(hostname_client_connected, '\0', sizeof(char) * HOSTNAME_MAX_SIZE);
 
-      ether.printIp("Got connection from: ", clientIP);
+      LOG(LOG_HTTP_REQUEST, logIp(clientIP));
 
       /* Temporary string to store the values read from the http request */
       char str_temp[20];
       if (strncmp("GET /", data, 5) == 0)
       {
         get_hostname_from_http_request(data, hostname_client_connected, HOSTNAME_MAX_SIZE);
-        Serial.println(hostname_client_connected);
 
         data += 5;
         if (data[0] == ' ')
         {
-          Serial.println("HTTP:Main page...");
-          bfill.emit_p(http_OK_200);
-          bfill.emit_p(webpage_main,
-                       hostname_client_connected,
-                       hostname_client_connected
-                       );
+          LOG(LOG_HTTP_ROUTE, HTTP_ROUTE_MAIN);
+          metricsHttpRequest(HTTP_ROUTE_MAIN);
+          emitMainPage(hostname_client_connected);
+          return;
         }
         else if (strncmp( "temp ", data, 5 ) == 0)
         {
-          Serial.println("HTTP:Requesting Temperatures...");
+          LOG(LOG_HTTP_ROUTE, HTTP_ROUTE_TEMP);
+          metricsHttpRequest(HTTP_ROUTE_TEMP);
           readAllTemperatures();
           bfill.emit_p(http_OK_200);
           for (int i = 0; i < numSensors; i++) {
-            tempSensorDesc[i].toCharArray(str_temp, TEMPSENSOR_DESC_STR_LENGTH);
             bfill.emit_p(webpage_temperature,
-                         str_temp,
-                         dtostrf(temperature[i], 4, 2, str_temp + TEMPSENSOR_DESC_STR_LENGTH));
-            //printTemperature(temperature[i], tempSensorDesc[i], oneWirePins[i]);
+                         tempSensorName(i),
+                         dtostrf(temperature[i], 4, 2, str_temp));
+            //printTemperature(temperature[i], tempSensorName(i), tempSensorPin(i));
           }
         }
         else if (strncmp( "ipconfig ", data, 9 ) == 0)
         {
-          Serial.println("HTTP:IP Configuration...");
-          NetEeprom.readIp(myip);
-          NetEeprom.readGateway(gwip);
-          NetEeprom.readDns(dnsip);
-          NetEeprom.readSubnet(netmask);
-
-          bfill.emit_p(http_OK_200);
-          char checked_dhcp[8] = "";
-          if (NetEeprom.isDhcp())
-            strcat(checked_dhcp, "checked\0");
-
-          bfill.emit_p(webpage_ipconfig,
-                       hostname_client_connected,
-                       checked_dhcp,
-                       myip[0], myip[1], myip[2], myip[3],
-                       netmask[0], netmask[1], netmask[2], netmask[3],
-                       gwip[0], gwip[1], gwip[2], gwip[3],
-                       dnsip[0], dnsip[1], dnsip[2], dnsip[3]);
+          LOG(LOG_HTTP_ROUTE, HTTP_ROUTE_IPCONFIG);
+          metricsHttpRequest(HTTP_ROUTE_IPCONFIG);
+          emitIpConfigPage(hostname_client_connected);
 
         }
-        else
+        else if (strncmp( "metrics ", data, 8 ) == 0)
         {
-          for (unsigned int i = 0; i < sizeof(str_temp) - 1; i++ )
-          {
-            if (data[i] == ' ')
-            {
-              str_temp[i] = '\0';
-              break;
+          metricsHttpRequest(HTTP_ROUTE_METRICS);
+          /* The metrics do not fit in a single TCP segment, so
+           * acknowledge the request and send every section in its
+           * own segment. The last segment closes the connection. */
+          ether.httpServerReplyAck();
+          bfill = ether.tcpOffset();
+          bfill.emit_p(http_OK_200_metrics);
+          for (uint8_t section = 0; section < METRICS_SECTION_COUNT; section++) {
+            metricsEmitSection(section, bfill);
+            if (section < METRICS_SECTION_COUNT - 1) {
+              ether.httpServerReply_with_flags(bfill.position(), TCP_FLAGS_ACK_V);
+              bfill = ether.tcpOffset();
             }
-            str_temp[i] = data[i];
           }
+          ether.httpServerReply_with_flags(bfill.position(), TCP_FLAGS_ACK_V | TCP_FLAGS_FIN_V);
+          return;
+        }
+        else if (strncmp( "presets ", data, 8 ) == 0)
+        {
+          metricsHttpRequest(HTTP_ROUTE_PRESETS);
+          emitPresetsPage(hostname_client_connected, presets_status_none);
+          return;
+        }
+        else if (strncmp( "program ", data, 8 ) == 0)
+        {
+          metricsHttpRequest(HTTP_ROUTE_PROGRAM);
+          emitProgramPage(hostname_client_connected, program_status_none);
+          return;
+        }
+        else if (strncmp( "settings ", data, 9 ) == 0)
+        {
+          metricsHttpRequest(HTTP_ROUTE_SETTINGS);
+          emitSettingsPage(hostname_client_connected, settings_status_none);
+        }
+        else if (strncmp( "profile ", data, 8 ) == 0)
+        {
+          metricsHttpRequest(HTTP_ROUTE_PROFILE);
+          bfill.emit_p(http_OK_200_text);
+          profilePrint(bfill);
+        }
+#if TRACING
+        else if (strncmp( "trace ", data, 6 ) == 0)
+        {
+          LOG(LOG_HTTP_ROUTE, HTTP_ROUTE_TRACE);
+          metricsHttpRequest(HTTP_ROUTE_TRACE);
+          /* The trace is binary, and larger than a TCP segment */
+          ether.httpServerReplyAck();
+          bfill = ether.tcpOffset();
+          bfill.emit_p(http_OK_200_binary);
+          uint16_t size = traceSize();
+          uint16_t offset = 0;
+          while (true) {
+            offset += tracePrint(bfill, offset, HTTP_SEGMENT_FILL - bfill.position());
+            if (offset >= size)
+              break;
+            ether.httpServerReply_with_flags(bfill.position(), TCP_FLAGS_ACK_V);
+            bfill = ether.tcpOffset();
+          }
+          ether.httpServerReply_with_flags(bfill.position(), TCP_FLAGS_ACK_V | TCP_FLAGS_FIN_V);
+          return;
+        }
+#endif
+        else
+        {
+          metricsHttpRequest(HTTP_ROUTE_NOT_FOUND);
+          /* The path, truncated */
+          unsigned int i;
+          for (i = 0; i < sizeof(str_temp) - 1 && data[i] != ' ' && data[i] != '\0'; i++)
+            str_temp[i] = data[i];
+          str_temp[i] = '\0';
           bfill.emit_p(http_not_found_404);
           bfill.emit_p(webpage_not_found, str_temp, ether.myip[0], ether.myip[1], ether.myip[2], ether.myip[3]);
         }
       }
       else if (strncmp("POST /ipconfig ", data, 14) == 0)
       {
-        Serial.println("HTTP:IP Configuration set...");
-        int i, j = 0, datalen = strlen(data);
+        LOG(LOG_HTTP_ROUTE, HTTP_ROUTE_IPCONFIG_POST);
+        metricsHttpRequest(HTTP_ROUTE_IPCONFIG_POST);
+        int i, j = 0, datalen;
         /* if read_var_name == true, then we parse the name of the variable
          * we want to read i.e. ip, dns, subnet or gw
          * if read_var_name == false, then we parse the value for the
@@ -183,24 +1013,13 @@ void processEthernetPacket(IN uint16_t payload_pos) {
 
         get_hostname_from_http_request(data, hostname_client_connected, HOSTNAME_MAX_SIZE);
 
-        /* Find the offset that the POSTed data start */
-        while (data[datalen--] != '\n')
-          continue;
-
-        data += (datalen += 2);
-
         /* I noticed that sometimes the actual data is not getting received in
-         * the POST packet, so if the length of the data is zero, receive the
-         * next packet here.
+         * the POST packet. httpFormBody() receives the next packet then.
          */
-        if (strlen(data) == 0) {
-          uint16_t pos = ether.packetLoop(ether.packetReceive());
-          data = (char *) Ethernet::buffer + pos;
-          // Serial.print("Reading second packet: ");
-          // Serial.println(data);
-        }
+        data = httpFormBody(data);
+        datalen = strlen(data);
 
-        for ( i = 0; i <= strlen(data); i++ )
+        for ( i = 0; i <= datalen; i++ )
         {
           /* if we read '=', then the value should follow */
           if (data[i] == '=')
@@ -220,8 +1039,16 @@ void processEthernetPacket(IN uint16_t payload_pos) {
            */
           if (data[i] == '&' || data[i] == '\0')
           {
-            /* so terminate the value string */
-            value[j] = '\0';
+            /* so terminate the value string, or the name if there was no '=' */
+            if (read_var_name)
+            {
+              str_temp[j] = '\0';
+              value[0] = '\0';
+            }
+            else
+            {
+              value[j] = '\0';
+            }
             j = 0;
             /* enable the flag read_var_name so that we can start reading a
              * variable name in the next loop
@@ -236,15 +1063,18 @@ void processEthernetPacket(IN uint16_t payload_pos) {
                  configure the ip address setting by using DHCP
               */
               static_conf_ok = false;
-              if (!NetEeprom.isDhcp())
+              if (!activeNet()->dhcp)
               {
-                NetEeprom.writeDhcpConfig(mymac);
+                net_settings net;
+                memset(&net, 0, sizeof(net));
+                net.dhcp = true;
+                stageNetConfig(&net);
 
                 bfill.emit_p(http_OK_200);
-                bfill.emit_p(webpage_please_connect_manually);
+                bfill.emit_p(webpage_please_connect_manually,
+                             (uint16_t)(NET_CONFIRM_TIMEOUT_MS / 60000));
                 ether.httpServerReply(bfill.position());
-
-                software_Reset();
+                return;
               }
             }
             else if (strncmp(str_temp, "ip", 2) == 0)
@@ -295,7 +1125,7 @@ void processEthernetPacket(IN uint16_t payload_pos) {
                  */
                 if (!subnet_mask_valid(netmask))
                 {
-                  Serial.println("subnet is not a valid mask!");
+                  LOG(LOG_NET_BAD_MASK);
                   static_conf_ok = false;
                   break;
                 }
@@ -309,47 +1139,61 @@ void processEthernetPacket(IN uint16_t payload_pos) {
               continue;
           }
 
-          if (data[i] != '=')
+          /* Longer names and values than the buffers are truncated */
+          if (read_var_name)
           {
-            if (read_var_name)
+            if (j < (int)sizeof(str_temp) - 1)
               str_temp[j++] = data[i];
-            else
-              value[j++] = data[i];
+          }
+          else if (j < (int)sizeof(value) - 1)
+          {
+            value[j++] = data[i];
           }
         }
 
         if (static_conf_ok)
         {
-          NetEeprom.writeManualConfig(mymac, myip, gwip, netmask, dnsip);
+          net_settings net;
+          net.dhcp = false;
+          memcpy(net.ip, myip, 4);
+          memcpy(net.gateway, gwip, 4);
+          memcpy(net.netmask, netmask, 4);
+          memcpy(net.dns, dnsip, 4);
+          stageNetConfig(&net);
 
           bfill.emit_p(http_OK_200);
-          bfill.emit_p(webpage_please_connect_manually);
+          bfill.emit_p(webpage_please_connect_manually,
+                       (uint16_t)(NET_CONFIRM_TIMEOUT_MS / 60000));
           ether.httpServerReply(bfill.position());
-
-          software_Reset();
+          return;
         }
 
-        NetEeprom.readIp(myip);
-        NetEeprom.readGateway(gwip);
-        NetEeprom.readDns(dnsip);
-        NetEeprom.readSubnet(netmask);
-
-        bfill.emit_p(http_OK_200);
-        char checked_dhcp[8] = "";
-        if (NetEeprom.isDhcp())
-          strcat(checked_dhcp, "checked\0");
-
-        bfill.emit_p(webpage_ipconfig,
-                     hostname_client_connected,
-                     checked_dhcp,
-                     myip[0], myip[1], myip[2], myip[3],
-                     netmask[0], netmask[1], netmask[2], netmask[3],
-                     gwip[0], gwip[1], gwip[2], gwip[3],
-                     dnsip[0], dnsip[1], dnsip[2], dnsip[3]);
+        emitIpConfigPage(hostname_client_connected);
 
       }
+      else if (strncmp("POST /presets ", data, 14) == 0)
+      {
+        metricsHttpRequest(HTTP_ROUTE_PRESETS_POST);
+        get_hostname_from_http_request(data, hostname_client_connected, HOSTNAME_MAX_SIZE);
+        emitPresetsPage(hostname_client_connected, presetsFormPost(httpFormBody(data)));
+        return;
+      }
+      else if (strncmp("POST /program ", data, 14) == 0)
+      {
+        metricsHttpRequest(HTTP_ROUTE_PROGRAM_POST);
+        get_hostname_from_http_request(data, hostname_client_connected, HOSTNAME_MAX_SIZE);
+        emitProgramPage(hostname_client_connected, programFormPost(httpFormBody(data)));
+        return;
+      }
+      else if (strncmp("POST /settings ", data, 15) == 0)
+      {
+        metricsHttpRequest(HTTP_ROUTE_SETTINGS_POST);
+        get_hostname_from_http_request(data, hostname_client_connected, HOSTNAME_MAX_SIZE);
+        emitSettingsPage(hostname_client_connected, settingsFormPost(httpFormBody(data)));
+      }
       else
       {
+        metricsHttpRequest(HTTP_ROUTE_UNAUTHORIZED);
         bfill.emit_p(http_unauthorized_401);
         bfill.emit_p(webpage_unauthorized);
       }
@@ -358,6 +1202,7 @@ void processEthernetPacket(IN uint16_t payload_pos) {
       ether.httpServerReply(bfill.position());
     } else {
       //Serial.println("Duplicate request. The received TCP packet has already been served.");
+      metricsIncrement(METRIC_HTTP_DUPLICATES);
       bfill.emit_p(http_OK_200);
       ether.httpServerReply(bfill.position());
     }
@@ -426,20 +1271,19 @@ void get_hostname_from_http_request(IN char data[],
   */
   bool end_of_line = false;
 
-  for (i = 0; i < strlen(data); i++)
+  hostname[0] = '\0';
+  for (i = 0; data[i] != '\0'; i++)
   {
     /* If we are in the middle of a line,
        keep on searching until a \r\n is found.
     */
     if (!end_of_line)
     {
-      if (data[i] == '\r')
+      if (data[i] == '\r' && data[i + 1] == '\n')
       {
-        if (data[++i] == '\n')
-        {
-          /* if found, set end_of_line = true*/
-          end_of_line = true;
-        }
+        /* if found, set end_of_line = true*/
+        i++;
+        end_of_line = true;
       }
     }
     else
@@ -447,29 +1291,22 @@ void get_hostname_from_http_request(IN char data[],
       /* The code runs in this else case whenever a new line is starting */
       end_of_line = false;
       /* If the line starts with 'Host: ', then it should be our line! */
-      if (data[i] == 'H' &&
-          data[i + 1] == 'o' &&
-          data[i + 2] == 's' &&
-          data[i + 3] == 't' &&
-          data[i + 4] == ':' &&
-          data[i + 5] == ' ')
+      if (strncmp_P(data + i, PSTR("Host: "), 6) == 0)
       {
         i += 6;
         int j;
-        for (j = 0; j < hostname_size; j++)
+        /* So read the hostname and store it in the hostname char array
+           until the line or the request ends. A longer hostname than
+           the array is truncated.
+        */
+        for (j = 0; j < hostname_size - 1; j++)
         {
-          /* So read the hostname and store it in the hostname char array
-             until the next line comes,
-          */
-          if (data[i] == '\r' && data[i + 1] == '\n')
-          {
-            hostname[j] = '\0';
-            return;
-          }
-
-
+          if (data[i] == '\0' || data[i] == '\r' || data[i] == '\n')
+            break;
           hostname[j] = data[i++];
         }
+        hostname[j] = '\0';
+        return;
       }
     }
   }
@@ -490,6 +1327,19 @@ unsigned int get_TCP_seq(IN byte *ethBuf) {
   return seq;
 }
 
+char *formatIp(IN const byte ip[4],
+               OUT char str[IP_STR_SIZE]) {
+  char *p = str;
+  for (byte i = 0; i < 4; ++i)
+  {
+    utoa(ip[i], p, 10);
+    p += strlen(p);
+    if (i < 3)
+      *p++ = '.';
+  }
+  return str;
+}
+
 void print_macAddress(IN byte mymac[]) {
   for (byte i = 0; i < 6; ++i)
   {
@@ -12,8 +12,23 @@
 #include "EEPROM.h"
 #include "NetEEPROM.h"
 
-#define ETH_SPI_CHIP_SELECT_PIN 53
+constexpr uint8_t ETH_SPI_CHIP_SELECT_PIN = BOARD.eth_cs_pin;
 #define HOSTNAME_MAX_SIZE 50
+#define IP_STR_SIZE 16 // "255.255.255.255" and the terminating character
+#define NET_BEGIN_RETRY_MS 30000   // Retry the Ethernet controller this often
+#define NET_DHCP_TIMEOUT_MS 60000  // Report that DHCP failed after this long
+#define NET_CONFIRM_TIMEOUT_MS 180000UL // Roll a new configuration back if no HTTP
+                                        // request reaches it in this long
+#define NET_DRAIN_MAX_FRAMES 8     // Frames received per networkTask() at most
+#define NET_DRAIN_BUDGET_US 4000   // Take no further frame after this long
+
+/* The states of the network, advanced by networkTask() */
+typedef enum _net_state {
+  NET_STATE_NO_CONTROLLER = 0,  // The Ethernet controller hasn't started
+  NET_STATE_LINK_DOWN,          // No link
+  NET_STATE_DHCP,               // Waiting for a DHCP lease
+  NET_STATE_UP                  // Configured. Serving HTTP.
+} net_state;
 
 /* The following arrays Will be read by NetEEPROM */
 extern byte myip[4];    // Stores the ethernet interface IP address
@@ -31,17 +46,31 @@ void resetEepromNetworkConfig();
 
 /***f* initNetworkModule
  *
- * Function to be called for initializing the network module
+ * Function to be called for initializing the network module. Reads
+ * the MAC address and, unless skip_controller is true, makes one
+ * attempt to start the Ethernet controller. Returns false if the
+ * controller didn't start; networkTask() retries in the background,
+ * unless skip_controller is true.
  */
-void initNetworkModule();
+bool initNetworkModule(IN bool skip_controller);
 
-/***f* initNetworkModule
+/***f* networkTask
+ *
+ * Call from loop(). Never blocks: it starts the Ethernet controller,
+ * follows the link, configures the addresses (DHCP one packet at a
+ * time), and processes the received packets once the network is up.
+ * Then it drains up to NET_DRAIN_MAX_FRAMES frames, but takes no further
+ * frame after NET_DRAIN_BUDGET_US or when the sensors or the buttons
+ * are due, so that loop() gets to them first. The frames that aren't
+ * for us are dropped before EtherCard parses them.
+ */
+void networkTask();
+
+/***f* networkState
  *
- * Function to be called for initializing the network addresses
- * This function has to be called after the initNetworkModule has
- * been called.
+ * Returns the net_state of the network.
  */
-void initNetworkAddr();
+uint8_t networkState();
 
 /***f* processEthernetPacket
  *
@@ -71,6 +100,8 @@ bool subnet_mask_valid(IN byte subnet_mask[]);
  * If the client used our IP to connect to us, this function will
  * store just an IP address, however, if the client used a domain
  * name to connect to us, this function will return the domain name.
+ * The hostname is always terminated, truncated to hostname_size - 1
+ * characters, and empty if the request has no Host header.
  */
 void get_hostname_from_http_request(IN char data[],
                                     OUT char hostname[],
@@ -89,6 +120,14 @@ bool eth_link_state_up();
 unsigned int get_TCP_seq(IN byte *ethBuf);
 
 
+/***f* formatIp
+ *
+ * Writes the IP address 'ip' in dotted decimal in str
+ * and returns str.
+ */
+char *formatIp(IN const byte ip[4],
+               OUT char str[IP_STR_SIZE]);
+
 /***f* print_macAddress
  *
  * A function to print the MAC address.
@@ -0,0 +1,189 @@
+#include "presets.h"
+#include "eeprom_layout.h"
+#include "temperature.h"
+#include "program.h"
+#include "settings.h"
+#include "EEPROM.h"
+#include "NetEEPROM.h"
+#include "controller.h"
+#include <util/crc16.h>
+
+#define PRESETS_MAGIC 0x5053 // "PS"
+#define PRESETS_VERSION 1
+
+/* The presets as they are stored in the EEPROM. The RAM cache
+ * has the same layout, so loading and storing is a plain copy. */
+typedef struct _preset_store {
+  uint16_t magic;
+  uint8_t version;
+  uint8_t count;
+  preset presets[PRESET_MAX];
+  uint16_t crc;             // CRC-16 of everything above
+} preset_store;
+
+static_assert(sizeof(preset_store) <= EEPROM_PRESETS_SIZE,
+              "The presets don't fit in their EEPROM region");
+static_assert(EEPROM_PRESETS_ADDR + EEPROM_PRESETS_SIZE <= NET_EEPROM_OFFSET ||
+              EEPROM_PRESETS_ADDR >= NET_EEPROM_OFFSET + EEPROM_NET_SIZE,
+              "The presets overlap with the network configuration of NetEEPROM");
+
+static preset_store store;
+
+/* The cooking presets that the device comes with */
+static const preset DEFAULT_PRESETS[] PROGMEM = {
+  {"Beef medium rare", 560, 120, PID_PROFILE_DEFAULT},
+  {"Beef medium", 600, 120, PID_PROFILE_DEFAULT},
+  {"Chicken breast", 640, 90, PID_PROFILE_DEFAULT},
+  {"Pork chops", 600, 120, PID_PROFILE_DEFAULT},
+  {"Salmon", 500, 45, PID_PROFILE_DEFAULT},
+  {"Soft eggs", 630, 45, PID_PROFILE_DEFAULT},
+  {"Vegetables", 840, 60, PID_PROFILE_DEFAULT}
+};
+
+static_assert(countOf(DEFAULT_PRESETS) <= PRESET_MAX, "Too many default presets");
+
+/* A smaller bath heats up faster, so it needs less gain, and a
+ * larger one more. Start from these and tune them for your setup. */
+static const pid_profile PID_PROFILES[PID_PROFILE_COUNT] PROGMEM = {
+  {PID_DEFAULT_KP, PID_DEFAULT_KI, PID_DEFAULT_KD},
+  {PID_DEFAULT_KP / 2, PID_DEFAULT_KI / 2, PID_DEFAULT_KD},
+  {PID_DEFAULT_KP * 3 / 2, PID_DEFAULT_KI * 3 / 2, PID_DEFAULT_KD}
+};
+
+static const char pid_profile_default[] PROGMEM = "default";
+static const char pid_profile_small_bath[] PROGMEM = "small bath";
+static const char pid_profile_large_bath[] PROGMEM = "large bath";
+
+static const char * const PID_PROFILE_NAMES[PID_PROFILE_COUNT] PROGMEM = {
+  pid_profile_default, pid_profile_small_bath, pid_profile_large_bath
+};
+
+static uint16_t storeCrc() {
+  uint16_t crc = 0xFFFF;
+  const uint8_t *p = (const uint8_t *)&store;
+
+  for (uint16_t i = 0; i < offsetof(preset_store, crc); i++)
+    crc = _crc16_update(crc, p[i]);
+
+  return crc;
+}
+
+/***f* storeWrite
+ *
+ * Writes the RAM cache in the EEPROM. EEPROM.update() skips the bytes
+ * that didn't change, so editing one preset writes only that preset
+ * and the header. Every written byte takes 3.3ms.
+ */
+static void storeWrite() {
+  const uint8_t *p = (const uint8_t *)&store;
+
+  store.crc = storeCrc();
+  for (uint16_t i = 0; i < sizeof(store); i++)
+    EEPROM.update(EEPROM_PRESETS_ADDR + i, p[i]);
+}
+
+void presetsInit() {
+  uint8_t *p = (uint8_t *)&store;
+
+  for (uint16_t i = 0; i < sizeof(store); i++)
+    p[i] = EEPROM.read(EEPROM_PRESETS_ADDR + i);
+
+  if (store.magic == PRESETS_MAGIC && store.version == PRESETS_VERSION &&
+      store.count <= PRESET_MAX && store.crc == storeCrc())
+    return;
+
+  Serial.println(F("Presets: nothing valid in EEPROM. Storing the defaults."));
+  memset(&store, 0, sizeof(store));
+  store.magic = PRESETS_MAGIC;
+  store.version = PRESETS_VERSION;
+  store.count = countOf(DEFAULT_PRESETS);
+  memcpy_P(store.presets, DEFAULT_PRESETS, sizeof(DEFAULT_PRESETS));
+  storeWrite();
+}
+
+uint8_t presetCount() {
+  return store.count;
+}
+
+const preset *presetGet(IN uint8_t index) {
+  if (index >= store.count)
+    return NULL;
+  return &store.presets[index];
+}
+
+float presetTemperature(IN const preset *p) {
+  return p->temperature / 10.0;
+}
+
+bool presetValid(IN const preset *p) {
+  return p->name[0] != '\0' &&
+         memchr(p->name, '\0', PRESET_NAME_SIZE) != NULL &&
+         p->temperature >= MIN_TEMPERATURE * 10 &&
+         p->temperature <= MAX_TEMPERATURE * 10 &&
+         p->pid_profile < PID_PROFILE_COUNT;
+}
+
+uint8_t presetSave(IN uint8_t index,
+                   IN const preset *p) {
+  if (!presetValid(p))
+    return PRESET_NONE;
+
+  if (index == PRESET_NONE) {
+    if (store.count == PRESET_MAX)
+      return PRESET_NONE;
+    index = store.count++;
+  } else if (index >= store.count) {
+    return PRESET_NONE;
+  }
+
+  store.presets[index] = *p;
+  storeWrite();
+  return index;
+}
+
+bool presetDelete(IN uint8_t index) {
+  if (index >= store.count)
+    return false;
+
+  memmove(&store.presets[index], &store.presets[index + 1],
+          (store.count - index - 1) * sizeof(preset));
+  store.count--;
+  memset(&store.presets[store.count], 0, sizeof(preset));
+  storeWrite();
+  return true;
+}
+
+bool presetApply(IN uint8_t index) {
+  const preset *p = presetGet(index);
+  if (p == NULL)
+    return false;
+
+  pid_profile tunings;
+  memcpy_P(&tunings, &PID_PROFILES[p->pid_profile], sizeof(tunings));
+  double temperature = presetTemperature(p);
+
+  /* desired_temperature is a 4 byte double that the Timer1 ISR reads,
+   * and controllerSetTunings() changes three more. Update all of them at once. */
+  uint8_t oldSREG = SREG;
+  cli();
+  desired_temperature = temperature;
+  controllerSetTunings(tunings.kp, tunings.ki, tunings.kd);
+  SREG = oldSREG;
+
+  settingsSetDesiredTemperature(temperature);
+  settingsSetTunings(tunings.kp, tunings.ki, tunings.kd);
+
+  /* A preset with a duration is a one stage cook program */
+  if (p->duration)
+    programStartHold(p->temperature, p->duration);
+  else
+    programStop();
+
+  return true;
+}
+
+const char *pidProfileName(IN uint8_t id) {
+  if (id >= PID_PROFILE_COUNT)
+    id = PID_PROFILE_DEFAULT;
+  return (const char *)pgm_read_word(&PID_PROFILE_NAMES[id]);
+}
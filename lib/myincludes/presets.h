@@ -0,0 +1,104 @@
+#ifndef presets_h
+#define presets_h
+#ifdef __cplusplus
+
+#include "common.h"
+
+#define PRESET_NAME_SIZE LCD_COLS_CHAR_LIMIT // A preset name fits in one LCD line
+#define PRESET_MAX 10                        // How many presets fit in the store
+#define PRESET_NONE 0xFF                     // Index of "no preset"
+
+/* The tunings of the default PID profile, and of the default settings */
+#define PID_DEFAULT_KP 850
+#define PID_DEFAULT_KI 0.5
+#define PID_DEFAULT_KD 0.1
+
+/* The PID profiles that a preset can use. See PID_PROFILES in presets.cpp */
+typedef enum _pid_profile_id {
+  PID_PROFILE_DEFAULT = 0,
+  PID_PROFILE_SMALL_BATH,
+  PID_PROFILE_LARGE_BATH,
+  PID_PROFILE_COUNT
+} pid_profile_id;
+
+typedef struct _pid_profile {
+  float kp, ki, kd;
+} pid_profile;
+
+typedef struct _preset {
+  char name[PRESET_NAME_SIZE];
+  int16_t temperature;          // in 1/10 Celsius, so that 56.5C is 565
+  uint16_t duration;            // in minutes. 0 if the preset has no duration.
+  uint8_t pid_profile;          // One of pid_profile_id
+} preset;
+
+/***f* presetsInit
+ *
+ * Loads the presets from the EEPROM in the RAM cache. If the CRC of
+ * the stored presets is wrong (or nothing was ever stored), the
+ * built-in presets are written in the EEPROM instead.
+ * Call once from setup().
+ */
+void presetsInit();
+
+/***f* presetCount
+ *
+ * Returns the number of the cooking presets.
+ */
+uint8_t presetCount();
+
+/***f* presetGet
+ *
+ * Returns the preset 'index' (0 to presetCount() - 1) from
+ * the RAM cache, or NULL if it doesn't exist.
+ */
+const preset *presetGet(IN uint8_t index);
+
+/***f* presetTemperature
+ *
+ * Returns the temperature of p in Celsius.
+ */
+float presetTemperature(IN const preset *p);
+
+/***f* presetValid
+ *
+ * Returns true if p can be stored: a non-empty name, a temperature
+ * between MIN_TEMPERATURE and MAX_TEMPERATURE and a known PID profile.
+ */
+bool presetValid(IN const preset *p);
+
+/***f* presetSave
+ *
+ * Stores p in the position 'index', or appends it if index is
+ * PRESET_NONE. Returns the index of the preset, or PRESET_NONE if
+ * p is not valid or the store is full.
+ */
+uint8_t presetSave(IN uint8_t index,
+                   IN const preset *p);
+
+/***f* presetDelete
+ *
+ * Deletes the preset 'index'. The following presets move one
+ * position up. Returns false if the preset doesn't exist.
+ */
+bool presetDelete(IN uint8_t index);
+
+/***f* presetApply
+ *
+ * Sets the desired_temperature and the PID tunings of the preset
+ * 'index' together, with the interrupts disabled, so that the control
+ * ISR never sees the temperature of one preset with the tunings of
+ * another. A preset with a duration starts a one stage cook program
+ * (see program.h), any other stops the running program.
+ * Returns false if the preset doesn't exist.
+ */
+bool presetApply(IN uint8_t index);
+
+/***f* pidProfileName
+ *
+ * Returns the name of the PID profile (a PROGMEM string).
+ */
+const char *pidProfileName(IN uint8_t id);
+
+#endif // endif __cpluscplus
+#endif // endif presets_h
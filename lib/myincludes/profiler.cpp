@@ -0,0 +1,78 @@
+#include "profiler.h"
+
+#if PROFILING
+static const char stage_read_temperatures[] PROGMEM = "read_temperatures";
+static const char stage_eth_receive[] PROGMEM = "eth_receive";
+static const char stage_eth_packet_loop[] PROGMEM = "eth_packet_loop";
+static const char stage_eth_process[] PROGMEM = "eth_process";
+static const char stage_lcd_flush[] PROGMEM = "lcd_flush";
+static const char stage_opstate_handlers[] PROGMEM = "opstate_handlers";
+static const char stage_control_isr[] PROGMEM = "control_isr";
+
+static const char * const profileStageNames[PROFILE_STAGE_COUNT] PROGMEM = {
+  stage_read_temperatures, stage_eth_receive, stage_eth_packet_loop,
+  stage_eth_process, stage_lcd_flush, stage_opstate_handlers,
+  stage_control_isr
+};
+
+typedef struct _profile_stats {
+  uint32_t count;   // Number of recorded runs
+  uint32_t min_us;
+  uint32_t max_us;
+  uint32_t sum_us;  // sum_us and sum_n are used for the average. Both are
+  uint32_t sum_n;   // halved before sum_us overflows, so the average is kept.
+} profile_stats;
+
+static profile_stats stats[PROFILE_STAGE_COUNT];
+
+void profileRecord(IN profile_stage stage,
+                   IN uint32_t elapsed_us) {
+  profile_stats *s = &stats[stage];
+
+  if (s->count == 0 || elapsed_us < s->min_us)
+    s->min_us = elapsed_us;
+  if (elapsed_us > s->max_us)
+    s->max_us = elapsed_us;
+  s->count++;
+
+  if (s->sum_us > 0x7FFFFFFFUL - elapsed_us) {
+    s->sum_us >>= 1;
+    s->sum_n >>= 1;
+  }
+  s->sum_us += elapsed_us;
+  s->sum_n++;
+}
+#endif
+
+void profilePrint(OUT Print &out) {
+#if PROFILING
+  out.print(F("stage min_us avg_us max_us count\n"));
+  for (uint8_t i = 0; i < PROFILE_STAGE_COUNT; i++) {
+    /* The ISR stage may be updated while we print */
+    cli();
+    profile_stats s = stats[i];
+    sei();
+
+    out.print((const __FlashStringHelper *)pgm_read_word(&profileStageNames[i]));
+    out.print(' ');
+    out.print(s.min_us);
+    out.print(' ');
+    out.print(s.sum_n ? s.sum_us / s.sum_n : 0);
+    out.print(' ');
+    out.print(s.max_us);
+    out.print(' ');
+    out.print(s.count);
+    out.print('\n');
+  }
+#else
+  out.print(F("Profiling is disabled in this build\n"));
+#endif
+}
+
+void profileReset() {
+#if PROFILING
+  cli();
+  memset(stats, 0, sizeof(stats));
+  sei();
+#endif
+}
@@ -0,0 +1,67 @@
+#ifndef profiler_h
+#define profiler_h
+#ifdef __cplusplus
+
+#include "common.h"
+
+/* The stages of the firmware that we measure. Stages may be nested,
+ * e.g. PROFILE_ETH_PROCESS may call readAllTemperatures().
+ * The order must match the names in profiler.cpp
+ */
+typedef enum _profile_stage {
+  PROFILE_READ_TEMPERATURES = 0, // readAllTemperatures() from loop()
+  PROFILE_ETH_RECEIVE,           // ether.packetReceive()
+  PROFILE_ETH_PACKET_LOOP,       // ether.packetLoop()
+  PROFILE_ETH_PROCESS,           // processEthernetPacket()
+  PROFILE_LCD_FLUSH,             // lcdBufferFlush()
+  PROFILE_OPSTATE_HANDLERS,      // The opState functions in loop()
+  PROFILE_CONTROL_ISR,           // The 10ms Timer1 ISR
+  PROFILE_STAGE_COUNT
+} profile_stage;
+
+#if PROFILING
+
+/***f* profileRecord
+ *
+ * Records that the stage took 'elapsed_us' microseconds.
+ * Safe to call from an ISR.
+ */
+void profileRecord(IN profile_stage stage,
+                   IN uint32_t elapsed_us);
+
+/* A ProfileScope measures the time from its construction until it
+ * goes out of scope and records it for the stage. Use it through the
+ * PROFILE_SCOPE macro so that it compiles to nothing when PROFILING is 0.
+ */
+class ProfileScope {
+  public:
+    ProfileScope(IN profile_stage stage) : _stage(stage), _start(micros()) {}
+    ~ProfileScope() { profileRecord(_stage, micros() - _start); }
+  private:
+    profile_stage _stage;
+    unsigned long _start;
+};
+
+#define PROFILE_SCOPE(stage) ProfileScope _profile_scope_##stage(stage)
+
+#else
+
+#define PROFILE_SCOPE(stage)
+
+#endif // endif PROFILING
+
+/***f* profilePrint
+ *
+ * Prints the min/avg/max/count of every stage in microseconds.
+ * 'out' can be the Serial or the BufferFiller of an HTTP reply.
+ */
+void profilePrint(OUT Print &out);
+
+/***f* profileReset
+ *
+ * Clears the figures of all the stages.
+ */
+void profileReset();
+
+#endif // endif __cpluscplus
+#endif // endif profiler_h
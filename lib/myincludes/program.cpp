@@ -0,0 +1,227 @@
+#include "program.h"
+#include "temperature.h"
+
+/* The program. By default: 55C for 2 hours, then ramp to 60C with
+ * 1C per minute, 30 minutes there, and then keep the temperature. */
+static program_stage stages[PROGRAM_MAX_STAGES] = {
+  {550, 0, 120, STAGE_END_NEXT},
+  {600, 10, 30, STAGE_END_HOLD}
+};
+static uint8_t numStages = 2;
+
+/* Changed by the ISR. Change them from loop() only with the
+ * interrupts disabled. */
+static volatile uint8_t state = PROGRAM_IDLE;
+static volatile uint8_t stage = 0;
+static uint32_t rampTicks = 0;      // Ticks since the ramp of the stage started
+static double rampStart;            // The setpoint when the ramp started
+static uint32_t holdTicksLeft = 0;
+static volatile bool notify = false;
+static volatile bool offRequest = false;
+
+static bool stageValid(IN const program_stage *s) {
+  return s->temperature >= MIN_TEMPERATURE * 10 &&
+         s->temperature <= MAX_TEMPERATURE * 10 &&
+         s->hold <= PROGRAM_MAX_HOLD &&
+         s->end_action < STAGE_END_COUNT;
+}
+
+/* The functions below run in the ISR or with the interrupts disabled */
+
+static void enterStage(IN uint8_t index) {
+  stage = index;
+  rampTicks = 0;
+  rampStart = desired_temperature;
+  state = PROGRAM_RAMP;
+}
+
+static void endStage() {
+  uint8_t action = stages[stage].end_action;
+
+  if (action == STAGE_END_NEXT && stage + 1 < numStages) {
+    enterStage(stage + 1);
+    return;
+  }
+
+  state = PROGRAM_DONE;
+  notify = true;
+  if (action == STAGE_END_OFF)
+    offRequest = true;
+}
+
+void programTick() {
+  if (state == PROGRAM_IDLE || state == PROGRAM_DONE)
+    return;
+
+  const program_stage *s = &stages[stage];
+  double target = s->temperature / 10.0;
+
+  switch (state) {
+    case PROGRAM_RAMP:
+    {
+      double distance = fabs(target - rampStart);
+      double moved = distance;
+
+      if (s->ramp_rate != 0) {
+        rampTicks++;
+        moved = (double)s->ramp_rate * rampTicks / (10.0 * PROGRAM_TICKS_PER_MINUTE);
+      }
+
+      if (moved >= distance) {
+        desired_temperature = target;
+        state = PROGRAM_HEAT;
+      } else {
+        desired_temperature = (target > rampStart) ? rampStart + moved : rampStart - moved;
+      }
+      break;
+    }
+    case PROGRAM_HEAT:
+      if (fabs(current_temperature - target) * 10 <= PROGRAM_AT_TARGET_TENTHS) {
+        holdTicksLeft = (uint32_t)s->hold * PROGRAM_TICKS_PER_MINUTE;
+        state = PROGRAM_HOLD;
+      }
+      break;
+    case PROGRAM_HOLD:
+      if (holdTicksLeft > 0)
+        holdTicksLeft--;
+      if (holdTicksLeft == 0)
+        endStage();
+      break;
+  }
+}
+
+const program_stage *programGetStages(OUT uint8_t *num_stages) {
+  *num_stages = numStages;
+  return stages;
+}
+
+bool programSetStages(IN const program_stage *new_stages,
+                      IN uint8_t num_stages) {
+  if (num_stages == 0 || num_stages > PROGRAM_MAX_STAGES)
+    return false;
+  if (state != PROGRAM_IDLE && state != PROGRAM_DONE)
+    return false;
+
+  for (uint8_t i = 0; i < num_stages; i++)
+    if (!stageValid(&new_stages[i]))
+      return false;
+
+  memcpy(stages, new_stages, num_stages * sizeof(program_stage));
+  numStages = num_stages;
+  return true;
+}
+
+bool programStart() {
+  if (numStages == 0)
+    return false;
+
+  uint8_t oldSREG = SREG;
+  cli();
+  notify = false;
+  offRequest = false;
+  enterStage(0);
+  /* Ramp from where the water is */
+  rampStart = current_temperature;
+  SREG = oldSREG;
+
+  return true;
+}
+
+void programStartHold(IN int16_t temperature,
+                      IN uint16_t hold) {
+  uint8_t oldSREG = SREG;
+  cli();
+  stages[0].temperature = temperature;
+  stages[0].ramp_rate = 0;
+  stages[0].hold = hold;
+  stages[0].end_action = STAGE_END_HOLD;
+  numStages = 1;
+  SREG = oldSREG;
+
+  programStart();
+}
+
+void programStop() {
+  uint8_t oldSREG = SREG;
+  cli();
+  state = PROGRAM_IDLE;
+  SREG = oldSREG;
+}
+
+void programNextStage() {
+  uint8_t oldSREG = SREG;
+  cli();
+  if (state == PROGRAM_RAMP || state == PROGRAM_HEAT || state == PROGRAM_HOLD)
+    endStage();
+  SREG = oldSREG;
+}
+
+void programGetStatus(OUT program_status *status) {
+  uint8_t oldSREG = SREG;
+  cli();
+  status->state = state;
+  status->stage = stage;
+  status->num_stages = numStages;
+  status->notify = notify;
+  if (state == PROGRAM_HOLD)
+    status->hold_left_s = holdTicksLeft / (PROGRAM_TICKS_PER_MINUTE / 60);
+  else if (state == PROGRAM_RAMP || state == PROGRAM_HEAT)
+    status->hold_left_s = (uint32_t)stages[stage].hold * 60;
+  else
+    status->hold_left_s = 0;
+  SREG = oldSREG;
+}
+
+void programAcknowledge() {
+  notify = false;
+}
+
+bool programTakeOffRequest() {
+  if (!offRequest)
+    return false;
+  offRequest = false;
+  return true;
+}
+
+void programSaveState(OUT program_checkpoint *cp) {
+  uint8_t oldSREG = SREG;
+  cli();
+  cp->state = state;
+  cp->stage = stage;
+  cp->num_stages = numStages;
+  cp->notify = notify;
+  cp->ramp_ticks = rampTicks;
+  cp->ramp_start = rampStart;
+  cp->hold_ticks_left = holdTicksLeft;
+  SREG = oldSREG;
+
+  /* The stages change only while the program doesn't run */
+  memcpy(cp->stages, stages, sizeof(stages));
+}
+
+bool programRestoreState(IN const program_checkpoint *cp) {
+  bool valid = cp->state <= PROGRAM_DONE &&
+               cp->num_stages > 0 && cp->num_stages <= PROGRAM_MAX_STAGES &&
+               cp->stage < cp->num_stages;
+
+  for (uint8_t i = 0; valid && i < cp->num_stages; i++)
+    valid = stageValid(&cp->stages[i]);
+
+  uint8_t oldSREG = SREG;
+  cli();
+  if (valid) {
+    memcpy(stages, cp->stages, sizeof(stages));
+    numStages = cp->num_stages;
+    stage = cp->stage;
+    notify = cp->notify;
+    rampTicks = cp->ramp_ticks;
+    rampStart = cp->ramp_start;
+    holdTicksLeft = cp->hold_ticks_left;
+    state = cp->state;
+  } else {
+    state = PROGRAM_IDLE;
+  }
+  SREG = oldSREG;
+
+  return valid;
+}
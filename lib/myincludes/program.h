@@ -0,0 +1,148 @@
+#ifndef program_h
+#define program_h
+#ifdef __cplusplus
+
+#include "common.h"
+
+/* A cook program is a short list of stages. Every stage moves the
+ * setpoint to its temperature (at once, or with a ramp), waits until
+ * the water gets there, holds it for the hold time and then runs its
+ * end action.
+ *
+ * The executor runs in the 10ms Timer1 ISR (programTick()), so the
+ * ramps move the setpoint a little on every control tick, and the hold
+ * timers count control ticks.
+ */
+#define PROGRAM_MAX_STAGES 6
+#define PROGRAM_TICKS_PER_MINUTE 6000     // 10ms control ticks
+#define PROGRAM_AT_TARGET_TENTHS 5        // The hold starts within 0.5C of the target
+#define PROGRAM_MAX_HOLD 9999             // minutes, about a week
+
+typedef enum _stage_end_action {
+  STAGE_END_NEXT = 0,  // Go to the next stage. The last stage holds like STAGE_END_HOLD.
+  STAGE_END_HOLD,      // Keep the temperature, finish the program and notify
+  STAGE_END_OFF,       // Turn the heater off, finish the program and notify
+  STAGE_END_COUNT
+} stage_end_action;
+
+typedef struct _program_stage {
+  int16_t temperature;  // in 1/10 Celsius
+  uint16_t ramp_rate;   // in 1/10 Celsius per minute. 0 to jump to the temperature.
+  uint16_t hold;        // in minutes, counted from when the water reaches the temperature
+  uint8_t end_action;   // One of stage_end_action
+} program_stage;
+
+typedef enum _program_state {
+  PROGRAM_IDLE = 0,     // No program
+  PROGRAM_RAMP,         // The setpoint moves towards the temperature of the stage
+  PROGRAM_HEAT,         // The setpoint is there, waiting for the water
+  PROGRAM_HOLD,         // Counting down the hold time
+  PROGRAM_DONE          // Finished. The end action of the last stage has run.
+} program_state;
+
+typedef struct _program_status {
+  uint8_t state;        // One of program_state
+  uint8_t stage;        // The current stage, from 0
+  uint8_t num_stages;
+  uint32_t hold_left_s; // The hold time left in the current stage, in seconds
+  bool notify;          // The program has finished and nobody has seen it yet
+} program_status;
+
+/* Everything that is needed to continue a program after a reset */
+typedef struct _program_checkpoint {
+  uint8_t state;
+  uint8_t stage;
+  uint8_t num_stages;
+  bool notify;
+  uint32_t ramp_ticks;
+  float ramp_start;
+  uint32_t hold_ticks_left;
+  program_stage stages[PROGRAM_MAX_STAGES];
+} program_checkpoint;
+
+/***f* programGetStages
+ *
+ * Returns the stages of the program and their number in num_stages.
+ * They can be changed only with programSetStages().
+ */
+const program_stage *programGetStages(OUT uint8_t *num_stages);
+
+/***f* programSetStages
+ *
+ * Replaces the program with the first 'num_stages' of 'new_stages'.
+ * It doesn't work while the program runs. Returns false if a stage
+ * is not valid, and then the program doesn't change.
+ */
+bool programSetStages(IN const program_stage *new_stages,
+                      IN uint8_t num_stages);
+
+/***f* programStart
+ *
+ * Starts the program from the first stage. The ramp of the first stage
+ * starts from the current water temperature.
+ */
+bool programStart();
+
+/***f* programStartHold
+ *
+ * Replaces the program with a single stage that jumps to 'temperature'
+ * (in 1/10 Celsius), holds it for 'hold' minutes and then notifies.
+ * Used for the presets with a duration.
+ */
+void programStartHold(IN int16_t temperature,
+                      IN uint16_t hold);
+
+/***f* programStop
+ *
+ * Stops the program. The setpoint stays where it is.
+ */
+void programStop();
+
+/***f* programNextStage
+ *
+ * Skips the rest of the current stage.
+ */
+void programNextStage();
+
+/***f* programTick
+ *
+ * Call from the Timer1 ISR on every tick that the heater is under
+ * control. Moves the ramp, checks the water temperature and counts
+ * the hold time.
+ */
+void programTick();
+
+/***f* programGetStatus
+ *
+ * Returns a consistent copy of the state of the executor.
+ */
+void programGetStatus(OUT program_status *status);
+
+/***f* programAcknowledge
+ *
+ * Clears the notification of a finished program.
+ */
+void programAcknowledge();
+
+/***f* programTakeOffRequest
+ *
+ * Returns true once after a STAGE_END_OFF stage has finished. The
+ * ISR can't turn the device off itself, so loop() does it.
+ */
+bool programTakeOffRequest();
+
+/***f* programSaveState
+ *
+ * Copies the stages and the state of the executor in 'cp'.
+ */
+void programSaveState(OUT program_checkpoint *cp);
+
+/***f* programRestoreState
+ *
+ * Continues the program of 'cp' where programSaveState() left it.
+ * Returns false, and stops the program, if 'cp' is not valid.
+ */
+bool programRestoreState(IN const program_checkpoint *cp);
+
+#endif // endif __cpluscplus
+#endif // endif program_h
@@ -0,0 +1,134 @@
+#include "settings.h"
+#include "eeprom_layout.h"
+#include "eeprom_log.h"
+#include "network.h"
+#include "presets.h"
+#include "temperature.h"
+#include "metrics.h"
+
+#define SETTINGS_SLOTS (EEPROM_SETTINGS_SIZE / SETTINGS_SLOT_SIZE)
+
+static_assert(sizeof(settings) + EEPROM_LOG_OVERHEAD <= SETTINGS_SLOT_SIZE,
+              "The settings don't fit in a slot. Increase SETTINGS_SLOT_SIZE.");
+static_assert(SETTINGS_SLOTS >= 2, "The settings need at least two slots");
+static_assert(EEPROM_SETTINGS_ADDR >= EEPROM_PRESETS_ADDR + EEPROM_PRESETS_SIZE &&
+              EEPROM_SETTINGS_ADDR + EEPROM_SETTINGS_SIZE <= NET_EEPROM_OFFSET,
+              "The settings overlap with another EEPROM region");
+
+static const settings DEFAULT_SETTINGS PROGMEM = {
+  MIN_TEMPERATURE * 10,
+  PID_DEFAULT_KP, PID_DEFAULT_KI, PID_DEFAULT_KD,
+  30000,
+  30000,
+  30
+};
+
+static settings current;
+static net_settings net;
+
+static uint8_t logBuffer[SETTINGS_SLOT_SIZE];
+static eeprom_log settingsLog = EEPROM_LOG(EEPROM_SETTINGS_ADDR, EEPROM_SETTINGS_SIZE,
+                                           SETTINGS_SLOT_SIZE, logBuffer);
+
+/* A change that waits for the quiet period */
+static bool dirty = false;
+static unsigned long lastChange = 0;
+
+void settingsInit() {
+  uint8_t version;
+
+  /* A record of an older version is shorter, and is loaded over
+   * the defaults of the fields that it doesn't have */
+  memcpy_P(&current, &DEFAULT_SETTINGS, sizeof(current));
+  if (!eepromLogLoad(&settingsLog, &current, sizeof(current), &version))
+    Serial.println(F("Settings: nothing valid in EEPROM. Using the defaults."));
+
+  net.dhcp = NetEeprom.isDhcp();
+  NetEeprom.readIp(net.ip);
+  NetEeprom.readGateway(net.gateway);
+  NetEeprom.readDns(net.dns);
+  NetEeprom.readSubnet(net.netmask);
+}
+
+const settings *settingsGet() {
+  return &current;
+}
+
+static void changed() {
+  dirty = true;
+  lastChange = millis();
+}
+
+void settingsSetDesiredTemperature(IN double temperature) {
+  int16_t tenths = (int16_t)(temperature * 10 + (temperature < 0 ? -0.5 : 0.5));
+
+  if (tenths == current.desired_temperature)
+    return;
+  current.desired_temperature = tenths;
+  changed();
+}
+
+void settingsSetTunings(IN float kp,
+                        IN float ki,
+                        IN float kd) {
+  if (kp == current.kp && ki == current.ki && kd == current.kd)
+    return;
+  current.kp = kp;
+  current.ki = ki;
+  current.kd = kd;
+  changed();
+}
+
+void settingsSetTimeouts(IN uint32_t lcd_backlight_timeout,
+                         IN uint16_t menu_return_timeout) {
+  if (lcd_backlight_timeout == current.lcd_backlight_timeout &&
+      menu_return_timeout == current.menu_return_timeout)
+    return;
+  current.lcd_backlight_timeout = lcd_backlight_timeout;
+  current.menu_return_timeout = menu_return_timeout;
+  changed();
+}
+
+void settingsTask() {
+  if (eepromLogTask(&settingsLog))
+    metricsIncrement(METRIC_SETTINGS_WRITES);
+
+  if (dirty && !eepromLogBusy(&settingsLog) && millis() - lastChange >= SETTINGS_QUIET_MS) {
+    /* Changes after this point wait for the next record */
+    eepromLogAppend(&settingsLog, &current, sizeof(current), SETTINGS_VERSION);
+    dirty = false;
+  }
+}
+
+bool settingsPending() {
+  return dirty || eepromLogBusy(&settingsLog);
+}
+
+const net_settings *settingsNet() {
+  return &net;
+}
+
+void settingsSetNetDhcp() {
+  NetEeprom.writeDhcpConfig(mymac);
+  net.dhcp = true;
+}
+
+void settingsSetNetStatic(IN const byte *ip,
+                          IN const byte *gateway,
+                          IN const byte *netmask,
+                          IN const byte *dns) {
+  /* NetEEPROM doesn't take const pointers */
+  memcpy(net.ip, ip, 4);
+  memcpy(net.gateway, gateway, 4);
+  memcpy(net.netmask, netmask, 4);
+  memcpy(net.dns, dns, 4);
+  net.dhcp = false;
+  NetEeprom.writeManualConfig(mymac, net.ip, net.gateway, net.netmask, net.dns);
+}
+
+void settingsSetResumeWindow(IN uint8_t tenths) {
+  if (tenths == current.resume_window)
+    return;
+  current.resume_window = tenths;
+  changed();
+}
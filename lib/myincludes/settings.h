@@ -0,0 +1,122 @@
+#ifndef settings_h
+#define settings_h
+#ifdef __cplusplus
+
+#include "common.h"
+
+/* The settings that survive a reboot. They are kept in RAM and every
+ * read is served from there. When they change, they are written in the
+ * EEPROM only after SETTINGS_QUIET_MS without another change, so that
+ * holding the UP button for a while costs one EEPROM write and not one
+ * per step.
+ *
+ * The EEPROM region of the settings is an append-only log of
+ * SETTINGS_SLOT_SIZE slots (see eeprom_log.h), so the writes are
+ * spread over all the slots.
+ */
+#define SETTINGS_VERSION 2
+#define SETTINGS_SLOT_SIZE 32
+#define SETTINGS_QUIET_MS 10000
+
+/* lcd_backlight_timeout value for a backlight that never turns off */
+#define SETTINGS_BACKLIGHT_ALWAYS_ON 0xFFFFFFFF
+
+/* Only append new fields at the end, and increase SETTINGS_VERSION.
+ * A record of an older version is loaded over the defaults, so the
+ * new fields keep their default values. */
+typedef struct _settings {
+  int16_t desired_temperature;    // in 1/10 Celsius
+  float kp, ki, kd;               // The PID tunings
+  uint32_t lcd_backlight_timeout; // in milliseconds
+  uint16_t menu_return_timeout;   // in milliseconds
+  /* Version 2 */
+  uint8_t resume_window;          // in 1/10 Celsius. See checkpoint.h.
+} settings;
+
+/* The network configuration. It stays in the format of NetEEPROM,
+ * which reads it at boot, and is cached here. */
+typedef struct _net_settings {
+  bool dhcp;
+  byte ip[4], gateway[4], dns[4], netmask[4];
+} net_settings;
+
+/***f* settingsInit
+ *
+ * Loads the newest valid settings record from the EEPROM, or the
+ * defaults if there is none, and caches the network configuration
+ * of NetEEPROM. Call once from setup(), before anything reads the
+ * settings.
+ */
+void settingsInit();
+
+/***f* settingsGet
+ *
+ * Returns the settings from RAM.
+ */
+const settings *settingsGet();
+
+/***f* settingsSetDesiredTemperature
+ *
+ * Stores the desired temperature that is restored at boot.
+ */
+void settingsSetDesiredTemperature(IN double temperature);
+
+/***f* settingsSetTunings
+ *
+ * Stores the PID tunings that are restored at boot.
+ */
+void settingsSetTunings(IN float kp,
+                        IN float ki,
+                        IN float kd);
+
+/***f* settingsSetTimeouts
+ *
+ * Stores the LCD backlight and menu return timeouts (in milliseconds).
+ */
+void settingsSetTimeouts(IN uint32_t lcd_backlight_timeout,
+                         IN uint16_t menu_return_timeout);
+
+/***f* settingsSetResumeWindow
+ *
+ * Stores how close to the setpoint (in 1/10 Celsius) the water must
+ * still be for a cook to resume after a reset. 0 to never resume.
+ */
+void settingsSetResumeWindow(IN uint8_t tenths);
+
+/***f* settingsTask
+ *
+ * Call from loop(). Once the settings haven't changed for
+ * SETTINGS_QUIET_MS, writes them in the next slot, one byte per call
+ * and only when the EEPROM is ready, so it never waits for a write.
+ */
+void settingsTask();
+
+/***f* settingsPending
+ *
+ * Returns true if there are changes that are not in the EEPROM yet.
+ */
+bool settingsPending();
+
+/***f* settingsNet
+ *
+ * Returns the network configuration from RAM.
+ */
+const net_settings *settingsNet();
+
+/***f* settingsSetNetDhcp
+ *
+ * Stores a DHCP network configuration. Used after a reset.
+ */
+void settingsSetNetDhcp();
+
+/***f* settingsSetNetStatic
+ *
+ * Stores a static network configuration. Used after a reset.
+ */
+void settingsSetNetStatic(IN const byte *ip,
+                          IN const byte *gateway,
+                          IN const byte *netmask,
+                          IN const byte *dns);
+
+#endif // endif __cpluscplus
+#endif // endif settings_h
@@ -1,16 +1,14 @@
 #include "temperature.h"
-
-byte oneWirePins[] = {
-  TEMP_SENSOR_1_PIN, TEMP_SENSOR_2_PIN, TEMP_SENSOR_3_PIN, TEMP_SENSOR_4_PIN
-};
-
-String tempSensorDesc[] = {
-  "TemperatureSensor1", "TemperatureSensor2", "TemperatureSensor3", "TemperatureSensor4"
-};
-
-const byte numSensors = sizeof(oneWirePins) / sizeof(byte);
-float *temperature = (float*)malloc(sizeof(float) * numSensors);
+#include "settings.h"
+#include "faults.h"
+#include "watchdog.h"
+#include "log.h"
+#include "trace.h"
+#include "metrics.h"
+
+float temperature[numSensors];
 float avg_temperature;
+uint32_t tempSensorReadErrors[numSensors];
 
 OneWire temp_sensor_oneWire[numSensors];
 DallasTemperature temp_sensor[numSensors];
@@ -20,17 +18,23 @@ elapsedMillis timeElapsedSinceLastMeasurement;
 double desired_temperature;
 double current_temperature;
 
+/* Written by loop() with the interrupts disabled, taken by the ISR */
+static temp_sample sample;
+static volatile bool sampleFresh = false;
+static unsigned long lastSampleAt_ms = 0;
+
+byte tempSensorPin(IN byte sensor) {
+  return pgm_read_byte(&BOARD.sensors[sensor].pin);
+}
+
+const char *tempSensorName(IN byte sensor) {
+  return (const char *)pgm_read_word(&BOARD.sensors[sensor].name);
+}
+
 void printTemperature(IN float temperature,
-                      IN String sensor_name,
+                      IN const char *sensor_name,
                       IN byte pinConnectedTo) {
-#if DEBUG
-  Serial.print(F("Temperature for the sensor "));
-  Serial.print(sensor_name);
-  Serial.print(F(" (Pin "));
-  Serial.print(pinConnectedTo);
-  Serial.print(F(") is "));
-  Serial.println(temperature);
-#endif
+  LOG(LOG_TEMPERATURE, pinConnectedTo, temperature);
 }
 
 void _requestAllTemperatures() {
@@ -39,43 +43,59 @@ void _requestAllTemperatures() {
   timeElapsedSinceLastMeasurement = 0;
 }
 
+bool temperatureReadingDue() {
+  return timeElapsedSinceLastMeasurement >= TempSensorModel::conversion_ms;
+}
+
+bool temperatureTakeSample(OUT temp_sample *s) {
+  if (!sampleFresh)
+    return false;
+  *s = sample;
+  sampleFresh = false;
+  return true;
+}
+
 void readAllTemperatures() {
   /* If the necessary time for conversion hasn't elapsed yet,
    * return from this function without updating the temperatures
    * already stored in the temperature array. */
-  switch (TEMP_RESOLUTION_BITS){
-    case 9:
-      if (timeElapsedSinceLastMeasurement < 94)
-        return;
-      break;
-    case 10:
-      if (timeElapsedSinceLastMeasurement < 188)
-        return;
-      break;
-    case 11:
-      if (timeElapsedSinceLastMeasurement < 375)
-        return;
-      break;
-    default:
-      Serial.println(F("Unknown resolution..."));
-    case 12:
-      if (timeElapsedSinceLastMeasurement < 750)
-        return;
-      break;
-  }
+  if (!temperatureReadingDue())
+    return;
+
+  /* The sensors hold the value from the end of the conversion, however
+   * late loop() (or the /temp page) reads it */
+  unsigned long at_ms = millis() -
+    (timeElapsedSinceLastMeasurement - TempSensorModel::conversion_ms);
 
   /* Update the temperature array and calculate the average */
   avg_temperature = 0;
   for (int i = 0; i < numSensors; i++) {
     temperature[i] = temp_sensor[i].getTempCByIndex(0);
+    if (temperature[i] == DEVICE_DISCONNECTED_C)
+      tempSensorReadErrors[i]++;
     avg_temperature += temperature[i];
   }
   avg_temperature /= numSensors;
   /* At the moment I get an average temperature, and the current
    * temperature is equal to the average. However, I still want
    * to keep these two variable, because after the testing I am not
-   * sure if these two variables should be "one" */
+   * sure if these two variables should be "one".
+   * programTick() reads current_temperature in the ISR, so it is
+   * written with the interrupts disabled, along with the sample. */
+  if (lastSampleAt_ms != 0)
+    metricsSampleInterval(at_ms - lastSampleAt_ms);
+  lastSampleAt_ms = at_ms;
+  uint8_t oldSREG = SREG;
+  cli();
   current_temperature = avg_temperature;
+  sample.celsius = current_temperature;
+  sample.at_ms = at_ms;
+  sampleFresh = true;
+  SREG = oldSREG;
+
+  faultsSensorReading(temperature, numSensors);
+  traceSensors(temperature, numSensors);
+  watchdogCheckIn(WDT_TASK_TEMPERATURE);
 
   /* Initiate a new temperature conversion */
   _requestAllTemperatures();
@@ -95,7 +115,7 @@ void initTempSensors() {
   DeviceAddress deviceAddress;
   for (byte i = 0; i < numSensors; i++) {
     ;
-    temp_sensor_oneWire[i].setPin(oneWirePins[i]);
+    temp_sensor_oneWire[i].setPin(tempSensorPin(i));
     temp_sensor[i].setOneWire(&temp_sensor_oneWire[i]);
     temp_sensor[i].begin();
   #if DEBUG
@@ -103,11 +123,11 @@ void initTempSensors() {
       Serial.println(F("Unable to find address for Device 0"));
   #endif
 
-    temp_sensor[i].setResolution(deviceAddress, TEMP_RESOLUTION_BITS);
+    temp_sensor[i].setResolution(deviceAddress, TempSensorModel::resolution_bits);
     temp_sensor[i].setWaitForConversion(false);
   #if DEBUG
     Serial.print(F("Device Resolution on Pin "));
-    Serial.print(oneWirePins[i]);
+    Serial.print(tempSensorPin(i));
     Serial.print(F(": "));
     Serial.print(temp_sensor[i].getResolution(deviceAddress), DEC);
     Serial.println();
@@ -116,10 +136,23 @@ void initTempSensors() {
 }
 
 void initDesiredTemperature() {
-  /* TODO: Through the web interface, the user should be able to choose
-   *       if the last settings should be remember across device reboots.
-   *       If yes, then we should be reading the stored desired_temperature
-   *       value from eeprom. Otherwise, we should be setting the minimum
-   *       temperature as the desired_temperature */
-  desired_temperature = MIN_TEMPERATURE;
+  /* The last temperature that the user has set, or
+   * MIN_TEMPERATURE if nothing has been stored yet */
+  desired_temperature = constrain(settingsGet()->desired_temperature / 10.0,
+                                  MIN_TEMPERATURE, MAX_TEMPERATURE);
+}
+
+double getDesiredTemperature() {
+  uint8_t oldSREG = SREG;
+  cli();
+  double temperature = desired_temperature;
+  SREG = oldSREG;
+  return temperature;
+}
+
+void setDesiredTemperature(IN double temperature) {
+  uint8_t oldSREG = SREG;
+  cli();
+  desired_temperature = temperature;
+  SREG = oldSREG;
 }
@@ -10,26 +10,55 @@
 #define MIN_TEMPERATURE 10
 #define MAX_TEMPERATURE 85
 
-#define TEMP_RESOLUTION_BITS 12 // 9, 10, 11 or 12 bits resolution with
-                                // 93.75ms, 187.5ms, 375ms and 750ms temperature
-                                // reading time respectively. Read the DS18B20
-                                // datasheet for more information.
+/* The DS18B20 driver settings that depend on the resolution.
+ * Specialised at compile time from the board description.
+ */
+template <uint8_t ResolutionBits>
+struct ds18b20 {
+  static_assert(ResolutionBits >= 9 && ResolutionBits <= 12,
+                "The DS18B20 supports 9, 10, 11 or 12 bits resolution");
+
+  static constexpr uint8_t resolution_bits = ResolutionBits;
+  /* The conversion takes 750ms at 12 bits and half as long for every
+   * bit less (93.75ms, 187.5ms, 375ms). Round up to whole milliseconds. */
+  static constexpr uint16_t conversion_ms =
+    (750 + (1 << (12 - ResolutionBits)) - 1) >> (12 - ResolutionBits);
+};
 
-#define TEMPSENSOR_DESC_STR_LENGTH 19 // The length of the strings in the tempSensorDesc array.
+typedef ds18b20<BOARD.temp_resolution_bits> TempSensorModel;
 
-extern byte oneWirePins[];      // Array to store the pins that each sensor is connected to.
-extern const byte numSensors;   // Variable to store the number of sensors available.
-extern String tempSensorDesc[]; // Array to store the description of each sensor.
-extern float *temperature;      // Array to store the measured temperature for each sensor.
+constexpr byte numSensors = BOARD.num_sensors; // The number of sensors available.
+extern float temperature[];     // Array to store the measured temperature for each sensor.
 extern float avg_temperature;   // A variable to store the average temperature from all sensors.
+extern uint32_t tempSensorReadErrors[]; // Array to store the number of failed readings per sensor.
 
 extern OneWire temp_sensor_oneWire[];   // Array to store the OneWire association per sensor.
 extern DallasTemperature temp_sensor[]; // Array to store the DallasTemperature object for each sensor.
 
 extern elapsedMillis timeElapsedSinceLastMeasurement;
 
-extern double desired_temperature; // These are double instead of float, because the PID module
-extern double current_temperature; // accepts double values in the PID constructor.
+extern double desired_temperature; // These are double instead of float, because the PID
+extern double current_temperature; // computes in double (see controller.h).
+
+/* The fused temperature of one conversion of all the sensors */
+typedef struct _temp_sample {
+  float celsius;        // current_temperature
+  unsigned long at_ms;  // millis() when the conversion finished
+} temp_sample;
+
+/***f* tempSensorPin
+ *
+ * Returns the pin that the sensor 'sensor' is connected to.
+ */
+byte tempSensorPin(IN byte sensor);
+
+/***f* tempSensorName
+ *
+ * Returns the description of the sensor 'sensor'.
+ * The returned string is stored in flash, so print it with
+ * the $F format in emit_p, or cast it to __FlashStringHelper*.
+ */
+const char *tempSensorName(IN byte sensor);
 
 /***f* printTemperature
  *
@@ -37,7 +66,7 @@ extern double current_temperature; // accepts double values in the PID construct
  * Only used for debugging.
  */
 void printTemperature(IN float temperature,
-                      IN String sensor_name,
+                      IN const char *sensor_name,
                       IN byte pinConnectedTo);
 
 /***f* _requestAllTemperatures
@@ -61,6 +90,20 @@ void _requestAllTemperatures();
  */
 void readAllTemperatures();
 
+/***f* temperatureTakeSample
+ *
+ * Call from the Timer1 ISR. Returns true, once for every conversion
+ * that readAllTemperatures() has read, with the sample in 's'.
+ */
+bool temperatureTakeSample(OUT temp_sample *s);
+
+/***f* temperatureReadingDue
+ *
+ * Returns true if the conversion has finished, so that the next
+ * readAllTemperatures() reads the sensors.
+ */
+bool temperatureReadingDue();
+
 /***f* initTempSensors
  *
  * Initialize all the temperature sensors.
@@ -70,10 +113,24 @@ void initTempSensors();
 
 /***f* initDesiredTemperature
  *
- * Initialize the desired_temperature variable
- * Using either a value from EEPROM or a default value.
+ * Initialize the desired_temperature variable with the
+ * stored one (see settings.h). Call after settingsInit().
  */
 void initDesiredTemperature();
 
+/***f* getDesiredTemperature
+ *
+ * Returns desired_temperature. The cook program changes it in the
+ * Timer1 ISR (programTick()), and a double is 4 bytes on the AVR, so
+ * outside of the ISR read it with this instead of directly.
+ */
+double getDesiredTemperature();
+
+/***f* setDesiredTemperature
+ *
+ * Sets desired_temperature, at once for the Timer1 ISR.
+ */
+void setDesiredTemperature(IN double temperature);
+
 #endif // endif __cpluscplus
 #endif // endif temperature_h
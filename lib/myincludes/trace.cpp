@@ -0,0 +1,213 @@
+#include "trace.h"
+
+#if TRACING
+
+#include "temperature.h"
+#include "net.h"
+
+#define TRACE_RECORD_HEAD 3   // type and the uint16 time delta
+#define TRACE_END_SIZE TRACE_RECORD_HEAD
+
+static uint8_t ring[TRACE_BUFFER_SIZE];
+/* Offsets from the start of the trace. The buffer holds [start, written). */
+static uint32_t written = 0;
+static uint32_t start = 0;
+static bool recording = false;
+static bool streaming = false;
+static unsigned long lastRecord = 0;
+
+/* Written by the Timer1 ISR */
+static uint8_t lastButtons = 0xFF;
+static volatile uint8_t heaterOutput = 0;
+
+static unsigned long lastOutput = 0;
+
+/***f* put
+ *
+ * Appends 'size' bytes. There must be room for them.
+ */
+static void put(IN const void *data,
+                IN uint16_t size) {
+  const uint8_t *p = (const uint8_t *)data;
+
+  for (uint16_t i = 0; i < size; i++)
+    ring[(written + i) % TRACE_BUFFER_SIZE] = p[i];
+  written += size;
+}
+
+/***f* begin
+ *
+ * Starts a record of 'type' with 'size' bytes after the head.
+ * Returns false if it doesn't fit, and then the recording stops.
+ * Call with the interrupts disabled.
+ */
+static bool begin(IN uint8_t type,
+                  IN uint16_t size) {
+  if (!recording)
+    return false;
+
+  unsigned long now = millis();
+  unsigned long delta = now - lastRecord;
+  uint16_t time_size = (delta > 0xFFFF) ? TRACE_RECORD_HEAD + sizeof(uint32_t) : 0;
+  uint32_t room = TRACE_BUFFER_SIZE - (written - start) - TRACE_END_SIZE;
+
+  if (time_size + TRACE_RECORD_HEAD + size > room) {
+    uint8_t end[TRACE_END_SIZE] = {TRACE_END, 0, 0};
+    put(end, sizeof(end));
+    recording = false;
+    return false;
+  }
+
+  if (time_size) {
+    uint8_t type_time = TRACE_TIME;
+    uint16_t zero = 0;
+    uint32_t now32 = now;
+    put(&type_time, 1);
+    put(&zero, sizeof(zero));
+    put(&now32, sizeof(now32));
+    delta = 0;
+  }
+
+  uint16_t delta16 = delta;
+  put(&type, 1);
+  put(&delta16, sizeof(delta16));
+  lastRecord = now;
+  return true;
+}
+
+void traceStart() {
+  uint8_t oldSREG = SREG;
+  cli();
+  written = start = 0;
+  recording = true;
+  lastRecord = millis();
+
+  const settings *s = settingsGet();
+  uint16_t magic = TRACE_MAGIC;
+  uint8_t version = TRACE_VERSION;
+  uint8_t sensors = numSensors;
+  uint32_t now = lastRecord;
+  uint16_t size = sizeof(magic) + sizeof(version) + sizeof(sensors) + sizeof(now) +
+                  sizeof(s->desired_temperature) + 3 * sizeof(float) +
+                  sizeof(s->lcd_backlight_timeout) + sizeof(s->menu_return_timeout) +
+                  sizeof(s->resume_window);
+
+  /* Field by field, so that the host reads the same layout */
+  if (begin(TRACE_HEADER, size)) {
+    put(&magic, sizeof(magic));
+    put(&version, sizeof(version));
+    put(&sensors, sizeof(sensors));
+    put(&now, sizeof(now));
+    put(&s->desired_temperature, sizeof(s->desired_temperature));
+    put(&s->kp, sizeof(float));
+    put(&s->ki, sizeof(float));
+    put(&s->kd, sizeof(float));
+    put(&s->lcd_backlight_timeout, sizeof(s->lcd_backlight_timeout));
+    put(&s->menu_return_timeout, sizeof(s->menu_return_timeout));
+    put(&s->resume_window, sizeof(s->resume_window));
+  }
+  SREG = oldSREG;
+}
+
+void traceSensors(IN const float *temperatures,
+                  IN uint8_t count) {
+  uint8_t oldSREG = SREG;
+  cli();
+  if (begin(TRACE_SENSORS, count * sizeof(int16_t))) {
+    for (uint8_t i = 0; i < count; i++) {
+      int16_t raw = lround(temperatures[i] * 16);
+      put(&raw, sizeof(raw));
+    }
+  }
+  SREG = oldSREG;
+}
+
+void traceTick(IN uint8_t buttons,
+               IN uint8_t heater_output) {
+  heaterOutput = heater_output;
+  if (buttons == lastButtons)
+    return;
+  lastButtons = buttons;
+  if (begin(TRACE_BUTTONS, sizeof(buttons)))
+    put(&buttons, sizeof(buttons));
+}
+
+void tracePacket(IN const uint8_t *frame,
+                 IN uint16_t pos) {
+  /* EtherCard terminates the received data, and
+   * processEthernetPacket() relies on that too */
+  uint16_t len = strlen((const char *)frame + pos);
+
+  uint8_t oldSREG = SREG;
+  cli();
+  if (begin(TRACE_PACKET, 4 + 4 + sizeof(len) + len)) {
+    put(frame + TCP_SEQ_H_P, 4);
+    put(frame + IP_SRC_P, 4);
+    put(&len, sizeof(len));
+    put(frame + pos, len);
+  }
+  SREG = oldSREG;
+}
+
+void traceTask(IN uint8_t op_state,
+               IN float setpoint) {
+  unsigned long now = millis();
+
+  if (now - lastOutput >= TRACE_OUTPUT_PERIOD_MS) {
+    lastOutput = now;
+    uint8_t oldSREG = SREG;
+    cli();
+    if (begin(TRACE_OUTPUT, 2 + sizeof(int16_t))) {
+      uint8_t heater = heaterOutput;
+      int16_t raw = lround(setpoint * 16);
+      put(&heater, sizeof(heater));
+      put(&op_state, sizeof(op_state));
+      put(&raw, sizeof(raw));
+    }
+    SREG = oldSREG;
+  }
+
+  if (!streaming)
+    return;
+
+  /* Only what fits in the transmit buffer, so that Serial.write()
+   * never waits. What has been sent can be overwritten. */
+  int room = Serial.availableForWrite();
+  while (room-- > 0 && start != written) {
+    Serial.write(ring[start % TRACE_BUFFER_SIZE]);
+    uint8_t oldSREG = SREG;
+    cli();
+    start++;
+    SREG = oldSREG;
+  }
+}
+
+void traceStream() {
+  streaming = true;
+}
+
+bool traceStreaming() {
+  return streaming;
+}
+
+uint16_t tracePrint(OUT Print &out,
+                    IN uint16_t offset,
+                    IN uint16_t max_size) {
+  uint16_t count = 0;
+
+  while (count < max_size && start + offset + count < written) {
+    out.write(ring[(start + offset + count) % TRACE_BUFFER_SIZE]);
+    count++;
+  }
+  return count;
+}
+
+uint16_t traceSize() {
+  uint8_t oldSREG = SREG;
+  cli();
+  uint16_t size = written - start;
+  SREG = oldSREG;
+  return size;
+}
+
+#endif // endif TRACING
@@ -0,0 +1,125 @@
+#ifndef trace_h
+#define trace_h
+#ifdef __cplusplus
+
+#include "common.h"
+#include "settings.h"
+
+/* Recording of the inputs of the firmware, for tools/replay.
+ *
+ * From setup() on, everything that the firmware consumes from the
+ * outside is recorded: the temperature readings, the raw button and
+ * float switch bits that the Timer1 ISR reads, and the HTTP payloads
+ * that reach processEthernetPacket(). Once a second the heater output,
+ * the opState and the setpoint are recorded too, which the replay
+ * compares with its own.
+ *
+ * The trace is kept in RAM and can be downloaded from /trace, or
+ * printed with the 't' console command. A trace must start at boot to
+ * be replayed, so the recording stops when the buffer is full. For a
+ * whole cook, the 'T' console command streams the trace to the serial
+ * port as it is recorded (the log is suspended meanwhile), and the
+ * buffer only has to hold what the serial port hasn't sent yet.
+ *
+ * Compiled in with TRACING (see common.h). It takes TRACE_BUFFER_SIZE
+ * bytes of RAM.
+ */
+#define TRACE_BUFFER_SIZE 1024
+#define TRACE_MAGIC 0x5456      // "VT"
+#define TRACE_VERSION 1
+#define TRACE_OUTPUT_PERIOD_MS 1000
+
+/* Every record starts with its type and the milliseconds since the
+ * previous record (uint16_t, little endian). A gap longer than that
+ * is bridged with a TRACE_TIME record. */
+typedef enum _trace_record {
+  TRACE_HEADER = 0,  // uint16 magic, uint8 version, uint8 numSensors, uint32 millis,
+                     // int16 desired_temperature, float kp, ki, kd,
+                     // uint32 lcd_backlight_timeout, uint16 menu_return_timeout,
+                     // uint8 resume_window
+  TRACE_TIME,        // uint32 millis
+  TRACE_SENSORS,     // int16 per sensor, in 1/16 Celsius (the DS18B20 resolution)
+  TRACE_BUTTONS,     // uint8 readButtons()
+  TRACE_PACKET,      // uint32 TCP sequence, 4 byte source IP, uint16 length, payload
+  TRACE_OUTPUT,      // uint8 heater output, uint8 opState, int16 setpoint in 1/16 Celsius
+  TRACE_END          // The recording stopped here because the buffer was full
+} trace_record;
+
+#if TRACING
+
+/***f* traceStart
+ *
+ * Starts the recording. Call from setup() once the settings are loaded.
+ */
+void traceStart();
+
+/***f* traceSensors
+ *
+ * Records a reading of the temperature sensors.
+ */
+void traceSensors(IN const float *temperatures,
+                  IN uint8_t count);
+
+/***f* traceTick
+ *
+ * Call from the Timer1 ISR with what readButtons() returned and the
+ * heater output of the tick.
+ */
+void traceTick(IN uint8_t buttons,
+               IN uint8_t heater_output);
+
+/***f* tracePacket
+ *
+ * Records the HTTP payload at 'pos' of the Ethernet frame 'frame'.
+ */
+void tracePacket(IN const uint8_t *frame,
+                 IN uint16_t pos);
+
+/***f* traceTask
+ *
+ * Call from loop(). Records the outputs every TRACE_OUTPUT_PERIOD_MS,
+ * and streams the trace to the serial port if it has been asked to.
+ */
+void traceTask(IN uint8_t op_state,
+               IN float setpoint);
+
+/***f* traceStream
+ *
+ * Starts sending the trace, from the start, to the serial port.
+ */
+void traceStream();
+
+/***f* traceStreaming
+ *
+ * Returns true while the serial port carries the trace.
+ */
+bool traceStreaming();
+
+/***f* tracePrint
+ *
+ * Writes the recorded trace in 'out', such as the Serial or the
+ * BufferFiller of an HTTP reply. Returns the number of bytes.
+ */
+uint16_t tracePrint(OUT Print &out,
+                    IN uint16_t offset,
+                    IN uint16_t max_size);
+
+/***f* traceSize
+ *
+ * Returns the number of bytes in the buffer.
+ */
+uint16_t traceSize();
+
+#else
+
+#define traceStart()
+#define traceSensors(temperatures, count)
+#define traceTick(buttons, heater_output)
+#define tracePacket(frame, pos)
+#define traceTask(op_state, setpoint)
+#define traceStreaming() false
+
+#endif // endif TRACING
+
+#endif // endif __cpluscplus
+#endif // endif trace_h
@@ -0,0 +1,126 @@
+#include "watchdog.h"
+#include <avr/wdt.h>
+
+#define WDT_ALL_TASKS ((1 << WDT_TASK_COUNT) - 1)
+#define WDT_NOINIT_MAGIC 0x5D7A   // The .noinit variables below are from a previous boot
+
+static_assert(WDT_TASK_COUNT <= 8, "The check-ins are bits of a uint8_t");
+
+/* Not cleared at boot. The bootloader clears MCUSR before it starts
+ * us, so WDRF can't tell a watchdog reset. These can: bootStage isn't
+ * BOOT_STAGE_DONE when setup() or the network stage of loop() hung,
+ * and fired is set by the watchdog interrupt that comes before the
+ * reset. They are garbage after a power on, unless magic is right. */
+static uint8_t resetCause __attribute__((section(".noinit")));
+static uint16_t magic __attribute__((section(".noinit")));
+static uint8_t bootStage __attribute__((section(".noinit")));
+static uint8_t fired __attribute__((section(".noinit")));
+static uint8_t hungStage __attribute__((section(".noinit")));
+
+static volatile uint8_t checkIns = 0;
+static bool running = false;
+
+/***f* watchdogEarlyInit
+ *
+ * Runs before the C runtime initialization. After a watchdog reset the
+ * watchdog stays enabled with the shortest timeout (15ms), which is
+ * shorter than the initialization of the runtime, so it has to be
+ * disabled here. WDRF must be cleared first, or it can't be disabled.
+ */
+void watchdogEarlyInit() __attribute__((naked, used, section(".init3")));
+void watchdogEarlyInit() {
+  resetCause = MCUSR;
+  MCUSR = 0;
+  wdt_disable();
+}
+
+/***f* enable
+ *
+ * Starts the watchdog with 'timeout' in the interrupt and system reset
+ * mode: the interrupt marks that it fired, the reset follows. The reset
+ * comes only after the interrupt has run, so nothing may wait without
+ * a bound while the interrupts are disabled.
+ */
+static void enable(IN uint8_t timeout) {
+  wdt_enable(timeout);
+  WDTCSR |= (1 << WDIE);
+}
+
+ISR(WDT_vect)
+{
+  /* Whatever hung, the heater and the pump must not stay on */
+  ssr_operate(0);
+  pump_operate(false);
+  fired = true;
+  /* The interrupt has cleared WDIE. Reset now instead of after
+   * another timeout. */
+  wdt_enable(WDTO_15MS);
+  for (;;)
+    ;
+}
+
+void watchdogInit() {
+  /* Keep where the previous boot was when the watchdog fired */
+  hungStage = BOOT_STAGE_DONE;
+  if (magic == WDT_NOINIT_MAGIC) {
+    if (bootStage != BOOT_STAGE_DONE)
+      hungStage = bootStage;
+    if (bootStage != BOOT_STAGE_DONE || fired)
+      resetCause |= (1 << WDRF);
+  }
+  magic = WDT_NOINIT_MAGIC;
+  fired = false;
+  watchdogBootStage(BOOT_STAGE_START);
+  enable(WATCHDOG_SETUP_TIMEOUT);
+}
+
+void watchdogBootStage(IN uint8_t stage) {
+  bootStage = stage;
+  wdt_reset();
+}
+
+void watchdogStart() {
+  watchdogBootStage(BOOT_STAGE_DONE);
+  checkIns = 0;
+  running = true;
+  enable(WATCHDOG_TIMEOUT);
+}
+
+void watchdogCheckIn(IN uint8_t task) {
+  uint8_t oldSREG = SREG;
+  cli();
+  checkIns |= (1 << task);
+  SREG = oldSREG;
+}
+
+void watchdogTask() {
+  watchdogCheckIn(WDT_TASK_LOOP);
+
+  if (!running || checkIns != WDT_ALL_TASKS)
+    return;
+
+  uint8_t oldSREG = SREG;
+  cli();
+  checkIns = 0;
+  SREG = oldSREG;
+  wdt_reset();
+}
+
+void watchdogSleep(IN uint16_t ms) {
+  while (ms > 100) {
+    wdt_reset();
+    delay(100);
+    ms -= 100;
+  }
+  wdt_reset();
+  delay(ms);
+  wdt_reset();
+}
+
+uint8_t watchdogResetCause() {
+  return resetCause;
+}
+
+bool watchdogHungIn(IN uint8_t stage) {
+  return hungStage == stage;
+}
@@ -0,0 +1,102 @@
+#ifndef watchdog_h
+#define watchdog_h
+#ifdef __cplusplus
+
+#include "common.h"
+
+/* Supervision of the firmware with the AVR hardware watchdog.
+ *
+ * During setup() the watchdog runs with WATCHDOG_SETUP_TIMEOUT and is
+ * reset at every boot stage, so a driver that never returns (such as
+ * ether.begin() without the ENC28J60) resets the board, and the next
+ * boot knows in which stage it hung (see watchdogHungIn()).
+ *
+ * From the end of setup() it runs with WATCHDOG_TIMEOUT and is reset
+ * only when every task below has checked in since the last reset. So
+ * the board is reset when any of them stops running, not only when the
+ * whole loop hangs.
+ *
+ * A timeout first turns the SSR and the pump off in the watchdog
+ * interrupt, and the reset follows it. That interrupt can't run while
+ * the interrupts are disabled, so a cli() section must never wait for
+ * the hardware without a bound.
+ */
+#define WATCHDOG_SETUP_TIMEOUT WDTO_8S
+#define WATCHDOG_TIMEOUT WDTO_2S
+
+typedef enum _watchdog_task {
+  WDT_TASK_LOOP = 0,     // loop() runs
+  WDT_TASK_CONTROL,      // The 10ms Timer1 ISR runs
+  WDT_TASK_TEMPERATURE,  // The temperature sensors are read (every conversion_ms)
+  WDT_TASK_COUNT
+} watchdog_task;
+
+/* The stages of setup(). The stage is kept in .noinit RAM, so after
+ * a watchdog reset it tells where the previous boot hung. The
+ * Ethernet controller is also started from loop(), which marks
+ * BOOT_STAGE_NETWORK around it as well. */
+typedef enum _boot_stage {
+  BOOT_STAGE_START = 0,
+  BOOT_STAGE_TEMP_SENSORS,
+  BOOT_STAGE_NETWORK,
+  BOOT_STAGE_SETTINGS,
+  BOOT_STAGE_DONE
+} boot_stage;
+
+/***f* watchdogInit
+ *
+ * Starts the watchdog with WATCHDOG_SETUP_TIMEOUT. Call first in setup().
+ */
+void watchdogInit();
+
+/***f* watchdogBootStage
+ *
+ * Records that setup() has reached 'stage', and resets the watchdog.
+ */
+void watchdogBootStage(IN uint8_t stage);
+
+/***f* watchdogStart
+ *
+ * Switches to WATCHDOG_TIMEOUT and the task check-ins.
+ * Call at the end of setup().
+ */
+void watchdogStart();
+
+/***f* watchdogCheckIn
+ *
+ * Marks 'task' as alive. Can be called from an ISR.
+ */
+void watchdogCheckIn(IN uint8_t task);
+
+/***f* watchdogTask
+ *
+ * Call from loop(). Checks in WDT_TASK_LOOP, and resets the watchdog
+ * if all the tasks have checked in.
+ */
+void watchdogTask();
+
+/***f* watchdogSleep
+ *
+ * delay() that keeps the watchdog reset. Only for the few places
+ * that block on purpose.
+ */
+void watchdogSleep(IN uint16_t ms);
+
+/***f* watchdogResetCause
+ *
+ * Returns the MCUSR flags of the last reset (WDRF, BORF, EXTRF, PORF).
+ * The bootloader clears MCUSR, so WDRF comes from the state that the
+ * previous boot left in .noinit RAM instead: set if the watchdog fired
+ * or a boot stage didn't finish. 0 after software_Reset().
+ */
+uint8_t watchdogResetCause();
+
+/***f* watchdogHungIn
+ *
+ * Returns true if the previous boot was reset while in 'stage': by the
+ * watchdog, or by hand while it was there.
+ */
+bool watchdogHungIn(IN uint8_t stage);
+
+#endif // endif __cpluscplus
+#endif // endif watchdog_h
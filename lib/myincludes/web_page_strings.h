@@ -12,6 +12,24 @@ const char http_OK_200[] PROGMEM =
   "Pragma: no-cache\r\n\r\n"
   ;
 
+const char http_OK_200_metrics[] PROGMEM =
+  "HTTP/1.0 200 OK\r\n"
+  "Content-Type: text/plain; version=0.0.4\r\n"
+  "Pragma: no-cache\r\n\r\n"
+  ;
+
+const char http_OK_200_text[] PROGMEM =
+  "HTTP/1.0 200 OK\r\n"
+  "Content-Type: text/plain\r\n"
+  "Pragma: no-cache\r\n\r\n"
+  ;
+
+const char http_OK_200_binary[] PROGMEM =
+  "HTTP/1.0 200 OK\r\n"
+  "Content-Type: application/octet-stream\r\n"
+  "Pragma: no-cache\r\n\r\n"
+  ;
+
 const char http_unauthorized_401[] PROGMEM =
   "HTTP/1.0 401 Unauthorized\r\n"
   "Content-Type: text/html\r\n\r\n"
@@ -41,7 +59,7 @@ const char webpage_not_found[] PROGMEM =
   ;
 
 const char webpage_temperature[] PROGMEM =
-  "$S=$S <br>"
+  "$F=$S <br>"
   ;
 
 const char webpage_ipconfig[] PROGMEM =
@@ -82,7 +100,9 @@ const char webpage_ipconfig[] PROGMEM =
   "</body></html>"
   ;
 
-const char webpage_main[] PROGMEM =
+/* The main page is sent in two TCP segments: the style, and the links
+ * with the hostname of the client, which can be long */
+const char webpage_main_head[] PROGMEM =
   "<!DOCTYPE HTML>\r\n"
   "<html>"
   "<head>\r\n"
@@ -124,16 +144,136 @@ const char webpage_main[] PROGMEM =
   ".boxed { box-shadow: 0 0 0 1px #eeeeee; font-size: 21px; font-weight: bold; color: #5a9bbb;}"
   "</style>\r\n"
   "</head>\r\n"
+  ;
+
+const char webpage_main_body[] PROGMEM =
   "<body>\r\n"
   "<div id=\"contain\">\r\n"
   "<h1>Welcome to the Super Sous Vide Vaguino webserver</font></h1>\r\n"
   "<p><a href=\"http://$S/ipconfig\">IP Configuration</a></p>"
   "<p><a href=\"http://$S/temp\">Sensor Temperatures</a></p>"
+  "<p><a href=\"http://$S/metrics\">Metrics</a></p>"
+  "<p><a href=\"http://$S/presets\">Cooking presets</a></p>"
+  "<p><a href=\"http://$S/program\">Cook program</a></p>"
+  "<p><a href=\"http://$S/settings\">Settings</a></p>"
+  "<p><a href=\"http://$S/profile\">Loop profile</a></p>"
   "</div>\r\n"
   "</body>\r\n"
   "</html>"
   ;
 
 const char webpage_please_connect_manually[] PROGMEM =
-  "Please connect manually to the newly configured IP address."
+  "Please connect manually to the newly configured IP address. "
+  "If it isn't reached in $D minutes, the previous configuration returns."
+  ;
+
+const char webpage_presets_head[] PROGMEM =
+  "<!DOCTYPE HTML>\r\n"
+  "<html><head><title>Cooking presets</title></head><body>"
+  "<p><a href=\"http://$S\">Home</a></p>"
+  "<p><b>$F</b></p>"
+  "<p>Name, temperature in &deg;C, duration in minutes (0 for none) "
+  "and PID profile (0: $F, 1: $F, 2: $F)</p>\r\n"
+  ;
+
+const char webpage_preset_form[] PROGMEM =
+  "<form method=\"post\">"
+  "<input type=\"hidden\" name=\"i\" value=\"$D\">"
+  "<input name=\"name\" maxlength=\"16\" value=\"$S\"> "
+  "<input name=\"temp\" size=\"5\" value=\"$S\"> "
+  "<input name=\"dur\" size=\"5\" value=\"$D\"> "
+  "<input name=\"pid\" size=\"2\" value=\"$D\"> "
+  "$F"
+  "</form>\r\n"
+  ;
+
+const char webpage_preset_buttons_edit[] PROGMEM =
+  "<button name=\"op\" value=\"save\">Save</button>"
+  "<button name=\"op\" value=\"apply\">Apply</button>"
+  "<button name=\"op\" value=\"delete\">Delete</button>"
   ;
+
+const char webpage_preset_buttons_new[] PROGMEM =
+  "<button name=\"op\" value=\"save\">Create</button>"
+  ;
+
+const char webpage_presets_tail[] PROGMEM =
+  "</body></html>"
+  ;
+
+const char presets_status_none[] PROGMEM = "";
+const char presets_status_saved[] PROGMEM = "Saved";
+const char presets_status_applied[] PROGMEM = "Applied";
+const char presets_status_deleted[] PROGMEM = "Deleted";
+const char presets_status_invalid[] PROGMEM = "Invalid preset, or no room for more presets";
+
+const char webpage_program_head[] PROGMEM =
+  "<!DOCTYPE HTML>\r\n"
+  "<html><head><title>Cook program</title></head><body>"
+  "<p><a href=\"http://$S\">Home</a></p>"
+  "<p><b>$F</b></p>"
+  "<p>State: $F, stage $D of $D, hold time left: $L s, setpoint: $S &deg;C</p>\r\n"
+  "<form method=\"post\">"
+  "<p>Temperature in &deg;C, ramp in &deg;C per minute (0 to jump to the temperature), "
+  "hold in minutes and at the end (0: next stage, 1: keep the temperature, 2: turn off). "
+  "The stages after the first one without a temperature are dropped.</p>\r\n"
+  ;
+
+const char webpage_program_stage[] PROGMEM =
+  "<p>$D: "
+  "<input name=\"t$D\" size=\"5\" value=\"$S\"> "
+  "<input name=\"r$D\" size=\"5\" value=\"$S\"> "
+  "<input name=\"h$D\" size=\"5\" value=\"$D\"> "
+  "<input name=\"e$D\" size=\"2\" value=\"$D\"></p>\r\n"
+  ;
+
+const char webpage_program_tail[] PROGMEM =
+  "<button name=\"op\" value=\"save\">Save</button> "
+  "<button name=\"op\" value=\"start\">Save and start</button> "
+  "<button name=\"op\" value=\"next\">Next stage</button> "
+  "<button name=\"op\" value=\"stop\">Stop</button>"
+  "</form></body></html>"
+  ;
+
+const char program_state_idle[] PROGMEM = "idle";
+const char program_state_ramp[] PROGMEM = "ramp";
+const char program_state_heat[] PROGMEM = "heating";
+const char program_state_hold[] PROGMEM = "hold";
+const char program_state_done[] PROGMEM = "done";
+
+/* In the order of program_state */
+const char * const program_state_names[] PROGMEM = {
+  program_state_idle, program_state_ramp, program_state_heat,
+  program_state_hold, program_state_done
+};
+
+const char program_status_none[] PROGMEM = "";
+const char program_status_saved[] PROGMEM = "Saved";
+const char program_status_started[] PROGMEM = "Started";
+const char program_status_stopped[] PROGMEM = "Stopped";
+const char program_status_next[] PROGMEM = "Moved to the next stage";
+const char program_status_invalid[] PROGMEM = "Invalid stage, or the program runs";
+
+const char webpage_settings[] PROGMEM =
+  "<!DOCTYPE HTML>\r\n"
+  "<html><head><title>Settings</title></head><body>"
+  "<p><a href=\"http://$S\">Home</a></p>"
+  "<p><b>$F</b></p>"
+  "<form method=\"post\">"
+  "<p>LCD backlight timeout in seconds (0 to keep it on): "
+  "<input name=\"backlight\" size=\"6\" value=\"$L\"></p>"
+  "<p>Return from the menus after (seconds, 1 - 65): "
+  "<input name=\"menu\" size=\"6\" value=\"$D\"></p>"
+  "<p>After a reset, resume the cook if the water is at most this many &deg;C "
+  "below the setpoint (0 to never resume): "
+  "<input name=\"resume\" size=\"6\" value=\"$S\"></p>"
+  "<p>PID tunings: Kp <input name=\"kp\" size=\"8\" value=\"$S\"> "
+  "Ki <input name=\"ki\" size=\"8\" value=\"$S\"> "
+  "Kd <input name=\"kd\" size=\"8\" value=\"$S\"></p>"
+  "<input type=\"submit\" value=\"Save\">"
+  "</form></body></html>"
+  ;
+
+const char settings_status_none[] PROGMEM = "";
+const char settings_status_saved[] PROGMEM = "Saved";
+const char settings_status_invalid[] PROGMEM = "Invalid settings";
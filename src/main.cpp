@@ -8,9 +8,36 @@
 #include "temperature.h"
 /* List of different constant strings that are stored flash memory */
 #include "flash_strings.h"
-
-/* The PID and PID Autotune library */
-#include <PID_v1.h>
+/* Counters, gauges and histograms served at /metrics */
+#include "metrics.h"
+/* Per-stage timing of the main loop */
+#include "profiler.h"
+/* Single character commands over the serial port */
+#include "console.h"
+/* Stack/heap high-water mark monitor */
+#include "memory.h"
+/* RAM copy of the LCD that sends only the changed characters */
+#include "lcd_buffer.h"
+/* Debounced button events */
+#include "buttons.h"
+/* The cooking presets */
+#include "presets.h"
+/* Multi-stage cook programs */
+#include "program.h"
+/* The settings that survive a reboot */
+#include "settings.h"
+/* Resuming a cook after a reset */
+#include "checkpoint.h"
+/* The binary log */
+#include "log.h"
+/* The hardware watchdog and the fault monitor */
+#include "watchdog.h"
+#include "faults.h"
+/* The recording of the inputs for tools/replay */
+#include "trace.h"
+
+/* The PID controller of the heater */
+#include "controller.h"
 //#include <PID_AutoTune_v0.h>
 
 /* I want to have an operating state for the LCD, but I want it to
@@ -19,7 +46,7 @@
  * So as long as we are not in the "OPSTATE_OFF_TURN_ON", the SousVide is
  * running, but displays different things according to the current state.
  * If the user doesn't press a button for X seconds (X is defined by the
- * variable menuReturnTimeOut), return to the OPSTATE_DISPLAY_TEMP state
+ * setting menu_return_timeout), return to the OPSTATE_DISPLAY_TEMP state
  * and show the current and desired temperatures.
  *
  * In order to setup the temperature, the user can click the
@@ -64,12 +91,6 @@ enum operatingState {
 
 /* The variable opState keeps the current state */
 operatingState opState = OPSTATE_OFF_TURN_ON;
-/* The variable prevOpState keeps the previous state and I use it in order
- * to avoid LCD flickering, since I know that if the previous opState is the
- * same as the current opState, I may not need to clear and reprint some LCD
- * values */
-operatingState prevOpState = opState;
-
 /* The variable lastTimeButtonWasPressed is updated with the time in millis since
  * the last time a button was pressed. We use this variable to determine when the
  * time we stay in a menu has timed out in order to return to the OPSTATE_MENU_TEMP
@@ -79,13 +100,13 @@ operatingState prevOpState = opState;
 unsigned long lastTimeButtonWasPressed = millis();
 
 /* The variable lastTimeExecutedOpStateFunc is updated with the time in millis
- * since the last time an opState function was executed. We do not want to
- * to execute these functions more than 10 times a second (every 100ms) because
- * the LCD takes some time to clear and get rewritten.
+ * since the last time an opState function was executed. The opState functions
+ * run right away when there is a button event, and otherwise once every
+ * intervalBetweenOpStateFuncExec to refresh the screen (the temperature,
+ * alternating messages etc).
  *
  * We use this variable instead of having delays, because we do not want to block
  * the microntroller since it is service the ethernet and other things.
- * TODO: CHANGE THIS TO SOMETHING LIKE lastTimeSomethingPrintedOnLCD
  */
 unsigned long lastTimeExecutedOpStateFunc = millis();
 
@@ -94,25 +115,13 @@ unsigned long lastTimeExecutedOpStateFunc = millis();
  */
 uint16_t intervalBetweenOpStateFuncExec = 300;
 
-
-/* TODO: Allow the user to configure the LCD backlight timeout from the web
- *       interface. A value of 0xFFFFFFFF means that the backlight should be
- *       permanently on. Otherwise, the number should represent the number
- *       in seconds that the backlight will be staying on after a button has
- *       been pressed.
- *
- * The variable lcdBacklightTimeOut is used to configure the number of seconds
- * that the backlight will be staying on after a button has been pressed.
- *
- * The variable menuReturnTimeOut is used to configure the timeout for staying in
- * a menu without any user action (without the user pressing a button). After this
- * timeout, we return to the OPSTATE_MENU_TEMP
+/* How long the backlight stays on after a button has been pressed, and
+ * how long we stay in a menu without any button press before returning
+ * to OPSTATE_DEFAULT, are the settings lcd_backlight_timeout and
+ * menu_return_timeout (see settings.h). They are set from the web
+ * interface at /settings.
  */
-uint32_t lcdBacklightTimeOut = 30000;  /* in milliseconds */
-uint16_t menuReturnTimeOut = 30000;  /* In milliseconds */
 
-/* Use the variable netInitialized to know when the network has been initialized */
-bool netInitialized = false;
 
 /* Sometimes I may need to print larger messages that cannot fit in one go
  * in a 2x16 LCD. In this case I want to be able to alternate through the
@@ -129,12 +138,18 @@ unsigned long lastTimeAlternatedMessage = millis();
  */
 uint8_t messageAlternationIndex = 0;
 
-/* Variable to store the value of the pressed buttons */
+/* Variable to store the buttons that were clicked (pressed or
+ * auto-repeated) in this execution of the opState functions */
 uint8_t buttonsPressed = 0;
 
-/* How many are the main menus? Get this dynamically
- * from the LCD_TOP_LEVEL_MENU_LABELS array */
-uint8_t main_menus_count = sizeof(LCD_TOP_LEVEL_MENU_LABELS) / sizeof(char*) / LCD_ROWS;
+/* The selected item in the menus that have a list: the preset in
+ * OPSTATE_MENU_PRESET_CHOOSE and the page in OPSTATE_MENU_NET_SETTINGS_SHOW.
+ * menuIndexNext() and menuIndexPrev() wrap it in both directions at the
+ * number of items (see menuItemCount()). */
+uint8_t menuIndex = 0;
+
+/* The pages of LCD_STR_NET_INFO and one more for the link */
+const uint8_t NET_INFO_PAGES = sizeof(LCD_STR_NET_INFO) / sizeof(char*) / LCD_ROWS + 1;
 
 /* We need a variable 'temporary_temperature' to use when we change the
  * temperature with the buttons. Since we need to press OK to accept the
@@ -143,7 +158,7 @@ uint8_t main_menus_count = sizeof(LCD_TOP_LEVEL_MENU_LABELS) / sizeof(char*) / L
 float temporary_temperature;
 
 /* Development mode flag
- * By long-pressing the UP AND DOWN buttons together for 6 seconds,
+ * By long-pressing the UP AND DOWN buttons together for 4.5 seconds,
  * we put the device in DEVELOPMENT mode. When the device
  * is in the DEVELOPMENT mode, the immersion heaters and
  * water pump are disabled, but the rest of the menus are
@@ -151,29 +166,19 @@ float temporary_temperature;
  */
 bool devMode = false;
 
-/* Duration of up and down buttons being pressed *
- * (150 is the button read interval) */
-uint8_t longKeyPressCountMin = 60;    // 40 * 150 = 9000 ms
-uint8_t mediumKeyPressCountMin = 30;    // 20 * 150 = 4500 ms
-uint8_t upOrDownPressCount = 0; // How many counts of up or down
-uint8_t upAndDownPressCount = 0; // How many counts of up AND down. We use this to
-                                 // determine if we will set the device in development mode
-uint8_t devModePressCount = 30; // If both Up and Down buttons are pressed for 4500ms
-                                // the put the device in development mode.
-
-/* PID variables */
-/* TODO: Make the PID variables "variable" and read them from EEPROM */
-double PID_Output;
-
-/* Instantiate the PID */
-/* Specify the links and initial tuning parameters */
-PID SousPID(&current_temperature, &PID_Output, &desired_temperature, 850, 0.5, 0.1, DIRECT);
-//PID SousPID(&current_temperature, &PID_Output, &desired_temperature, 2, 5, 1, DIRECT);
-
-/* Instantiate the LCD */
-LiquidCrystal_I2C lcd(LCD_I2C_ADDR, LCD_EN_PIN, LCD_RW_PIN,
-  LCD_RS_PIN, LCD_D4_PIN, LCD_D5_PIN, LCD_D6_PIN,
-  LCD_D7_PIN, LCD_BACKLIGHT_PIN, POSITIVE);
+/* How long the up or down button has been held, in auto-repeats
+ * (see BUTTON_REPEAT_* in buttons.h for the repeat intervals) */
+uint8_t longKeyPressCountMin = 40;    // ~6s
+uint8_t mediumKeyPressCountMin = 20;  // ~4s
+uint8_t upOrDownPressCount = 0; // The repeat count of the current up or down event.
+                                // 0 for the first press.
+
+/* The integral term of the last PID computation. It is checkpointed,
+ * so that a resumed cook doesn't start the integral from zero. */
+double pidIntegral;
+
+/* Instantiate the LCD. The driver sends the data from the TWI interrupt */
+LcdTwi lcd(LCD_I2C_ADDR);
 
 /************************************************************************************/
 /********************************** MAIN FUNCTIONS **********************************/
@@ -206,73 +211,20 @@ uint8_t getMessageAlternationIndex(IN uint8_t total_messages) {
   return messageAlternationIndex % total_messages;
 }
 
-/***f* turnOn
- *
- * The Sous Vide is OFF and we may want to turn it on.
- * This function only works if the current opstate is
- * in the state OPSTATE_OFF_TURN_ON and we only listen
- * to the OK button press.
- */
-void turnOn(IN uint8_t buttonsPressed) {
-  if (opState == OPSTATE_OFF_TURN_ON) {
-    setRgbLed(RGB_LED_OFF);
-    printLcdLine(LCD_STR_PRESS_OK_TO_START);
-    /* Once the device is in the water, turn it on only if the
-     * user has pressed the OK button. */
-    if (buttonsPressed & BTN_OK) {
-      /* Do things to turn the device on */
-      /* TODO: Read the stored desired temperature
-       *       and set the opState to OPSTATE_DEFAULT
-       */
-      opState = OPSTATE_DEFAULT;
-    }
-  }
-}
-
 /***f* _turnOff
  *
  * This function forces the device to turn off.
  */
 void _turnOff() {
-  /* Make sure the device is turned off
-   * TODO: Revisit this part of the code when
-   *       The PID is working.
-   */
-
+  /* Make sure the device is turned off. The Timer1 ISR
+   * puts the PID in MANUAL while it is. */
+  programStop();
   pump_operate(false);
-  //SousPID.SetMode(MANUAL);
   ssr_operate(0);
   setLcdBacklight(LCD_OFF);
   setRgbLed(RGB_LED_OFF);
 }
 
-/***f* turnOff
- *
- * The Sous Vide is ON and we may want to turn it off.
- * This function only works if the current opstate is
- * in the state OPSTATE_MENU_TURN_OFF
- */
-void turnOff(IN uint8_t buttonsPressed) {
-  if (opState == OPSTATE_MENU_TURN_OFF) {
-    printLcdLine(LCD_TOP_LEVEL_MENU_LABELS[0]); // Prints in LCD "Turn off device"
-    if (buttonsPressed & BTN_OK) {
-      /* By pressing OK, we turn off the device */
-      opState = OPSTATE_OFF_TURN_ON;
-      _turnOff();
-    } else if (buttonsPressed & BTN_DOWN) {
-      /* By pressing DOWN, we go to the next top-level menu */
-      opState = OPSTATE_MENU_TEMP;
-    } else if (buttonsPressed & BTN_UP) {
-      /* By pressing UP, we go to the previous top-level menu */
-      opState = OPSTATE_MENU_NET_SETTINGS;
-    } else if (buttonsPressed & BTN_BACK) {
-      /* By pressing BACK, we always go to the default menu when we are
-       * in a top-level menu */
-      opState = OPSTATE_DEFAULT;
-    }
-  }
-}
-
 /***f* tempStep
  *
  * Returns the appropriate
@@ -286,174 +238,399 @@ float tempStep() {
   else if(upOrDownPressCount >= mediumKeyPressCountMin)
     temp_increment = 1;
 
-  upOrDownPressCount++;
-
   return temp_increment;
 }
 
-/***f* tempMenu
- *
- * We run this function only in the opstates
- * OPSTATE_MENU_TEMP and OPSTATE_MENU_TEMP_SETUP
- */
-void tempMenu(IN uint8_t buttonsPressed) {
-
-  if (opState == OPSTATE_MENU_TEMP) {
-    printLcdLine(LCD_TOP_LEVEL_MENU_LABELS[1]);
-    if (buttonsPressed & BTN_OK) {
-      /* By pressing OK, we enter the submenu OPSTATE_MENU_TEMP_SETUP */
-      opState = OPSTATE_MENU_TEMP_SETUP;
-    } else if (buttonsPressed & BTN_DOWN) {
-      /* By pressing DOWN, we go to the next top-level menu */
-      opState = OPSTATE_MENU_PRESET;
-    } else if (buttonsPressed & BTN_UP) {
-      /* By pressing UP, we go to the previous top-level menu */
-      opState = OPSTATE_MENU_TURN_OFF;
-    } else if (buttonsPressed & BTN_BACK) {
-      /* By pressing BACK, we always go to the default menu when we are
-       * in a top-level menu */
-      opState = OPSTATE_DEFAULT;
-    }
-  } else if (opState == OPSTATE_MENU_TEMP_SETUP) {
-    if (prevOpState != opState) {
-      printLcdLine(LCD_STR_SET_TARGET_TEMP);
-      lcd.setCursor(1, 1);
-      lcd.write(byte(0));
-    } else {
-      printLcdLine(LCD_STR_SET_TARGET_TEMP, 1);
-    }
-    lcd.setCursor(2, 1);
-    lcd.print(temporary_temperature);
-
-    if (buttonsPressed & BTN_OK) {
-      /* TODO
-       * By pressing OK, Save the desired temperature for the runtime,
-       * and in EEPROM if the user has selected the restore settings
-       * after shut-down option through the web.
-       *
-       * Then Go to the previous menu which is OPSTATE_MENU_TEMP
-       */
-      desired_temperature = temporary_temperature;
-      opState = OPSTATE_MENU_TEMP;
-    } else if (buttonsPressed & BTN_DOWN) {
-      /* Decrease the temperature but respect the limits */
-      if (temporary_temperature - tempStep() < MIN_TEMPERATURE)
-        temporary_temperature = MIN_TEMPERATURE;
-      else
-        temporary_temperature -= tempStep();
-    } else if (buttonsPressed & BTN_UP) {
-      /* Increase the temperature but respect the limits */
-      if (temporary_temperature + tempStep() > MAX_TEMPERATURE)
-        temporary_temperature = MAX_TEMPERATURE;
-      else
-        temporary_temperature += tempStep();
-    } else if (buttonsPressed & BTN_BACK) {
-      /* By pressing BACK, go to the upper menu where we came from
-       * without saving the changes to the temperature */
-      temporary_temperature = desired_temperature;
-      opState = OPSTATE_MENU_TEMP;
-    }
+/************************************************************************************/
+/*************************** MENU ACTIONS AND SCREENS *******************************/
+/************************************************************************************/
+
+/* The actions run when a button moves the menu (see MENU_TABLE). They
+ * run before opState changes to the next state of the transition. */
+
+void tempSetupEnter() {
+  temporary_temperature = getDesiredTemperature();
+}
+
+void tempSetupSave() {
+  /* Setting the temperature by hand stops the cook program.
+   * The temperature is restored after a reboot. */
+  programStop();
+  setDesiredTemperature(temporary_temperature);
+  settingsSetDesiredTemperature(temporary_temperature);
+}
+
+void tempSetupCancel() {
+  /* Go to the upper menu where we came from without
+   * saving the changes to the temperature */
+  temporary_temperature = getDesiredTemperature();
+}
+
+void tempDecrease() {
+  /* Decrease the temperature but respect the limits */
+  float step = tempStep();
+  if (temporary_temperature - step < MIN_TEMPERATURE)
+    temporary_temperature = MIN_TEMPERATURE;
+  else
+    temporary_temperature -= step;
+}
+
+void tempIncrease() {
+  /* Increase the temperature but respect the limits */
+  float step = tempStep();
+  if (temporary_temperature + step > MAX_TEMPERATURE)
+    temporary_temperature = MAX_TEMPERATURE;
+  else
+    temporary_temperature += step;
+}
+
+void menuIndexReset() {
+  menuIndex = 0;
+}
+
+/* The number of items in the list of the current opState */
+uint8_t menuItemCount() {
+  switch (opState) {
+    case OPSTATE_MENU_PRESET_CHOOSE:
+      return presetCount();
+    case OPSTATE_MENU_NET_SETTINGS_SHOW:
+      return NET_INFO_PAGES;
+    default:
+      return 1;
   }
 }
 
-/***f* preset
+void menuIndexNext() {
+  if (++menuIndex >= menuItemCount())
+    menuIndex = 0;
+}
+
+void menuIndexPrev() {
+  if (menuIndex == 0)
+    menuIndex = menuItemCount();
+  if (menuIndex > 0)
+    menuIndex--;
+}
+
+void presetChooseApply() {
+  if (presetCount() == 0)
+    return;
+
+  presetApply(menuIndex % presetCount());
+  temporary_temperature = getDesiredTemperature();
+}
+
+/* The screens. They render the current state in the LCD shadow buffer,
+ * which is sent to the LCD by lcdBufferFlush() at the beginning of the
+ * next loop. The states that only show a label don't need one. */
+
+/***f* renderFault
  *
- * We run this function only in the opstates
- * OPSTATE_MENU_PRESET and OPSTATE_MENU_PRESET_CHOOSE
+ * Renders the first latched fault, like "Fault E2" and
+ * "over_temperature", and how to turn the device off.
  */
-void preset(IN uint8_t buttonsPressed) {
-  if (opState == OPSTATE_MENU_PRESET) {
-    printLcdLine(LCD_TOP_LEVEL_MENU_LABELS[2]);
-    if (buttonsPressed & BTN_OK) {
-      /* By pressing OK, we enter the submenu OPSTATE_MENU_PRESET_CHOOSE */
-      opState = OPSTATE_MENU_PRESET_CHOOSE;
-    } else if (buttonsPressed & BTN_DOWN) {
-      /* By pressing DOWN, we go to the next top-level menu */
-      opState = OPSTATE_MENU_NET_SETTINGS;
-    } else if (buttonsPressed & BTN_UP) {
-      /* By pressing UP, we go to the previous top-level menu */
-      opState = OPSTATE_MENU_TEMP;
-    } else if (buttonsPressed & BTN_BACK) {
-      /* By pressing BACK, we always go to the default menu when we are
-       * in a top-level menu */
-      opState = OPSTATE_DEFAULT;
-    }
-  } else if (opState == OPSTATE_MENU_PRESET_CHOOSE) {
-    /* TODO: Handle all the buttons for the submenu for
-     *       choosing presets */
-  }
+void renderFault() {
+  char str[LCD_COLS_CHAR_LIMIT];
+  uint8_t code = faultsFirst();
+  uint8_t current_message_index = getMessageAlternationIndex(2);
+
+  printLcdLine(LCD_STR_FAULT[current_message_index]);
+  if (current_message_index != 0)
+    return;
+
+  utoa(code, str, 10);
+  lcdBufferWrite(strlen_P(str15_1), 0, str);
+  strncpy_P(str, faultName(code), LCD_COLS);
+  str[LCD_COLS] = '\0';
+  lcdBufferWrite(0, 1, str);
+}
+
+void renderOffTurnOn() {
+  setRgbLed(RGB_LED_OFF);
+  printLcdLine(LCD_STR_PRESS_OK_TO_START);
 }
 
-/***f* netSettings
+/***f* renderProgram
  *
- * We run this function only in the opstates
- * OPSTATE_MENU_NET_SETTINGS and OPSTATE_MENU_NET_SETTINGS_SHOW
+ * Renders the stage of the running cook program, and the hold time
+ * that is left or the temperature that the stage goes to.
  */
-void netSettings(IN uint8_t buttonsPressed) {
-  if (opState == OPSTATE_MENU_NET_SETTINGS) {
-    printLcdLine(LCD_TOP_LEVEL_MENU_LABELS[3]);
-    if (buttonsPressed & BTN_OK) {
-      /* By pressing OK, we enter the submenu OPSTATE_MENU_NET_SETTINGS_SHOW */
-      opState = OPSTATE_MENU_NET_SETTINGS_SHOW;
-    } else if (buttonsPressed & BTN_DOWN) {
-      /* By pressing DOWN, we go to the next top-level menu */
-      opState = OPSTATE_MENU_TURN_OFF;
-    } else if (buttonsPressed & BTN_UP) {
-      /* By pressing UP, we go to the previous top-level menu */
-      opState = OPSTATE_MENU_PRESET;
-    } else if (buttonsPressed & BTN_BACK) {
-      /* By pressing BACK, we always go to the default menu when we are
-       * in a top-level menu */
-      opState = OPSTATE_DEFAULT;
-    }
-  } else if (opState == OPSTATE_MENU_NET_SETTINGS_SHOW) {
-    /* TODO */
+void renderProgram(IN const program_status *st) {
+  char str[LCD_COLS_CHAR_LIMIT];
+
+  printLcdLine(LCD_STR_PROGRAM[st->state - PROGRAM_RAMP]);
+
+  /* "stage/stages" at the end of the first line */
+  utoa(st->stage + 1, str, 10);
+  strcat(str, "/");
+  utoa(st->num_stages, str + strlen(str), 10);
+  lcdBufferWrite(LCD_COLS - strlen(str), 0, str);
+
+  if (st->state == PROGRAM_HOLD) {
+    /* Like "1h59m left". Round the minutes up, so that
+     * it says 0m only when the time is up. */
+    uint32_t minutes = (st->hold_left_s + 59) / 60;
+    ultoa(minutes / 60, str, 10);
+    strcat(str, "h");
+    utoa(minutes % 60, str + strlen(str), 10);
+    strcat_P(str, PSTR("m left"));
+    lcdBufferWrite(0, 1, str);
+  } else {
+    uint8_t num_stages;
+    const program_stage *stages = programGetStages(&num_stages);
+    lcdBufferWriteChar(1, 1, LCD_CHAR_DEGREE);
+    lcdBufferWriteFloat(2, 1, stages[st->stage].temperature / 10.0);
+  }
+}
+
+void renderTemperature() {
+  program_status st;
+  programGetStatus(&st);
+
+  if (st.notify) {
+    printLcdLine(LCD_STR_PROGRAM_DONE);
+    return;
+  }
+
+  /* The current and target temperatures, and the cook program if it runs */
+  bool program_runs = (st.state == PROGRAM_RAMP || st.state == PROGRAM_HEAT ||
+                       st.state == PROGRAM_HOLD);
+  uint8_t total_strings_str = sizeof(LCD_DISPLAY_TEMPERATURE) / sizeof(char*) / LCD_ROWS;
+  uint8_t current_message_index = getMessageAlternationIndex(total_strings_str + program_runs);
+
+  if (current_message_index == total_strings_str) {
+    renderProgram(&st);
+    return;
+  }
+
+  /* The current temperature must be first in the next array.
+   * The goal/target/desired temperature must be second */
+  float current_goal_temps[2] = {(float)current_temperature, (float)getDesiredTemperature()};
+
+  printLcdLine(LCD_DISPLAY_TEMPERATURE[current_message_index]);
+  lcdBufferWriteChar(1, 1, LCD_CHAR_DEGREE);
+  lcdBufferWriteFloat(2, 1, current_goal_temps[current_message_index]);
+}
+
+void renderTempSetup() {
+  printLcdLine(LCD_STR_SET_TARGET_TEMP);
+  lcdBufferWriteChar(1, 1, LCD_CHAR_DEGREE);
+  lcdBufferWriteFloat(2, 1, temporary_temperature);
+}
+
+void renderPresetChoose() {
+  if (presetCount() == 0) {
+    printLcdLine(LCD_STR_NO_PRESETS);
+    return;
+  }
+
+  const preset *p = presetGet(menuIndex % presetCount());
+  printLcdLine(LCD_STR_PRESET);
+  lcdBufferWrite(0, 0, p->name);
+  lcdBufferWriteChar(1, 1, LCD_CHAR_DEGREE);
+  lcdBufferWriteFloat(2, 1, presetTemperature(p));
+
+  /* The duration in minutes at the end of the second line */
+  if (p->duration) {
+    char str_duration[7];
+    utoa(p->duration, str_duration, 10);
+    strcat(str_duration, "m");
+    lcdBufferWrite(LCD_COLS - strlen(str_duration), 1, str_duration);
   }
 }
 
-/***f* display_temperature
+void renderNetInfo() {
+  uint8_t page = menuIndex % NET_INFO_PAGES;
+  char str_ip[IP_STR_SIZE];
+
+  switch (page) {
+    case 0:
+      printLcdLine(LCD_STR_NET_INFO[page]);
+      lcdBufferWrite(0, 1, formatIp(ether.myip, str_ip));
+      break;
+    case 1:
+      printLcdLine(LCD_STR_NET_INFO[page]);
+      lcdBufferWrite(0, 1, formatIp(ether.netmask, str_ip));
+      break;
+    case 2:
+      printLcdLine(LCD_STR_NET_INFO[page]);
+      lcdBufferWrite(0, 1, formatIp(ether.gwip, str_ip));
+      break;
+    default:
+      printLcdLine(LCD_STR_NET_LINK[networkState() != NET_STATE_NO_CONTROLLER && eth_link_state_up() ? 1 : 0]);
+      break;
+  }
+}
+
+/************************************************************************************/
+/********************************** MENU TABLE **************************************/
+/************************************************************************************/
+
+/* The buttons that move the menu. The order matches the bits of the
+ * push_buttons enum, so the event of a button is its bit number. */
+enum menuEvent {
+  MENU_EVENT_BACK = 0,
+  MENU_EVENT_OK,
+  MENU_EVENT_DOWN,
+  MENU_EVENT_UP,
+  MENU_EVENT_COUNT
+};
+
+static_assert(BTN_BACK == (1 << MENU_EVENT_BACK) && BTN_OK == (1 << MENU_EVENT_OK) &&
+              BTN_DOWN == (1 << MENU_EVENT_DOWN) && BTN_UP == (1 << MENU_EVENT_UP),
+              "The menu events must match the push_buttons bits");
+
+#define MENU_STAY 0xFF // A transition that doesn't change the opState
+
+typedef void (*menuFunc)();
+
+typedef struct _menu_transition {
+  uint8_t next;      // The next opState, or MENU_STAY
+  menuFunc action;   // NULL for no action
+} menu_transition;
+
+typedef struct _menu_state {
+  menuFunc render;                 // NULL if the state only shows 'label'
+  const char * const *label;       // LCD_ROWS strings in flash
+  menu_transition on[MENU_EVENT_COUNT];
+} menu_state;
+
+/* The whole menu, indexed by opState. Every row has the screen of the
+ * state and what each of BACK, OK, DOWN and UP does in it. It is kept in
+ * flash and looked up directly, so a new menu costs only a row here (and
+ * a new operatingState).
+ */
+const menu_state MENU_TABLE[] PROGMEM = {
+  /* OPSTATE_OFF_TURN_ON */
+  {renderOffTurnOn, NULL, {
+    /* BACK */ {MENU_STAY, NULL},
+    /* OK   */ {OPSTATE_DEFAULT, NULL},
+    /* DOWN */ {MENU_STAY, NULL},
+    /* UP   */ {MENU_STAY, NULL}}},
+  /* OPSTATE_DISPLAY_TEMP */
+  {renderTemperature, NULL, {
+    /* BACK */ {MENU_STAY, NULL},
+    /* OK   */ {OPSTATE_MENU_TEMP, NULL},
+    /* DOWN */ {OPSTATE_MENU_TEMP, NULL},
+    /* UP   */ {OPSTATE_MENU_TEMP, NULL}}},
+  /* OPSTATE_MENU_TURN_OFF */
+  {NULL, LCD_TOP_LEVEL_MENU_LABELS[0], {
+    /* BACK */ {OPSTATE_DEFAULT, NULL},
+    /* OK   */ {OPSTATE_OFF_TURN_ON, _turnOff},
+    /* DOWN */ {OPSTATE_MENU_TEMP, NULL},
+    /* UP   */ {OPSTATE_MENU_NET_SETTINGS, NULL}}},
+  /* OPSTATE_MENU_TEMP */
+  {NULL, LCD_TOP_LEVEL_MENU_LABELS[1], {
+    /* BACK */ {OPSTATE_DEFAULT, NULL},
+    /* OK   */ {OPSTATE_MENU_TEMP_SETUP, tempSetupEnter},
+    /* DOWN */ {OPSTATE_MENU_PRESET, NULL},
+    /* UP   */ {OPSTATE_MENU_TURN_OFF, NULL}}},
+  /* OPSTATE_MENU_TEMP_SETUP */
+  {renderTempSetup, NULL, {
+    /* BACK */ {OPSTATE_MENU_TEMP, tempSetupCancel},
+    /* OK   */ {OPSTATE_MENU_TEMP, tempSetupSave},
+    /* DOWN */ {MENU_STAY, tempDecrease},
+    /* UP   */ {MENU_STAY, tempIncrease}}},
+  /* OPSTATE_MENU_PRESET */
+  {NULL, LCD_TOP_LEVEL_MENU_LABELS[2], {
+    /* BACK */ {OPSTATE_DEFAULT, NULL},
+    /* OK   */ {OPSTATE_MENU_PRESET_CHOOSE, menuIndexReset},
+    /* DOWN */ {OPSTATE_MENU_NET_SETTINGS, NULL},
+    /* UP   */ {OPSTATE_MENU_TEMP, NULL}}},
+  /* OPSTATE_MENU_PRESET_CHOOSE */
+  {renderPresetChoose, NULL, {
+    /* BACK */ {OPSTATE_MENU_PRESET, NULL},
+    /* OK   */ {OPSTATE_DEFAULT, presetChooseApply},
+    /* DOWN */ {MENU_STAY, menuIndexNext},
+    /* UP   */ {MENU_STAY, menuIndexPrev}}},
+  /* OPSTATE_MENU_NET_SETTINGS */
+  {NULL, LCD_TOP_LEVEL_MENU_LABELS[3], {
+    /* BACK */ {OPSTATE_DEFAULT, NULL},
+    /* OK   */ {OPSTATE_MENU_NET_SETTINGS_SHOW, menuIndexReset},
+    /* DOWN */ {OPSTATE_MENU_TURN_OFF, NULL},
+    /* UP   */ {OPSTATE_MENU_PRESET, NULL}}},
+  /* OPSTATE_MENU_NET_SETTINGS_SHOW */
+  {renderNetInfo, NULL, {
+    /* BACK */ {OPSTATE_MENU_NET_SETTINGS, NULL},
+    /* OK   */ {OPSTATE_MENU_NET_SETTINGS, NULL},
+    /* DOWN */ {MENU_STAY, menuIndexNext},
+    /* UP   */ {MENU_STAY, menuIndexPrev}}}
+};
+
+static_assert(sizeof(MENU_TABLE) / sizeof(menu_state) == OPSTATE_UNKNOWN,
+              "MENU_TABLE must have a row for every operatingState");
+
+/***f* menuDispatch
  *
- * Displays the temperature in the LCD.
- * We run this function only in the opstate OPSTATE_DISPLAY_TEMP
+ * Runs the transition of the clicked button (if any) for the current
+ * opState and then renders the screen of the resulting state.
  */
-void display_temperature(uint8_t buttonsPressed) {
-  if (opState == OPSTATE_DISPLAY_TEMP) {
-    uint8_t total_strings_str = sizeof(LCD_DISPLAY_TEMPERATURE) / sizeof(char*) / LCD_ROWS;
-    uint8_t current_message_index = getMessageAlternationIndex(total_strings_str);
-    /* The current temperature must be first in the next array.
-     * The goal/target/desired temperature must be second */
-    // TODO: Add the correct temperatures from the variables
-    float current_goal_temps[2] = {current_temperature, desired_temperature};
-
-    if (prevOpState != opState) {
-      printLcdLine(LCD_DISPLAY_TEMPERATURE[current_message_index]);
-      lcd.setCursor(1, 1);
-      lcd.write(byte(0));
-    } else {
-      /* If the previous opState was the same, then don't rewrite the
-       * second line of the LCD to avoid some flickering. It will be
-       * overwritten anyway once we update the temperature */
-      printLcdLine(LCD_DISPLAY_TEMPERATURE[current_message_index], 1);
-    }
-    lcd.setCursor(2, 1);
-    lcd.print(current_goal_temps[current_message_index]);
+void menuDispatch(IN uint8_t buttonsPressed) {
+  if (opState >= OPSTATE_UNKNOWN) {
+    opState = OPSTATE_UNKNOWN;
+    return;
   }
 
-  if ((buttonsPressed & BTN_OK) |
-      (buttonsPressed & BTN_DOWN) |
-      (buttonsPressed & BTN_UP)) {
-    /* By pressing OK, UP or DOWN from the default state,
-     * we go to the OPSTATE_MENU_TEMP top level menu */
-    opState = OPSTATE_MENU_TEMP;
+  /* Button events carry a single button. Take the lowest if there are more */
+  for (uint8_t ev = 0; ev < MENU_EVENT_COUNT; ev++) {
+    if (!(buttonsPressed & (1 << ev)))
+      continue;
+
+    const menu_transition *t = &MENU_TABLE[opState].on[ev];
+    uint8_t next = pgm_read_byte(&t->next);
+    menuFunc action = (menuFunc)pgm_read_word(&t->action);
+
+    if (action)
+      action();
+    if (next != MENU_STAY)
+      opState = (operatingState)next;
+    break;
   }
+
+  const menu_state *st = &MENU_TABLE[opState];
+  menuFunc render = (menuFunc)pgm_read_word(&st->render);
+  if (render)
+    render();
+  else
+    printLcdLine((const char * const *)pgm_read_word(&st->label));
+}
+
+/***f* recordPidTerms
+ *
+ * Exports the terms of the last PID computation and keeps the integral
+ * term for the checkpoint. Call right after controllerSample().
+ */
+void recordPidTerms() {
+  controller_terms t;
+  controllerGetTerms(&t);
+  pidIntegral = t.i;
+  metricsSetPid(t.output, t.p, t.i, t.d);
+  LOG_LIMIT(1000, LOG_PID, t.output, t.p, t.i, t.d);
 }
 
 /* Function that will be executed everytime Timer1 overflows */
 ISR(TIMER1_OVF_vect)
 {
-  /* If we are in the devMode, turn pump and SSR off and return */
-  if (opState != OPSTATE_OFF_TURN_ON) {
-    if (deviceIsInWater(readButtons())) {
+  PROFILE_SCOPE(PROFILE_CONTROL_ISR);
+  unsigned long now_us = micros();
+  uint8_t ssr_output = 0;
+  bool control = false;
+  static uint8_t last_ssr_output = 0;
+
+  watchdogCheckIn(WDT_TASK_CONTROL);
+
+  /* Debounce the buttons and queue the button events for loop() */
+  uint8_t buttons = readButtons();
+  buttonsTick(buttons);
+
+  /* Check for faults before driving the heater, so that the heater is
+   * off in the same tick that a fault is detected */
+  bool inWater = deviceIsInWater(buttonsState());
+  bool faulted = faultsTick(opState != OPSTATE_OFF_TURN_ON && inWater, last_ssr_output);
+
+  /* In the devMode, turn pump and SSR off */
+  if (opState != OPSTATE_OFF_TURN_ON && !faulted) {
+    if (inWater) {
       /* Make sure the pump circulates the water, and
        * control the Sous Vide with the PID
        * TODO: Although I have an SSR, the SSR cannot
@@ -462,23 +639,37 @@ ISR(TIMER1_OVF_vect)
        */
       if (devMode) {
         pump_operate(false);
-        ssr_operate(0);
       } else {
         pump_operate(true);
-        SousPID.Compute();
-        Serial.print(F("PID Output: "));
-        Serial.println(PID_Output);
-        ssr_operate(PID_Output);
+        /* Move the setpoint of the cook program before the PID uses it */
+        programTick();
+        control = true;
       }
     } else {
       pump_operate(false);
-      ssr_operate(0);
     }
   } else {
       pump_operate(false);
-      ssr_operate(0);
   }
 
+  /* The PID runs once per temperature sample, with its real dt. While
+   * the heater is kept off it is in MANUAL, and follows the samples and
+   * the applied output, so that it takes over again without a bump. */
+  controllerSetMode(control ? CONTROLLER_AUTOMATIC : CONTROLLER_MANUAL);
+  temp_sample sample;
+  if (temperatureTakeSample(&sample)) {
+    controllerSample(sample.celsius, desired_temperature, sample.at_ms);
+    recordPidTerms();
+  }
+  if (control)
+    ssr_output = controllerOutput();
+  ssr_operate(ssr_output);
+  controllerTrack(ssr_output);
+
+  last_ssr_output = ssr_output;
+  metricsControlTick(now_us, ssr_output);
+  traceTick(buttons, ssr_output);
+
   TCNT1 = 0xFD8F; // Since the timer just overflowed if we run in this function,
                   // set the TCNT1 register to the appropriate value in order
                   // to keep our 10ms timed interrupts.
@@ -489,6 +680,9 @@ ISR(TIMER1_OVF_vect)
  * Default Arduino setup function
  */
 void setup() {
+  /* Reset the board if any of the initialization below hangs */
+  watchdogInit();
+
   /* Define INPUT/OUTPUT Pins */
   pinMode(PUSH_BTN_MENU_BACK_PIN, INPUT);
   pinMode(PUSH_BTN_MENU_OK_PIN, INPUT);
@@ -502,31 +696,68 @@ void setup() {
 
   /* Initialize the LCD */
   lcd.begin(LCD_COLS, LCD_ROWS); //  <<----- My LCD is 16x2, or 20x4
-  lcd.createChar(0, degree_symbol); // Store in byte 0 in LCD the degree_symbol (available bytes are 0-7)
+  lcd.createChar(LCD_CHAR_DEGREE, degree_symbol); // Store in byte 0 in LCD the degree_symbol (available bytes are 0-7)
+  lcdBufferInit();
 
   /* Turn on the backlight during initialization */
   setLcdBacklight(LCD_ON);
 
   /* Print an "Initializing temp sensors" message in the LCD */
   printLcdLine(LCD_STR_INIT_TEMP_SENSORS);
+  lcdBufferFlush();
 
   /* Initialize the temperature sensors
    * and initiate a first temperature reading. */
+  watchdogBootStage(BOOT_STAGE_TEMP_SENSORS);
   initTempSensors();
   _requestAllTemperatures();
 
   /* Print an "Initializing Network" message in the LCD */
   printLcdLine(LCD_STR_INIT_NETWORK);
+  lcdBufferFlush();
 
   /* Initialize the network but do not configure IP addresses yet
-   * We do that in the main loop because we need to react to link
-   * state changes
+   * We do that in networkTask() from the main loop because we need to
+   * react to link state changes, and DHCP takes seconds. If the previous boot hung in here, the watchdog
+   * has reset the board; don't touch the Ethernet controller again,
+   * so that the Sous Vide works without the network.
    */
-  initNetworkModule();
+  watchdogBootStage(BOOT_STAGE_NETWORK);
+  if (!initNetworkModule(watchdogHungIn(BOOT_STAGE_NETWORK)))
+    faultsRaise(FAULT_NETWORK_INIT);
+  if (watchdogResetCause() & (1 << WDRF))
+    faultsRaise(FAULT_WATCHDOG);
+
+  /* Load the settings and the cooking presets from the EEPROM.
+   * NetEEPROM has been initialized by initNetworkModule(). */
+  watchdogBootStage(BOOT_STAGE_SETTINGS);
+  settingsInit();
+  presetsInit();
+
+  /* Record the inputs from here on, starting with the settings */
+  traceStart();
 
   /* Initialize the desired temperature */
   initDesiredTemperature();
-  temporary_temperature = desired_temperature;
+
+  /* Wait for the first temperature conversion. Resuming
+   * a cook depends on the temperature of the water. */
+  while (timeElapsedSinceLastMeasurement < TempSensorModel::conversion_ms)
+    continue;
+  readAllTemperatures();
+
+  /* If a reset interrupted a cook, continue it. The PID starts
+   * from the checkpointed integral term (see controllerStart() below),
+   * so the heater power continues where it was instead of starting
+   * from zero. */
+  cook_checkpoint cp;
+  if (checkpointInit(&cp)) {
+    desired_temperature = cp.setpoint;
+    programRestoreState(&cp.program);
+    pidIntegral = cp.pid_integral;
+    opState = OPSTATE_DEFAULT;
+  }
+  temporary_temperature = getDesiredTemperature();
 
   /* Set a timed interrupt every 10ms */
   cli();  // Disable global interrupts
@@ -554,7 +785,17 @@ void setup() {
   sei(); // Enable global interrupts
 
   //turn the PID on
-  SousPID.SetMode(AUTOMATIC);
+  cli();
+  controllerSetTunings(settingsGet()->kp, settingsGet()->ki, settingsGet()->kd);
+  controllerStart(pidIntegral);
+  sei();
+
+  /* From now on the watchdog is reset only while the loop,
+   * the Timer1 ISR and the temperature readings all run */
+  watchdogStart();
+
+  /* Nothing may be allocated on the heap from now on */
+  memoryMarkSetupDone();
 }
 
 /***f* loop
@@ -562,120 +803,154 @@ void setup() {
  * Main Arduino loop function
  */
 void loop() {
+  watchdogTask();
+  metricsLoopIteration(micros());
+  metricsSetOpState(opState);
+
   if (opState == OPSTATE_UNKNOWN) {
     /* If we get an unknown opState, just power off the device
      * for safety reasons and don't let the loop to run (return). */
     _turnOff();
     return;
   }
+
+  /* A cook program that ends with STAGE_END_OFF has finished */
+  if (programTakeOffRequest()) {
+    opState = OPSTATE_OFF_TURN_ON;
+    _turnOff();
+  }
+
+  /* Send to the LCD whatever changed in the screens
+   * that were rendered in the previous loop */
+  lcdBufferFlush();
+
   /* Increases all the LCD message alternation index */
   increaseMessageAlternationIndex();
 
+  /* Execute any commands received over the serial port */
+  processSerialCommands();
+
+  /* Send what has been logged, as much as the serial port takes */
+  logTask();
+
+  /* Record the outputs, and stream the trace if asked to */
+  traceTask(opState, getDesiredTemperature());
+
+  /* Look for the stack high-water mark every now and then */
+  memoryMonitor();
+
+  /* Write the changed settings in the EEPROM, a byte at a time */
+  settingsTask();
+
+  /* Checkpoint the cook, so that it continues after a reset */
+  checkpointTask(opState != OPSTATE_OFF_TURN_ON && opState != OPSTATE_UNKNOWN);
+
   /* Read the latest temperature, and request new temperatures if needed
    * All of this is handled from the readAllTemperatures() function.
    * The user just needs to read the avg_temperature, current_temperature
    * or *temperature array.
    */
-  readAllTemperatures();
-
-  /* If the network link is up and the netInitialized == false, we should initialize
-   * the network addresses and set the netInitialized to true. If the link is down
-   * and the netInitialized == true, we need to set the netInitialized to false again.
-   *
-   * If the network is initialized and the link is up then process ethernet packets.
-   */
-  if (netInitialized == false && eth_link_state_up() == true) {
-    initNetworkAddr();
-    netInitialized = true;
-    Serial.println(F("Ethernet link is up."));
-  } else if (netInitialized == true) {
-    if (eth_link_state_up() == false) {
-      netInitialized = false;
-      Serial.println(F("Ethernet link is down."));
-    } else {
-      /* Copy received packets to data buffer Ethernet::buffer
-       * and return the uint16_t Size of received data (which is needed by
-       * ether.packetLoop). */
-      uint16_t len = ether.packetReceive();
-      /* Parse received data and return the uint16_t Offset of TCP payload data
-       * in data buffer Ethernet::buffer, or zero if packet processed */
-      uint16_t pos = ether.packetLoop(len);
-
-      processEthernetPacket(pos);
-    }
+  {
+    PROFILE_SCOPE(PROFILE_READ_TEMPERATURES);
+    readAllTemperatures();
   }
 
-  /* Now read the buttons and execute the opState functions once every
-   * 150ms TODO: We need to be reading the buttons much faster, but
-   *             we should take care of how we handle double-presses due
-   *             to long press of buttons.
+  /* Bring up the network in the background, and process the
+   * ethernet packets once it is up */
+  networkTask();
+
+  /* The buttons are debounced in the Timer1 ISR. Take one button event per
+   * loop and execute the opState functions right away, so that a press is
+   * handled within a few milliseconds. Without events, execute the opState
+   * functions every intervalBetweenOpStateFuncExec to refresh the screen.
    */
-  if (millis() - lastTimeButtonWasPressed > 150) {
-    buttonsPressed = readButtons();
-
-    /* If we are not in devMode, check if we need to get into devMode */
-    if (!devMode) {
-      /* Check if both UP and DOWN buttons are pressed for at least 6 seconds
-       * and set the device to the DEVELOPMENT mode. Once the device is in
-       * development  mode, it will stay in that mode until a power reset.
-       */
-      if ((buttonsPressed & BTN_DOWN) && (buttonsPressed & BTN_UP)) {
-        if (upAndDownPressCount >= devModePressCount) {
-          devMode = true;
-          printLcdLine(LCD_STR_DEVMODE_NOW_ON);
-          setRgbLed(RGB_LED_VIOLET);
-          delay(3000); // Show the LCD message for 3 seconds
-                       // This will happen only once when devMode is enabled,
-                       // and only during development or testing so we don't
-                       // care that we will block the program flow for 3 seconds.
-        }
-        upAndDownPressCount += 1;
-      } else
-        upAndDownPressCount = 0;
+  button_event ev;
+  bool gotEvent = buttonsGetEvent(&ev);
+  intervalBetweenOpStateFuncExec = isLcdBacklightOn() ? 150 : 300;
+  if (gotEvent || millis() - lastTimeExecutedOpStateFunc > intervalBetweenOpStateFuncExec) {
+    lastTimeExecutedOpStateFunc = millis();
+    buttonsPressed = gotEvent ? buttonsClicked(&ev) : 0;
+    upOrDownPressCount = gotEvent ? ev.repeats : 0;
+
+    /* If both UP and DOWN buttons are pressed for BUTTON_CHORD_TICKS
+     * set the device to the DEVELOPMENT mode. Once the device is in
+     * development  mode, it will stay in that mode until a power reset.
+     */
+    if (!devMode && gotEvent && ev.type == BTN_EVENT_CHORD) {
+      devMode = true;
+      printLcdLine(LCD_STR_DEVMODE_NOW_ON);
+      lcdBufferFlush();
+      setRgbLed(RGB_LED_VIOLET);
+      /* Show the LCD message for 1.5 seconds. This will happen only once
+       * when devMode is enabled, and only during development or testing,
+       * so we don't care that we block the program flow. The temperature
+       * isn't read meanwhile, so stay well under the FAULT_SENSOR_STALE
+       * window. */
+      watchdogSleep(FAULT_STALE_TICKS * FAULT_TICK_MS / 2);
     }
 
-    /* Clear the upOrDownPressCount if neither up or down are pressed */
-    if(!(buttonsPressed & BTN_DOWN) && !(buttonsPressed & BTN_UP))
-      upOrDownPressCount = 0;
-
-    /* Check the lcdBacklightTimeOut */
-    if (buttonsPressed != 0 && buttonsPressed != BTN_FLOAT_SW) {
-      /* If a button is pressed, and this button is not only the
-       * floating switch that will be constantly pressed once the
-       * sous vide is in the water, switch on the backlight if off. */
+    /* Check the lcd_backlight_timeout */
+    if (gotEvent) {
+      /* If a button is pressed or released, switch on the backlight if
+       * off. The floating switch doesn't generate button events. */
       lastTimeButtonWasPressed = millis();
       if (!isLcdBacklightOn()) {
-        Serial.println(F("Backlight is OFF. Turning on."));
+        LOG(LOG_BACKLIGHT_ON);
         setLcdBacklight(LCD_ON);
         /* At this point return, since we don't want to execute anything
          * if the LCD was off and we just turned it on.
          */
         return;
       }
+
+      /* The first press after a cook program has finished
+       * only acknowledges the "Program done" message */
+      program_status st;
+      programGetStatus(&st);
+      if (st.notify && ev.type == BTN_EVENT_PRESS) {
+        programAcknowledge();
+        buttonsPressed = 0;
+      }
     } else {
       /* Switch off the backlight if a button hasn't been pressed for
-       * lcdBacklightTimeOut milliseconds. */
-      if (millis() - lastTimeButtonWasPressed > lcdBacklightTimeOut)
+       * lcd_backlight_timeout milliseconds. With SETTINGS_BACKLIGHT_ALWAYS_ON
+       * this never happens. */
+      if (isLcdBacklightOn() &&
+          millis() - lastTimeButtonWasPressed > settingsGet()->lcd_backlight_timeout)
         setLcdBacklight(LCD_OFF);
     }
 
-    /* Check the menuReturnTimeOut only if the Sous Vide is running,
+    /* Check the menu_return_timeout only if the Sous Vide is running,
      * i.e. is not in the opState OPSTATE_OFF_TURN_ON */
-    if ((millis() - lastTimeButtonWasPressed > menuReturnTimeOut) &&
+    if ((millis() - lastTimeButtonWasPressed > settingsGet()->menu_return_timeout) &&
         (opState != OPSTATE_OFF_TURN_ON)) {
       /* If the menu return timeout has expired, go to the default opstate */
       opState = OPSTATE_DEFAULT;
 
       /* Make sure that the temporary_temperature equals to the
        * desired_temperature if we got an expiration in a menu */
-      temporary_temperature = desired_temperature;
+      temporary_temperature = getDesiredTemperature();
+    }
+
+    /* While a fault keeps the heater off, blink the red LED and show the
+     * fault. OK turns the device off and clears the faults. They are
+     * latched again if the cause is still there. */
+    if (faultsActive() & FAULTS_SAFE_STATE) {
+      setRgbLed((millis() & 512) ? RGB_LED_RED : RGB_LED_OFF);
+      renderFault();
+      if (buttonsPressed & BTN_OK) {
+        opState = OPSTATE_OFF_TURN_ON;
+        _turnOff();
+        faultsClear();
+      }
+      return;
     }
 
     /* If the float_switch is out of the water, then turn off the pump and SSR
      * no matter what is the curent opState and return from the loop function.
      * If the device is in the water, just toggle the proper RGB LED color.
      */
-    if (!deviceIsInWater(buttonsPressed))
+    if (!deviceIsInWater(buttonsState()))
     {
       /* TODO: Now I have the timer that is checking every 10ms if the device
        * is in water, and acts accordingly. So probably I don't need the
@@ -712,17 +987,6 @@ void loop() {
           opState = OPSTATE_OFF_TURN_ON;
       }
 
-      /* If device is our of water, set the prevOpState to unknown.
-       * The prevOpState is not really unknown, but we use this variable
-       * in order to determine if we will refresh all lines in the LCD,
-       * So after the device is out of water and back in, we would want
-       * to make the prevOpState different than the current opState in order
-       * to force a refresh in the LCD and since we expect that under normal
-       * operation the opState will never reach an unknown state, an unknown
-       * pervOpState will "always" be different when compared to the opState.
-       */
-      prevOpState = OPSTATE_UNKNOWN;
-
       return;
     }
 
@@ -741,64 +1005,22 @@ void loop() {
      * to indicate different things.
      */
     if (opState != OPSTATE_OFF_TURN_ON) {
-      if (abs(desired_temperature - current_temperature) > 2)
+      program_status st;
+      programGetStatus(&st);
+      double off_by = getDesiredTemperature() - current_temperature;
+      if (st.notify)
+        setRgbLed(RGB_LED_BLUE);
+      else if (abs(off_by) > 2)
         setRgbLed(RGB_LED_ORANGE);
-      else if (abs(desired_temperature - current_temperature) > 0.1)
+      else if (abs(off_by) > 0.1)
         setRgbLed(RGB_LED_CYAN);
       else
         setRgbLed(RGB_LED_GREEN);
     }
 
-    /* Execute the corresponding opState function based on the current state.
-     *
-     * Each of the functions that are called in the following switch statement
-     * is changing the opState value. So in order to keep track of the previous
-     * opState in the variable prevOpState, we cannot do something like
-     * prevOpState = opState after the function has been executed, because the
-     * value of the opState has already changed to the value of the "next"
-     * opState. For this reason, assign the value of the prevOpState right
-     * after each function has been executed in each of the "case" statements.
-     */
-    switch (opState) {
-      case OPSTATE_OFF_TURN_ON:
-        turnOn(buttonsPressed);
-        prevOpState = OPSTATE_OFF_TURN_ON;
-        break;
-      case OPSTATE_MENU_TURN_OFF:
-        turnOff(buttonsPressed);
-        prevOpState = OPSTATE_MENU_TURN_OFF;
-        break;
-      case OPSTATE_MENU_PRESET:
-        preset(buttonsPressed);
-        prevOpState = OPSTATE_MENU_PRESET;
-        break;
-      case OPSTATE_MENU_PRESET_CHOOSE:
-        preset(buttonsPressed);
-        prevOpState = OPSTATE_MENU_PRESET_CHOOSE;
-        break;
-      case OPSTATE_MENU_TEMP:
-        tempMenu(buttonsPressed);
-        prevOpState = OPSTATE_MENU_TEMP;
-        break;
-      case OPSTATE_MENU_TEMP_SETUP:
-        tempMenu(buttonsPressed);
-        prevOpState = OPSTATE_MENU_TEMP_SETUP;
-        break;
-      case OPSTATE_MENU_NET_SETTINGS:
-        netSettings(buttonsPressed);
-        prevOpState = OPSTATE_MENU_NET_SETTINGS;
-        break;
-      case OPSTATE_MENU_NET_SETTINGS_SHOW:
-        netSettings(buttonsPressed);
-        prevOpState = OPSTATE_MENU_NET_SETTINGS_SHOW;
-        break;
-      case OPSTATE_DISPLAY_TEMP:
-        display_temperature(buttonsPressed);
-        prevOpState = OPSTATE_DISPLAY_TEMP;
-        break;
-      default:
-        opState = OPSTATE_UNKNOWN;
-        break;
-    }
+    /* Move the menu with the clicked button and render the
+     * screen of the current state (see MENU_TABLE) */
+    PROFILE_SCOPE(PROFILE_OPSTATE_HANDLERS);
+    menuDispatch(buttonsPressed);
   }
-}
+}
@@ -0,0 +1,142 @@
+#!/usr/bin/env python3
+"""Decode the binary log of the Sous Vide firmware.
+
+The firmware sends compact records on the serial port (see
+lib/myincludes/log.h) mixed with the text of the console. This script
+turns the records back to text with the formats of
+lib/myincludes/log_events.h, and passes the text through.
+
+    tools/logdecode.py capture.bin
+    tools/logdecode.py --port /dev/ttyACM0          (needs pyserial)
+"""
+
+import argparse
+import os
+import re
+import struct
+import sys
+
+LOG_SYNC = 0xFE
+LOG_RECORD_OVERHEAD = 7
+LEVELS = {
+    'LOG_LEVEL_ERROR': 'E',
+    'LOG_LEVEL_WARN': 'W',
+    'LOG_LEVEL_INFO': 'I',
+    'LOG_LEVEL_DEBUG': 'D',
+}
+
+EVENTS_H = os.path.join(os.path.dirname(os.path.abspath(__file__)),
+                        '..', 'lib', 'myincludes', 'log_events.h')
+EVENT_RE = re.compile(r'LOG_EVENT\(\s*(\w+)\s*,\s*(\w+)\s*,\s*"((?:[^"\\]|\\.)*)"\s*\)')
+CONVERSION_RE = re.compile(r'%(.)')
+
+
+def load_events(path):
+    """Returns the (name, level, format, conversions) of every event, by id."""
+    with open(path) as f:
+        text = f.read()
+    text = text[text.index('#define LOG_EVENTS'):]
+    events = []
+    for name, level, fmt in EVENT_RE.findall(text):
+        conversions = CONVERSION_RE.findall(fmt)
+        for c in conversions:
+            if c not in 'duxfI':
+                raise ValueError('%s: unknown conversion %%%s' % (name, c))
+        events.append((name, LEVELS.get(level, '?'), fmt, conversions))
+    return events
+
+
+def format_arg(conversion, raw):
+    if conversion == 'd':
+        return str(struct.unpack('<i', raw)[0])
+    if conversion == 'u':
+        return str(struct.unpack('<I', raw)[0])
+    if conversion == 'x':
+        return '%x' % struct.unpack('<I', raw)[0]
+    if conversion == 'f':
+        return '%.2f' % struct.unpack('<f', raw)[0]
+    return '.'.join(str(b) for b in raw)
+
+
+def format_record(event, timestamp, args):
+    name, level, fmt, conversions = event
+    values = iter(format_arg(c, a) for c, a in zip(conversions, args))
+    message = CONVERSION_RE.sub(lambda m: next(values), fmt)
+    return '[%10.3f] %s %s\n' % (timestamp / 1000.0, level, message)
+
+
+class Decoder:
+    def __init__(self, events, out):
+        self.events = events
+        self.out = out
+        self.pending = bytearray()
+
+    def feed(self, data):
+        self.pending += data
+        while self.pending:
+            sync = self.pending.find(LOG_SYNC)
+            if sync != 0:
+                text = self.pending if sync < 0 else self.pending[:sync]
+                self.out.write(text.decode('ascii', 'replace'))
+                del self.pending[:len(text)]
+                continue
+
+            if len(self.pending) < 2:
+                return
+            event_id = self.pending[1]
+            if event_id >= len(self.events):
+                self.skip()
+                continue
+            size = LOG_RECORD_OVERHEAD + 4 * len(self.events[event_id][3])
+            if len(self.pending) < size:
+                return
+            record = self.pending[:size]
+            if sum(record[1:-1]) & 0xFF != record[-1]:
+                self.skip()
+                continue
+
+            timestamp = struct.unpack('<I', record[2:6])[0]
+            args = [bytes(record[6 + 4 * i:10 + 4 * i])
+                    for i in range(len(self.events[event_id][3]))]
+            self.out.write(format_record(self.events[event_id], timestamp, args))
+            del self.pending[:size]
+        self.out.flush()
+
+    def skip(self):
+        """Not a record. Drop the sync byte and look for the next one."""
+        self.out.write('<?>')
+        del self.pending[:1]
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__,
+                                     formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument('capture', nargs='?',
+                        help='a file with the serial output (default: stdin)')
+    parser.add_argument('--port', help='read from a serial port instead')
+    parser.add_argument('--baud', type=int, default=115200)
+    parser.add_argument('--events', default=EVENTS_H, help='the log_events.h to use')
+    options = parser.parse_args()
+
+    decoder = Decoder(load_events(options.events), sys.stdout)
+
+    if options.port:
+        import serial
+        with serial.Serial(options.port, options.baud) as port:
+            while True:
+                decoder.feed(port.read(port.in_waiting or 1))
+
+    source = open(options.capture, 'rb') if options.capture else sys.stdin.buffer
+    with source:
+        while True:
+            data = source.read(4096)
+            if not data:
+                break
+            decoder.feed(data)
+
+
+if __name__ == '__main__':
+    try:
+        main()
+    except KeyboardInterrupt:
+        pass
@@ -0,0 +1,374 @@
+/* Closed-loop benchmark of the firmware, built for the host like the
+ * replay. Instead of a trace, a model of the water bath answers the
+ * heater output of the Timer1 ISR with the temperature readings, and
+ * every scenario below is scored:
+ *
+ *   settle_s       from the event until the water stays within
+ *                  BENCH_BAND_C of the setpoint (null if it never does)
+ *   overshoot_c    the most that the water went past the setpoint
+ *   iae_c_s        the integral of |water - setpoint| after the event
+ *   heater_wh      the energy that the heater put in the water
+ *   switches       how many times the heater output went on or off
+ *   faults         the faults (faults.h) that were active at any time
+ *   isr_cycles_*   host TSC cycles per run of the control ISR
+ *
+ * One JSON object per scenario, one per line, so that the outputs of
+ * two firmware revisions can be compared with a script or a diff:
+ *
+ *   bench [-s scenario] [-k kp ki kd] [-r revision] [-l]
+ */
+
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "replay.h"
+#include "harness.h"
+
+#include "common.h"
+#include "settings.h"
+#include "temperature.h"
+#include "faults.h"
+#include "trace.h"
+
+#define BENCH_LOOP_PERIOD_US 2000
+#define BENCH_BAND_C 0.1
+#define BENCH_PRESS_MS 200             // How long OK is held to turn the Sous Vide on
+
+/* The plant */
+#define BENCH_HEATER_W 1000.0
+#define BENCH_HEATER_TAU_S 10.0        // The heating element warms up and cools down
+#define BENCH_WATER_J_PER_KG_K 4186.0
+#define BENCH_FOOD_J_PER_KG_K 3500.0
+#define BENCH_FOOD_W_PER_K 15.0        // Between the water and the food
+#define BENCH_AMBIENT_C 22.0
+#define BENCH_LID_ON_W_PER_K 4.0
+#define BENCH_LID_OFF_W_PER_K 15.0
+#define BENCH_SENSOR_TAU_S 5.0         // The stainless steel probe of the sensors
+#define BENCH_SENSOR_AIR_TAU_S 60.0    // and out of the water
+
+/* The sensors don't read exactly the same */
+static const float SENSOR_OFFSETS_C[] = {0.0, 0.03, -0.03, 0.06};
+
+typedef enum _bench_event {
+  BENCH_EVENT_NONE = 0,
+  BENCH_EVENT_LOAD,         // Food at load_c is dropped in the water
+  BENCH_EVENT_LID_OFF,      // The heat loss goes up
+  BENCH_EVENT_DROPOUT,      // The first sensor is disconnected for outage_s
+  BENCH_EVENT_OUT_OF_WATER, // The Sous Vide is lifted out of the water for outage_s
+  BENCH_EVENT_STEP          // The setpoint changes to step_c
+} bench_event;
+
+typedef struct _bench_scenario {
+  const char *name;
+  float water_kg;
+  float start_c, setpoint_c;
+  uint8_t event;
+  uint32_t event_s;         // after the Sous Vide is turned on
+  uint32_t duration_s;      // after the event
+  float load_kg, load_c;
+  uint32_t outage_s;
+  float step_c;
+} bench_scenario;
+
+/* The disturbances happen after 20 minutes at the setpoint */
+static const bench_scenario SCENARIOS[] = {
+  /* name               kg   start setpoint  event                event_s duration  load  outage step */
+  {"cold_start_10l",    10, 20, 60, BENCH_EVENT_NONE,    0,    3600,  0, 0,  0,  0},
+  {"cold_start_20l",    20, 20, 60, BENCH_EVENT_NONE,    0,    7200,  0, 0,  0,  0},
+  {"cold_load_1kg",     10, 60, 60, BENCH_EVENT_LOAD,    1200, 3600,  1, 5,  0,  0},
+  {"lid_off",           10, 60, 60, BENCH_EVENT_LID_OFF, 1200, 3600,  0, 0,  0,  0},
+  {"sensor_dropout",    10, 60, 60, BENCH_EVENT_DROPOUT, 1200, 1800,  0, 0, 30,  0},
+  {"out_of_water",      10, 60, 60, BENCH_EVENT_OUT_OF_WATER, 1200, 3600, 0, 0, 120, 0},
+  {"setpoint_step_down",10, 60, 60, BENCH_EVENT_STEP,    1200, 3600,  0, 0,  0, 55},
+};
+#define BENCH_SCENARIO_COUNT (sizeof(SCENARIOS) / sizeof(SCENARIOS[0]))
+
+typedef struct _bench_plant {
+  double water_c, food_c, probe_c;
+  double heater_w;
+  double ua_w_per_k;
+  float food_kg;
+  bool dropout;
+  bool out_of_water;
+} bench_plant;
+
+typedef struct _bench_score {
+  bool started;             // The event has happened
+  double iae, overshoot, energy_j;
+  unsigned long last_outside_ms;
+  unsigned long switches;
+  uint8_t faults;
+} bench_score;
+
+static const bench_scenario *scenario;
+static bench_plant plant;
+static bench_score score;
+static uint8_t heaterOutput = 0;
+static unsigned long eventAt = 0;
+
+/***f* plantStep
+ *
+ * Moves the water bath 'dt' seconds forward with the heater output of
+ * the last ISR run.
+ */
+static void plantStep(IN double dt) {
+  double target_w = BENCH_HEATER_W * heaterOutput / 255;
+  plant.heater_w += (target_w - plant.heater_w) * dt / BENCH_HEATER_TAU_S;
+
+  double loss_w = plant.ua_w_per_k * (plant.water_c - BENCH_AMBIENT_C);
+  double food_w = 0;
+  if (plant.food_kg > 0) {
+    food_w = BENCH_FOOD_W_PER_K * (plant.water_c - plant.food_c);
+    plant.food_c += food_w * dt / (plant.food_kg * BENCH_FOOD_J_PER_KG_K);
+  }
+  plant.water_c += (plant.heater_w - loss_w - food_w) * dt /
+                   (scenario->water_kg * BENCH_WATER_J_PER_KG_K);
+  if (plant.out_of_water)
+    plant.probe_c += (BENCH_AMBIENT_C - plant.probe_c) * dt / BENCH_SENSOR_AIR_TAU_S;
+  else
+    plant.probe_c += (plant.water_c - plant.probe_c) * dt / BENCH_SENSOR_TAU_S;
+}
+
+static void scoreStep(IN double dt) {
+  if (!score.started)
+    return;
+
+  double error = plant.water_c - desired_temperature;
+  double past = (scenario->event == BENCH_EVENT_STEP) ? -error : error;
+  score.iae += fabs(error) * dt;
+  if (past > score.overshoot)
+    score.overshoot = past;
+  if (fabs(error) > BENCH_BAND_C)
+    score.last_outside_ms = harnessMillis();
+  score.energy_j += plant.heater_w * dt;
+  score.faults |= faultsActive();
+}
+
+void harnessBeforeIsr() {
+  static uint8_t last_output = 0;
+  double dt = HARNESS_ISR_PERIOD_US / 1e6;
+
+  plantStep(dt);
+  scoreStep(dt);
+  if ((heaterOutput != 0) != (last_output != 0) && score.started)
+    score.switches++;
+  last_output = heaterOutput;
+}
+
+float replaySensorValue(uint8_t sensor) {
+  if (plant.dropout && sensor == 0)
+    return DEVICE_DISCONNECTED_C;
+
+  /* The DS18B20 reads in 1/16 Celsius */
+  float offset = SENSOR_OFFSETS_C[sensor % (sizeof(SENSOR_OFFSETS_C) / sizeof(float))];
+  return roundf((plant.probe_c + offset) * 16) / 16;
+}
+
+uint16_t replayPacket(uint8_t *frame) {
+  return 0;
+}
+
+void replayReply(uint16_t len) {
+}
+
+void replaySerialWrite(uint8_t c) {
+}
+
+/* ---- trace.h, for the heater output of the ISR ---- */
+
+void traceStart() {
+}
+
+void traceSensors(IN const float *temperatures,
+                  IN uint8_t count) {
+}
+
+void traceTick(IN uint8_t buttons,
+               IN uint8_t heater_output) {
+  heaterOutput = heater_output;
+}
+
+void tracePacket(IN const uint8_t *frame,
+                 IN uint16_t pos) {
+}
+
+void traceTask(IN uint8_t op_state,
+               IN float setpoint) {
+}
+
+void traceStream() {
+}
+
+bool traceStreaming() {
+  return false;
+}
+
+uint16_t tracePrint(OUT Print &out,
+                    IN uint16_t offset,
+                    IN uint16_t max_size) {
+  return 0;
+}
+
+uint16_t traceSize() {
+  return 0;
+}
+
+/* ---- Running the scenarios ---- */
+
+static void runFor(IN unsigned long ms) {
+  unsigned long end = harnessMillis() + ms;
+  while (harnessMillis() < end)
+    harnessLoop(BENCH_LOOP_PERIOD_US);
+}
+
+static void startEvent() {
+  switch (scenario->event) {
+    case BENCH_EVENT_LOAD:
+      plant.food_kg = scenario->load_kg;
+      plant.food_c = scenario->load_c;
+      break;
+    case BENCH_EVENT_LID_OFF:
+      plant.ua_w_per_k = BENCH_LID_OFF_W_PER_K;
+      break;
+    case BENCH_EVENT_DROPOUT:
+      plant.dropout = true;
+      break;
+    case BENCH_EVENT_OUT_OF_WATER:
+      plant.out_of_water = true;
+      harnessSetButtons(0);
+      break;
+    case BENCH_EVENT_STEP:
+      /* As the menu does it */
+      desired_temperature = scenario->step_c;
+      settingsSetDesiredTemperature(desired_temperature);
+      break;
+  }
+  eventAt = harnessMillis();
+  score.started = true;
+  score.last_outside_ms = eventAt;
+}
+
+/***f* runScenario
+ *
+ * Boots the firmware, turns the Sous Vide on and runs the scenario.
+ * The firmware keeps its state in globals, so call it once per process.
+ */
+static void runScenario(IN const float *tunings,
+                        IN const char *revision) {
+  plant.water_c = plant.probe_c = scenario->start_c;
+  plant.ua_w_per_k = BENCH_LID_ON_W_PER_K;
+
+  settingsInit();
+  settingsSetDesiredTemperature(scenario->setpoint_c);
+  if (tunings)
+    settingsSetTunings(tunings[0], tunings[1], tunings[2]);
+  harnessStoreSettings();
+  harnessBoot(BTN_FLOAT_SW);
+
+  harnessSetButtons(BTN_FLOAT_SW | BTN_OK);
+  runFor(BENCH_PRESS_MS);
+  harnessSetButtons(BTN_FLOAT_SW);
+
+  double start = harnessHostMicros();
+  if (scenario->event == BENCH_EVENT_NONE) {
+    startEvent();
+  } else {
+    runFor(scenario->event_s * 1000UL);
+    startEvent();
+  }
+  if (scenario->event == BENCH_EVENT_DROPOUT || scenario->event == BENCH_EVENT_OUT_OF_WATER) {
+    runFor(scenario->outage_s * 1000UL);
+    plant.dropout = false;
+    plant.out_of_water = false;
+    harnessSetButtons(BTN_FLOAT_SW);
+    runFor((scenario->duration_s - scenario->outage_s) * 1000UL);
+  } else {
+    runFor(scenario->duration_s * 1000UL);
+  }
+  double host_s = (harnessHostMicros() - start) / 1e6;
+
+  const settings *s = settingsGet();
+  const host_timing *isr = &harnessIsrTiming;
+  const host_timing *lp = &harnessLoopTiming;
+  bool settled = fabs(plant.water_c - desired_temperature) <= BENCH_BAND_C;
+
+  printf("{\"scenario\": \"%s\"", scenario->name);
+  if (revision)
+    printf(", \"revision\": \"%s\"", revision);
+  printf(", \"kp\": %g, \"ki\": %g, \"kd\": %g", s->kp, s->ki, s->kd);
+  printf(", \"setpoint_c\": %.2f", (double)desired_temperature);
+  if (settled)
+    printf(", \"settle_s\": %.1f", (score.last_outside_ms - eventAt) / 1000.0);
+  else
+    printf(", \"settle_s\": null");
+  printf(", \"overshoot_c\": %.3f, \"iae_c_s\": %.1f, \"heater_wh\": %.1f, \"switches\": %lu",
+         score.overshoot, score.iae, score.energy_j / 3600, score.switches);
+  printf(", \"faults\": %u", score.faults);
+  printf(", \"isr_cycles_avg\": %.0f, \"isr_cycles_max\": %llu, \"isr_us_avg\": %.3f",
+         isr->runs ? (double)isr->total_cycles / isr->runs : 0.0,
+         (unsigned long long)isr->max_cycles, isr->runs ? isr->total_us / isr->runs : 0.0);
+  printf(", \"loop_us_avg\": %.3f, \"host_s\": %.2f}\n",
+         lp->runs ? lp->total_us / lp->runs : 0.0, host_s);
+}
+
+static void usage() {
+  fprintf(stderr,
+          "usage: bench [-s scenario] [-k kp ki kd] [-r revision] [-l]\n"
+          "  -s  run only this scenario (default: all of them)\n"
+          "  -k  use these PID tunings instead of the default settings\n"
+          "  -r  add a \"revision\" to the results, e.g. $(git describe)\n"
+          "  -l  list the scenarios\n");
+  exit(2);
+}
+
+int main(int argc, char **argv) {
+  const char *only = NULL, *revision = NULL;
+  float tunings[3];
+  bool have_tunings = false;
+
+  for (int i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], "-s") && i + 1 < argc) {
+      only = argv[++i];
+    } else if (!strcmp(argv[i], "-k") && i + 3 < argc) {
+      for (int k = 0; k < 3; k++)
+        tunings[k] = atof(argv[++i]);
+      have_tunings = true;
+    } else if (!strcmp(argv[i], "-r") && i + 1 < argc) {
+      revision = argv[++i];
+    } else if (!strcmp(argv[i], "-l")) {
+      for (size_t n = 0; n < BENCH_SCENARIO_COUNT; n++)
+        printf("%s\n", SCENARIOS[n].name);
+      return 0;
+    } else {
+      usage();
+    }
+  }
+
+  int failed = 0, ran = 0;
+  for (size_t n = 0; n < BENCH_SCENARIO_COUNT; n++) {
+    if (only && strcmp(only, SCENARIOS[n].name))
+      continue;
+    ran++;
+
+    /* A fresh firmware for every scenario */
+    fflush(stdout);
+    pid_t pid = fork();
+    if (pid == 0) {
+      scenario = &SCENARIOS[n];
+      runScenario(have_tunings ? tunings : NULL, revision);
+      fflush(stdout);
+      _exit(0);
+    }
+    int status;
+    if (pid < 0 || waitpid(pid, &status, 0) < 0 || !WIFEXITED(status) || WEXITSTATUS(status)) {
+      fprintf(stderr, "bench: %s failed\n", SCENARIOS[n].name);
+      failed++;
+    }
+  }
+
+  if (!ran) {
+    fprintf(stderr, "bench: no scenario %s\n", only);
+    return 2;
+  }
+  return failed ? 1 : 0;
+}
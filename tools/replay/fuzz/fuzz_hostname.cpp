@@ -0,0 +1,26 @@
+/* get_hostname_from_http_request() on its own. The hostname is on the
+ * heap with its exact size, so that the sanitizer sees any byte written
+ * past it, and it has to be terminated. */
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "common.h"
+#include "network.h"
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size) {
+  char *request = (char *)malloc(size + 1);
+  char *hostname = (char *)malloc(HOSTNAME_MAX_SIZE);
+
+  memcpy(request, data, size);
+  request[size] = '\0';
+  memset(hostname, 'x', HOSTNAME_MAX_SIZE);
+
+  get_hostname_from_http_request(request, hostname, HOSTNAME_MAX_SIZE);
+  assert(memchr(hostname, '\0', HOSTNAME_MAX_SIZE) != NULL);
+
+  free(hostname);
+  free(request);
+  return 0;
+}
@@ -0,0 +1,9 @@
+/* Any payload of a TCP segment to the HTTP server of the firmware */
+
+#include "http.h"
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size) {
+  httpBoot();
+  httpRequest(data, size);
+  return 0;
+}
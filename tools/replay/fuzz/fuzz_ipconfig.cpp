@@ -0,0 +1,22 @@
+/* The form of POST /ipconfig. The input is the rest of the request
+ * after the request line: the headers and the body. */
+
+#include <string.h>
+
+#include "http.h"
+
+#define REQUEST_LINE "POST /ipconfig HTTP/1.1\r\n"
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size) {
+  static uint8_t request[HTTP_MAX_PAYLOAD];
+  size_t len = strlen(REQUEST_LINE);
+
+  if (size > sizeof(request) - len)
+    size = sizeof(request) - len;
+  memcpy(request, REQUEST_LINE, len);
+  memcpy(request + len, data, size);
+
+  httpBoot();
+  httpRequest(request, len + size);
+  return 0;
+}
@@ -0,0 +1,175 @@
+/* A stand-in for libFuzzer, for compilers without it (FUZZ_ENGINE=main
+ * in the Makefile). It runs the target on the files and the directories
+ * given on the command line, and then on -runs=N random mutations of
+ * them. Without coverage feedback it finds much less than libFuzzer,
+ * but it runs the corpus and catches what the sanitizers see in it.
+ * The input that fails is written to crash-input.
+ *
+ *   fuzz_http [-runs=N] [-seed=S] fuzz/seeds crash-input
+ */
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <sanitizer/common_interface_defs.h>
+
+#include <string>
+#include <vector>
+
+#define FUZZ_MAX_LEN 2048
+#define FUZZ_MAX_MUTATIONS 8
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size);
+
+typedef std::vector<uint8_t> input;
+
+/* What the mutations insert, besides random bytes */
+static const char *const TOKENS[] = {
+  "GET /", "POST /ipconfig ", "POST /presets ", "POST /program ", "POST /settings ",
+  " HTTP/1.1", "\r\n", "\r\n\r\n", "Host: ", "=", "&", "%", "%2", "+",
+  "ip", "gw", "dns", "subnet", "dhcp", "op", "save", "temp", "name",
+  "255.255.255.0", "192.168.1.1", "t0", "kp",
+};
+#define FUZZ_TOKEN_COUNT (sizeof(TOKENS) / sizeof(TOKENS[0]))
+
+static const input *current = NULL;
+
+/* From the death callback of the sanitizers, or a signal */
+static void saveCurrent() {
+  static bool saved = false;
+  if (!current || saved)
+    return;
+  saved = true;
+
+  int fd = open("crash-input", O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (fd >= 0) {
+    if (write(fd, current->data(), current->size()) >= 0)
+      write(STDERR_FILENO, "fuzz: the input is in crash-input\n", 35);
+    close(fd);
+  }
+}
+
+static void onSignal(int sig) {
+  saveCurrent();
+  signal(sig, SIG_DFL);
+  raise(sig);
+}
+
+static void run(const input &in) {
+  current = &in;
+  LLVMFuzzerTestOneInput(in.data(), in.size());
+  current = NULL;
+}
+
+static bool readFile(const std::string &path, input *in) {
+  FILE *f = fopen(path.c_str(), "rb");
+  if (!f)
+    return false;
+  int c;
+  in->clear();
+  while ((c = fgetc(f)) != EOF && in->size() < FUZZ_MAX_LEN)
+    in->push_back(c);
+  fclose(f);
+  return true;
+}
+
+static void addInputs(const std::string &path, std::vector<input> *corpus) {
+  struct stat st;
+  if (stat(path.c_str(), &st) != 0) {
+    fprintf(stderr, "fuzz: can't read %s\n", path.c_str());
+    exit(2);
+  }
+  if (!S_ISDIR(st.st_mode)) {
+    input in;
+    if (readFile(path, &in))
+      corpus->push_back(in);
+    return;
+  }
+
+  DIR *dir = opendir(path.c_str());
+  struct dirent *entry;
+  while (dir && (entry = readdir(dir)) != NULL) {
+    if (entry->d_name[0] != '.')
+      addInputs(path + "/" + entry->d_name, corpus);
+  }
+  if (dir)
+    closedir(dir);
+}
+
+static void mutate(input *in) {
+  int mutations = 1 + rand() % FUZZ_MAX_MUTATIONS;
+
+  for (int m = 0; m < mutations; m++) {
+    size_t pos = in->empty() ? 0 : rand() % (in->size() + 1);
+    switch (rand() % 5) {
+      case 0:   // Flip a byte
+        if (pos < in->size())
+          (*in)[pos] ^= 1 << (rand() % 8);
+        break;
+      case 1:   // A random byte
+        in->insert(in->begin() + pos, rand() % 256);
+        break;
+      case 2: { // Erase a run
+        size_t n = 1 + rand() % 16;
+        if (pos + n <= in->size())
+          in->erase(in->begin() + pos, in->begin() + pos + n);
+        break;
+      }
+      case 3: { // A token
+        const char *t = TOKENS[rand() % FUZZ_TOKEN_COUNT];
+        in->insert(in->begin() + pos, t, t + strlen(t));
+        break;
+      }
+      case 4: { // Repeat a run, for the long names and values
+        size_t n = 1 + rand() % 64;
+        if (pos + n <= in->size()) {
+          input run(in->begin() + pos, in->begin() + pos + n);
+          in->insert(in->begin() + pos, run.begin(), run.end());
+        }
+        break;
+      }
+    }
+  }
+  if (in->size() > FUZZ_MAX_LEN)
+    in->resize(FUZZ_MAX_LEN);
+}
+
+int main(int argc, char **argv) {
+  std::vector<input> corpus;
+  unsigned long runs = 0;
+  unsigned int seed = 1;
+
+  for (int i = 1; i < argc; i++) {
+    if (!strncmp(argv[i], "-runs=", 6))
+      runs = strtoul(argv[i] + 6, NULL, 10);
+    else if (!strncmp(argv[i], "-seed=", 6))
+      seed = strtoul(argv[i] + 6, NULL, 10);
+    else if (argv[i][0] == '-')
+      fprintf(stderr, "fuzz: ignoring %s\n", argv[i]);
+    else
+      addInputs(argv[i], &corpus);
+  }
+
+  __sanitizer_set_death_callback(saveCurrent);
+  signal(SIGABRT, onSignal);
+  signal(SIGSEGV, onSignal);
+
+  for (size_t n = 0; n < corpus.size(); n++)
+    run(corpus[n]);
+  printf("fuzz: %zu inputs ran\n", corpus.size());
+
+  srand(seed);
+  for (unsigned long r = 0; r < runs; r++) {
+    input in = corpus.empty() ? input() : corpus[rand() % corpus.size()];
+    mutate(&in);
+    run(in);
+  }
+  if (runs)
+    printf("fuzz: %lu mutations ran (seed %u)\n", runs, seed);
+  return 0;
+}
@@ -0,0 +1,21 @@
+/* subnet_mask_valid() against the definition: the ones of the mask,
+ * counted from the MSB, are followed by zeros only. */
+
+#include <assert.h>
+
+#include "common.h"
+#include "network.h"
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size) {
+  if (size < 4)
+    return 0;
+
+  byte mask[4] = {data[0], data[1], data[2], data[3]};
+  uint32_t m = (uint32_t)mask[0] << 24 | (uint32_t)mask[1] << 16 |
+               (uint32_t)mask[2] << 8 | mask[3];
+  uint32_t zeros = ~m;
+
+  /* The zeros are one block at the LSB: zeros + 1 is a power of two */
+  assert(subnet_mask_valid(mask) == ((zeros & (zeros + 1)) == 0));
+  return 0;
+}
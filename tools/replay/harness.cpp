@@ -0,0 +1,112 @@
+#include <time.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define HARNESS_CYCLES() __rdtsc()
+#else
+#define HARNESS_CYCLES() 0
+#endif
+
+#include "harness.h"
+#include "replay.h"
+
+#include "common.h"
+#include "settings.h"
+
+/* The firmware (src/main.cpp) */
+void setup();
+void loop();
+extern "C" void TIMER1_OVF_vect(void);
+
+host_timing harnessLoopTiming;
+host_timing harnessIsrTiming;
+
+static unsigned long now_us = 0;
+static bool booting = true;
+static bool isrArmed = false;
+static unsigned long lastIsr_us = 0;
+
+double harnessHostMicros() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+uint64_t harnessHostCycles() {
+  return HARNESS_CYCLES();
+}
+
+static void timed(OUT host_timing *timing,
+                  IN void (*f)()) {
+  double start = harnessHostMicros();
+  uint64_t start_cycles = HARNESS_CYCLES();
+  f();
+  uint64_t cycles = HARNESS_CYCLES() - start_cycles;
+  double us = harnessHostMicros() - start;
+
+  timing->runs++;
+  timing->total_us += us;
+  timing->total_cycles += cycles;
+  if (us > timing->max_us)
+    timing->max_us = us;
+  if (cycles > timing->max_cycles)
+    timing->max_cycles = cycles;
+}
+
+unsigned long replayMicros() {
+  if (booting)
+    now_us += HARNESS_BOOT_STEP_US;
+  return now_us;
+}
+
+void replayAdvance(unsigned long us) {
+  unsigned long end = now_us + us;
+
+  if (!isrArmed && (TIMSK1 & (1 << TOIE1)) && (SREG & 0x80)) {
+    isrArmed = true;
+    lastIsr_us = now_us;
+  }
+  while (isrArmed && lastIsr_us + HARNESS_ISR_PERIOD_US <= end) {
+    lastIsr_us += HARNESS_ISR_PERIOD_US;
+    now_us = lastIsr_us;
+    harnessBeforeIsr();
+    timed(&harnessIsrTiming, TIMER1_OVF_vect);
+  }
+  now_us = end;
+}
+
+void harnessStoreSettings() {
+  while (settingsPending())
+    settingsTask();
+}
+
+void harnessBoot(uint8_t buttons) {
+  harnessSetButtons(buttons);
+  setup();
+  booting = false;
+}
+
+void harnessLoop(unsigned long period_us) {
+  replayAdvance(period_us);
+  timed(&harnessLoopTiming, loop);
+}
+
+static void setPin(IN uint8_t pin,
+                   IN bool high) {
+  if (high)
+    replaySfr[avrPinInputReg(pin)] |= avrPinBit(pin);
+  else
+    replaySfr[avrPinInputReg(pin)] &= ~avrPinBit(pin);
+}
+
+void harnessSetButtons(uint8_t buttons) {
+  /* The buttons pull their pin low, the float switch pulls it high */
+  setPin(PUSH_BTN_MENU_BACK_PIN, !(buttons & BTN_BACK));
+  setPin(PUSH_BTN_MENU_OK_PIN, !(buttons & BTN_OK));
+  setPin(PUSH_BTN_MENU_DOWN_PIN, !(buttons & BTN_DOWN));
+  setPin(PUSH_BTN_MENU_UP_PIN, !(buttons & BTN_UP));
+  setPin(FLOAT_SWITCH_PIN, buttons & BTN_FLOAT_SW);
+}
+
+unsigned long harnessMillis() {
+  return now_us / 1000;
+}
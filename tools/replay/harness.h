@@ -0,0 +1,75 @@
+#ifndef harness_h
+#define harness_h
+
+#include <stdint.h>
+
+/* What the runners (replay.cpp and bench.cpp) share: the virtual clock
+ * that drives setup(), loop() and the Timer1 ISR of the firmware, the
+ * buttons, and the timing of the firmware on the host. */
+
+#define HARNESS_ISR_PERIOD_US 10000   // Timer1 overflows every 10ms
+#define HARNESS_BOOT_STEP_US 100      // What every micros()/millis() takes while booting
+
+typedef struct _host_timing {
+  unsigned long runs;
+  double total_us, max_us;
+  uint64_t total_cycles, max_cycles; // TSC cycles, zero where there is no TSC
+} host_timing;
+
+extern host_timing harnessLoopTiming;
+extern host_timing harnessIsrTiming;
+
+/***f* harnessBeforeIsr
+ *
+ * Implemented by the runner. Called before every run of the ISR, with
+ * the virtual time already at the tick.
+ */
+void harnessBeforeIsr();
+
+/***f* harnessStoreSettings
+ *
+ * Writes the settings that have been changed with the settingsSet*()
+ * functions to the EEPROM, so that setup() loads them. Call before
+ * harnessBoot(), after settingsInit().
+ */
+void harnessStoreSettings();
+
+/***f* harnessBoot
+ *
+ * Runs setup() with the buttons released and the float switch in
+ * 'buttons'. The virtual time moves on every call of millis() meanwhile.
+ */
+void harnessBoot(uint8_t buttons);
+
+/***f* harnessLoop
+ *
+ * Moves the virtual time by 'period_us', running the ISR when it is
+ * due, and then runs loop() once.
+ */
+void harnessLoop(unsigned long period_us);
+
+/***f* harnessSetButtons
+ *
+ * Drives the pins so that readButtons() returns 'buttons'.
+ */
+void harnessSetButtons(uint8_t buttons);
+
+/***f* harnessMillis
+ *
+ * Returns the virtual time without moving it.
+ */
+unsigned long harnessMillis();
+
+/***f* harnessHostMicros
+ *
+ * Returns the monotonic time of the host.
+ */
+double harnessHostMicros();
+
+/***f* harnessHostCycles
+ *
+ * Returns the TSC of the host, or zero where there is none.
+ */
+uint64_t harnessHostCycles();
+
+#endif
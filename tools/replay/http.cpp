@@ -0,0 +1,113 @@
+/* The runner side of the HTTP targets: the requests go straight to
+ * processEthernetPacket(), the temperatures are constant, and there is
+ * no second packet for the POST requests whose body is missing. */
+
+#include "http.h"
+#include "harness.h"
+#include "replay.h"
+
+#include "common.h"
+#include "network.h"
+#include "trace.h"
+
+#define HTTP_TEMPERATURE_C 56.0
+
+static uint32_t seq = 0;
+static size_t replyBytes = 0;
+static size_t largestSegment = 0;
+
+void httpBoot() {
+  static bool booted = false;
+
+  if (booted)
+    return;
+  booted = true;
+  harnessBoot(BTN_FLOAT_SW);
+}
+
+size_t httpRequest(const uint8_t *payload, size_t len) {
+  uint8_t *frame = Ethernet::buffer;
+
+  if (len > HTTP_MAX_PAYLOAD)
+    len = HTTP_MAX_PAYLOAD;
+  seq++;
+  memset(frame, 0, TCP_DATA_P);
+  frame[IP_SRC_P] = 192;
+  frame[IP_SRC_P + 1] = 168;
+  frame[IP_SRC_P + 2] = 1;
+  frame[IP_SRC_P + 3] = 2;
+  frame[TCP_SEQ_H_P] = seq >> 24;
+  frame[TCP_SEQ_H_P + 1] = seq >> 16;
+  frame[TCP_SEQ_H_P + 2] = seq >> 8;
+  frame[TCP_SEQ_H_P + 3] = seq;
+  memcpy(frame + TCP_DATA_P, payload, len);
+  /* As receiveFrame() in network.cpp */
+  frame[TCP_DATA_P + len] = '\0';
+
+  replyBytes = 0;
+  largestSegment = 0;
+  processEthernetPacket(TCP_DATA_P);
+  return replyBytes;
+}
+
+size_t httpLargestSegment() {
+  return largestSegment;
+}
+
+void harnessBeforeIsr() {
+}
+
+float replaySensorValue(uint8_t sensor) {
+  return HTTP_TEMPERATURE_C;
+}
+
+uint16_t replayPacket(uint8_t *frame) {
+  return 0;
+}
+
+void replayReply(uint16_t len) {
+  replyBytes += len;
+  if (len > largestSegment)
+    largestSegment = len;
+}
+
+void replaySerialWrite(uint8_t c) {
+}
+
+/* ---- trace.h: nothing is recorded ---- */
+
+void traceStart() {
+}
+
+void traceSensors(IN const float *temperatures,
+                  IN uint8_t count) {
+}
+
+void traceTick(IN uint8_t buttons,
+               IN uint8_t heater_output) {
+}
+
+void tracePacket(IN const uint8_t *frame,
+                 IN uint16_t pos) {
+}
+
+void traceTask(IN uint8_t op_state,
+               IN float setpoint) {
+}
+
+void traceStream() {
+}
+
+bool traceStreaming() {
+  return false;
+}
+
+uint16_t tracePrint(OUT Print &out,
+                    IN uint16_t offset,
+                    IN uint16_t max_size) {
+  return 0;
+}
+
+uint16_t traceSize() {
+  return 0;
+}
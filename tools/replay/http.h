@@ -0,0 +1,42 @@
+#ifndef http_h
+#define http_h
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "net.h"
+
+/* The HTTP server of the firmware without the network: the requests are
+ * put in Ethernet::buffer as the payload of a TCP segment and handed to
+ * processEthernetPacket() directly. For the fuzz targets (fuzz/) and the
+ * microbenchmark of the routes (httpbench.cpp). The server on a TAP
+ * device (server.cpp) shares the rest of the runner, but its frames
+ * come from the network. */
+
+#define HTTP_MAX_PAYLOAD 1500    // What fits in one Ethernet frame, as on the wire
+/* The largest TCP segment of a reply that fits in a frame of the
+ * ENC28J60, after the headers and the CRC */
+#define HTTP_SEGMENT_MAX (MAX_FRAMELEN - TCP_DATA_P - 4)
+
+/***f* httpBoot
+ *
+ * Runs setup() of the firmware once. Every other call does nothing.
+ */
+void httpBoot();
+
+/***f* httpRequest
+ *
+ * Serves the request 'payload' of 'len' bytes, truncated to
+ * HTTP_MAX_PAYLOAD, as a new TCP segment, so that it is never taken for
+ * a duplicate. Returns the number of bytes of the reply.
+ */
+size_t httpRequest(const uint8_t *payload, size_t len);
+
+/***f* httpLargestSegment
+ *
+ * Returns the size of the largest TCP segment of the reply to the last
+ * request.
+ */
+size_t httpLargestSegment();
+
+#endif
@@ -0,0 +1,181 @@
+/* Microbenchmark of the HTTP routes of the firmware, built for the host.
+ * Every route is served with a browser-like request, 'iterations' times
+ * in a row, and reported as one JSON object per line:
+ *
+ *   requests_s     requests per second on this host
+ *   us_avg         the time per request
+ *   cycles_avg     host TSC cycles per request
+ *   reply_bytes    the size of the reply
+ *   segment_max    its largest TCP segment, and with a Host header of
+ *                  the longest hostname that the firmware keeps
+ *
+ * The numbers are host numbers, for comparing two revisions of the
+ * parsers on the same machine. The time on the AVR is in the profiler
+ * of the device (PROFILE_ETH_PROCESS in GET /profile).
+ *
+ * A reply with a segment larger than HTTP_SEGMENT_MAX doesn't fit in a
+ * frame of the ENC28J60. httpbench reports it and exits with 1, so
+ * "make check" fails.
+ *
+ *   httpbench [-n iterations] [-s route] [-r revision] [-l]
+ */
+
+#include "http.h"
+#include "harness.h"
+
+#include "common.h"
+#include "network.h"
+
+#define HTTPBENCH_ITERATIONS 20000
+
+/* What a browser sends besides the request line */
+#define HTTPBENCH_HOST "sousvide.local"
+#define HTTPBENCH_HEADERS \
+  "Host: " HTTPBENCH_HOST "\r\n" \
+  "User-Agent: Mozilla/5.0 (X11; Linux x86_64; rv:128.0) Gecko/20100101 Firefox/128.0\r\n" \
+  "Accept: text/html,application/xhtml+xml,application/xml;q=0.9,*/*;q=0.8\r\n" \
+  "Accept-Language: en-US,en;q=0.5\r\n" \
+  "Accept-Encoding: gzip, deflate\r\n" \
+  "Connection: keep-alive\r\n"
+
+#define HTTPBENCH_GET(path) \
+  "GET " path " HTTP/1.1\r\n" HTTPBENCH_HEADERS "\r\n"
+
+#define HTTPBENCH_POST(path, body) \
+  "POST " path " HTTP/1.1\r\n" HTTPBENCH_HEADERS \
+  "Content-Type: application/x-www-form-urlencoded\r\n\r\n" body
+
+typedef struct _httpbench_route {
+  const char *name;
+  const char *request;
+} httpbench_route;
+
+/* The POST requests don't change the state of the firmware from one
+ * iteration to the next: the same settings and program, a preset with
+ * an invalid temperature, an IP configuration with an invalid mask. */
+static const httpbench_route ROUTES[] = {
+  {"main",          HTTPBENCH_GET("/")},
+  {"temp",          HTTPBENCH_GET("/temp")},
+  {"ipconfig",      HTTPBENCH_GET("/ipconfig")},
+  {"metrics",       HTTPBENCH_GET("/metrics")},
+  {"presets",       HTTPBENCH_GET("/presets")},
+  {"program",       HTTPBENCH_GET("/program")},
+  {"settings",      HTTPBENCH_GET("/settings")},
+  {"profile",       HTTPBENCH_GET("/profile")},
+  {"not_found",     HTTPBENCH_GET("/favicon.ico")},
+  {"ipconfig_post", HTTPBENCH_POST("/ipconfig",
+                                   "ip=192.168.1.50&gw=192.168.1.1&dns=192.168.1.1&subnet=255.0.255.0")},
+  {"presets_post",  HTTPBENCH_POST("/presets",
+                                   "op=save&i=0&name=Steak+medium&temp=5x6&dur=120&pid=0")},
+  {"program_post",  HTTPBENCH_POST("/program",
+                                   "op=save&t0=56.5&r0=&h0=60&e0=0&t1=60&r1=1.0&h1=30&e1=1&t2=")},
+  {"settings_post", HTTPBENCH_POST("/settings",
+                                   "backlight=60&menu=10&resume=1.0&kp=850&ki=0.5&kd=0.1")},
+  {"unauthorized",  "PUT / HTTP/1.1\r\n" HTTPBENCH_HEADERS "\r\n"},
+};
+#define HTTPBENCH_ROUTE_COUNT (sizeof(ROUTES) / sizeof(ROUTES[0]))
+
+/***f* largestSegmentLongHost
+ *
+ * Returns the largest TCP segment of the reply to 'request' with the
+ * hostname replaced by one of HOSTNAME_MAX_SIZE - 1 characters, which
+ * the pages repeat in their links.
+ */
+static size_t largestSegmentLongHost(IN const char *request) {
+  char long_request[HTTP_MAX_PAYLOAD + 1];
+  char host[HOSTNAME_MAX_SIZE];
+  const char *at = strstr(request, HTTPBENCH_HOST);
+
+  memset(host, 'h', sizeof(host) - 1);
+  host[sizeof(host) - 1] = '\0';
+  int len = snprintf(long_request, sizeof(long_request), "%.*s%s%s",
+                     (int)(at - request), request, host, at + strlen(HTTPBENCH_HOST));
+  httpRequest((const uint8_t *)long_request, len);
+  return httpLargestSegment();
+}
+
+/* Returns false if a segment of the reply is larger than HTTP_SEGMENT_MAX */
+static bool runRoute(IN const httpbench_route *route,
+                     IN unsigned long iterations,
+                     IN const char *revision) {
+  const uint8_t *request = (const uint8_t *)route->request;
+  size_t len = strlen(route->request);
+
+  size_t segment_long_host = largestSegmentLongHost(route->request);
+  /* Warm the caches up */
+  size_t reply = httpRequest(request, len);
+  size_t segment = httpLargestSegment();
+
+  double start = harnessHostMicros();
+  uint64_t start_cycles = harnessHostCycles();
+  for (unsigned long i = 0; i < iterations; i++)
+    httpRequest(request, len);
+  uint64_t cycles = harnessHostCycles() - start_cycles;
+  double us = harnessHostMicros() - start;
+
+  printf("{\"route\": \"%s\"", route->name);
+  if (revision)
+    printf(", \"revision\": \"%s\"", revision);
+  printf(", \"request_bytes\": %zu, \"reply_bytes\": %zu", len, reply);
+  printf(", \"segment_max\": %zu, \"segment_max_long_host\": %zu",
+         segment, segment_long_host);
+  printf(", \"requests_s\": %.0f, \"us_avg\": %.3f, \"cycles_avg\": %.0f}\n",
+         iterations / (us / 1e6), us / iterations, (double)cycles / iterations);
+
+  if (segment > HTTP_SEGMENT_MAX || segment_long_host > HTTP_SEGMENT_MAX) {
+    fprintf(stderr, "httpbench: %s sends a segment of %zu bytes, more than %d\n",
+            route->name, segment > segment_long_host ? segment : segment_long_host,
+            HTTP_SEGMENT_MAX);
+    return false;
+  }
+  return true;
+}
+
+static void usage() {
+  fprintf(stderr,
+          "usage: httpbench [-n iterations] [-s route] [-r revision] [-l]\n"
+          "  -n  requests per route (default: %d)\n"
+          "  -s  run only this route (default: all of them)\n"
+          "  -r  add a \"revision\" to the results, e.g. $(git describe)\n"
+          "  -l  list the routes\n", HTTPBENCH_ITERATIONS);
+  exit(2);
+}
+
+int main(int argc, char **argv) {
+  const char *only = NULL, *revision = NULL;
+  unsigned long iterations = HTTPBENCH_ITERATIONS;
+
+  for (int i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], "-n") && i + 1 < argc) {
+      iterations = strtoul(argv[++i], NULL, 10);
+      if (iterations == 0)
+        usage();
+    } else if (!strcmp(argv[i], "-s") && i + 1 < argc) {
+      only = argv[++i];
+    } else if (!strcmp(argv[i], "-r") && i + 1 < argc) {
+      revision = argv[++i];
+    } else if (!strcmp(argv[i], "-l")) {
+      for (size_t n = 0; n < HTTPBENCH_ROUTE_COUNT; n++)
+        printf("%s\n", ROUTES[n].name);
+      return 0;
+    } else {
+      usage();
+    }
+  }
+
+  httpBoot();
+
+  bool ran = false, fits = true;
+  for (size_t n = 0; n < HTTPBENCH_ROUTE_COUNT; n++) {
+    if (only && strcmp(only, ROUTES[n].name))
+      continue;
+    if (!runRoute(&ROUTES[n], iterations, revision))
+      fits = false;
+    ran = true;
+  }
+  if (!ran) {
+    fprintf(stderr, "httpbench: no route %s\n", only);
+    return 2;
+  }
+  return fits ? 0 : 1;
+}
@@ -0,0 +1,189 @@
+#!/usr/bin/env python3
+"""Load test of the web server of the Sous Vide firmware.
+
+Runs concurrent clients against the server on a TAP device (server.cpp)
+or against the device itself, one request per connection as browsers
+do with the firmware, and reports the latency percentiles and the
+errors of every path and of all of them. It exits with 1 if a request
+failed: a reply with a frame that the ENC28J60 can't send (see the
+"too long" frames of server.cpp) never completes, and times out.
+
+    tools/replay/loadtest.py -c 8 -n 2000 http://192.168.1.100
+    tools/replay/loadtest.py -c 4 -d 30 -p /temp,/metrics http://192.168.1.100
+    tools/replay/loadtest.py --json ... > load.json
+"""
+
+import argparse
+import json
+import socket
+import sys
+import threading
+import time
+import urllib.parse
+
+PATHS = ['/', '/temp', '/ipconfig', '/metrics', '/presets', '/program', '/settings', '/profile']
+PERCENTILES = [50, 90, 99, 99.9]
+
+
+class Results:
+    """The latencies of the successful requests and the errors, by path."""
+
+    def __init__(self):
+        self.lock = threading.Lock()
+        self.latencies = {}
+        self.errors = {}
+
+    def add(self, path, latency, error):
+        with self.lock:
+            if error is None:
+                self.latencies.setdefault(path, []).append(latency)
+            else:
+                by_kind = self.errors.setdefault(path, {})
+                by_kind[error] = by_kind.get(error, 0) + 1
+
+
+def request(host, port, path, timeout):
+    """Returns the error of one GET request, or None. The firmware closes
+    the connection after the reply."""
+    try:
+        with socket.create_connection((host, port), timeout=timeout) as s:
+            s.sendall(('GET %s HTTP/1.1\r\nHost: %s\r\nUser-Agent: loadtest\r\n'
+                       'Connection: close\r\n\r\n' % (path, host)).encode())
+            reply = bytearray()
+            while True:
+                chunk = s.recv(4096)
+                if not chunk:
+                    break
+                reply += chunk
+    except socket.timeout:
+        return 'timeout'
+    except ConnectionRefusedError:
+        return 'refused'
+    except ConnectionResetError:
+        return 'reset'
+    except OSError as e:
+        return 'os error %d' % e.errno if e.errno else 'os error'
+
+    status = bytes(reply[:reply.find(b'\r\n')]).split()
+    if len(status) < 2 or not status[0].startswith(b'HTTP/'):
+        return 'bad reply' if reply else 'empty reply'
+    if not status[1].startswith(b'2'):
+        return 'status ' + status[1].decode(errors='replace')
+    if b'\r\n\r\n' not in reply:
+        return 'truncated reply'
+    return None
+
+
+def client(host, port, paths, timeout, next_request, results):
+    while True:
+        n = next_request()
+        if n is None:
+            return
+        path = paths[n % len(paths)]
+        start = time.monotonic()
+        error = request(host, port, path, timeout)
+        results.add(path, time.monotonic() - start, error)
+
+
+def percentile(sorted_values, p):
+    if not sorted_values:
+        return None
+    k = min(len(sorted_values) - 1, int(round(p / 100.0 * (len(sorted_values) - 1))))
+    return sorted_values[k]
+
+
+def summary(latencies, errors):
+    ok = len(latencies)
+    failed = sum(errors.values())
+    values = sorted(latencies)
+    s = {
+        'requests': ok + failed,
+        'errors': failed,
+        'error_rate': failed / (ok + failed) if ok + failed else 0.0,
+        'error_kinds': dict(errors),
+    }
+    for p in PERCENTILES:
+        v = percentile(values, p)
+        s['p%g_ms' % p] = None if v is None else v * 1000
+    s['max_ms'] = values[-1] * 1000 if values else None
+    return s
+
+
+def format_ms(v):
+    return '%9.2f' % v if v is not None else '        -'
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__,
+                                     formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument('url', help='the server, e.g. http://192.168.1.100')
+    parser.add_argument('-c', '--clients', type=int, default=4,
+                        help='concurrent clients (default: 4)')
+    parser.add_argument('-n', '--requests', type=int,
+                        help='requests in total (default: 1000, unless -d is given)')
+    parser.add_argument('-d', '--duration', type=float,
+                        help='run for this many seconds instead')
+    parser.add_argument('-p', '--paths', default=','.join(PATHS),
+                        help='the paths to request in turn, comma-separated (default: %(default)s)')
+    parser.add_argument('-t', '--timeout', type=float, default=5.0,
+                        help='seconds before a request fails (default: %(default)s)')
+    parser.add_argument('--json', action='store_true',
+                        help='print the results as JSON')
+    args = parser.parse_args()
+
+    url = urllib.parse.urlsplit(args.url if '//' in args.url else '//' + args.url)
+    host, port = url.hostname, url.port or 80
+    paths = [p if p.startswith('/') else '/' + p for p in args.paths.split(',') if p]
+    total = args.requests if args.requests is not None else (None if args.duration else 1000)
+    deadline = time.monotonic() + args.duration if args.duration else None
+
+    lock = threading.Lock()
+    issued = [0]
+
+    def next_request():
+        with lock:
+            if total is not None and issued[0] >= total:
+                return None
+            if deadline is not None and time.monotonic() >= deadline:
+                return None
+            issued[0] += 1
+            return issued[0] - 1
+
+    results = Results()
+    threads = [threading.Thread(target=client,
+                                args=(host, port, paths, args.timeout, next_request, results))
+               for _ in range(args.clients)]
+    start = time.monotonic()
+    for t in threads:
+        t.start()
+    for t in threads:
+        t.join()
+    elapsed = time.monotonic() - start
+
+    by_path = {p: summary(results.latencies.get(p, []), results.errors.get(p, {})) for p in paths}
+    everything = summary([v for l in results.latencies.values() for v in l],
+                         {k: sum(e.get(k, 0) for e in results.errors.values())
+                          for k in set(k for e in results.errors.values() for k in e)})
+    everything['requests_s'] = everything['requests'] / elapsed if elapsed else 0.0
+
+    if args.json:
+        json.dump({'url': args.url, 'clients': args.clients, 'seconds': elapsed,
+                   'total': everything, 'paths': by_path}, sys.stdout, indent=2)
+        print()
+    else:
+        header = '%-12s %8s %7s ' % ('path', 'requests', 'errors') + \
+                 ' '.join('%9s' % ('p%g ms' % p) for p in PERCENTILES) + ' %9s' % 'max ms'
+        print(header)
+        for name, s in list(by_path.items()) + [('all', everything)]:
+            print('%-12s %8d %6.2f%% ' % (name, s['requests'], s['error_rate'] * 100) +
+                  ' '.join(format_ms(s['p%g_ms' % p]) for p in PERCENTILES) +
+                  ' ' + format_ms(s['max_ms']))
+        print('%d clients, %.1f s, %.1f requests/s' % (args.clients, elapsed, everything['requests_s']))
+        for kind, count in sorted(everything['error_kinds'].items()):
+            print('  %s: %d' % (kind, count))
+
+    return 1 if everything['errors'] else 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -0,0 +1,462 @@
+/* Replays a trace that the firmware recorded (see lib/myincludes/trace.h)
+ * through setup(), loop() and the Timer1 ISR of the firmware, built for
+ * the host. The recorded temperatures, buttons and HTTP requests are fed
+ * back at the recorded times on a virtual clock, and every output record
+ * is compared with what the replayed firmware does at the same point.
+ *
+ *   replay [-t tolerance] [-s serial.bin] [-v] trace.bin
+ *
+ * The exit status is 0 if the firmware did the same as in the trace,
+ * 1 if it diverged, and 2 if the trace can't be read. See the Makefile
+ * for building it.
+ */
+
+#include <vector>
+#include <deque>
+#include <time.h>
+
+#include "replay.h"
+#include "harness.h"
+
+#include "common.h"
+#include "settings.h"
+#include "temperature.h"
+#include "trace.h"
+#include "EtherCard.h"
+
+#define REPLAY_LOOP_PERIOD_US 1000   // loop() runs once per virtual millisecond
+#define REPLAY_TAIL_MS 2000          // How long to run after the last record
+#define REPLAY_HEATER_TOLERANCE 4    // in 1/255. The AVR double is a float.
+#define REPLAY_MAX_REPORTED 20       // Divergences that are printed one by one
+
+typedef struct _trace_header {
+  uint8_t version, num_sensors;
+  uint32_t millis;
+  int16_t desired_temperature;
+  float kp, ki, kd;
+  uint32_t lcd_backlight_timeout;
+  uint16_t menu_return_timeout;
+  uint8_t resume_window;
+} trace_header;
+
+typedef struct _recorded_packet {
+  unsigned long at;
+  uint8_t seq[4], ip[4];
+  std::vector<uint8_t> payload;
+} recorded_packet;
+
+typedef struct _recorded_buttons {
+  unsigned long at;
+  uint8_t buttons;
+} recorded_buttons;
+
+typedef struct _recorded_output {
+  unsigned long at;
+  uint8_t heater, op_state;
+  int16_t setpoint;
+} recorded_output;
+
+/* The trace */
+static trace_header header;
+static std::deque<std::vector<int16_t> > sensorReadings;
+static std::deque<recorded_buttons> buttonChanges;
+static std::deque<recorded_packet> packets;
+static std::vector<recorded_output> outputs;
+static unsigned long traceEnd = 0;
+static bool traceTruncated = false;
+static size_t traceBytes = 0;
+
+/* The recorded time on the virtual clock */
+static bool started = false;   // traceStart() has been called
+static long offset_ms = 0;     // Replayed time - recorded time
+
+/* The replay */
+static unsigned heaterTolerance = REPLAY_HEATER_TOLERANCE;
+static bool verbose = false;
+static FILE *serialOut = NULL;
+static std::vector<int16_t> lastReading;
+static unsigned long extraSensorReads = 0;
+static unsigned long sensorReadingsFed = 0, buttonChangesFed = 0, packetsFed = 0;
+static unsigned long replies = 0, replyBytes = 0;
+static uint8_t heaterOutput = 0;
+static unsigned long lastOutput = 0;
+static size_t outputsCompared = 0, outputsDiverged = 0;
+
+/***f* replayed
+ *
+ * Returns true if a record at the recorded time 'at' is due.
+ */
+static bool replayed(IN unsigned long at) {
+  return started && (long)at + offset_ms <= (long)harnessMillis();
+}
+
+/* ---- Reading the trace ---- */
+
+static bool take(IN const std::vector<uint8_t> &data,
+                 OUT size_t *pos,
+                 OUT void *value,
+                 IN size_t size) {
+  if (*pos + size > data.size())
+    return false;
+  memcpy(value, &data[*pos], size);
+  *pos += size;
+  return true;
+}
+
+/***f* loadTrace
+ *
+ * Reads the records of 'path'. Whatever comes before the header (the
+ * console output before the 'T' command) is skipped.
+ */
+static bool loadTrace(IN const char *path) {
+  FILE *f = fopen(path, "rb");
+  if (!f) {
+    perror(path);
+    return false;
+  }
+  std::vector<uint8_t> data;
+  uint8_t chunk[4096];
+  size_t n;
+  while ((n = fread(chunk, 1, sizeof(chunk), f)) > 0)
+    data.insert(data.end(), chunk, chunk + n);
+  fclose(f);
+
+  size_t pos = 0;
+  while (pos + 5 <= data.size() &&
+         !(data[pos] == TRACE_HEADER && data[pos + 3] == (TRACE_MAGIC & 0xFF) &&
+           data[pos + 4] == (TRACE_MAGIC >> 8)))
+    pos++;
+  if (pos + 5 > data.size()) {
+    fprintf(stderr, "%s: no trace header\n", path);
+    return false;
+  }
+  traceBytes = data.size() - pos;
+
+  unsigned long at = 0;
+  bool have_header = false;
+  while (pos < data.size()) {
+    size_t record = pos;
+    uint8_t type;
+    uint16_t delta;
+    if (!take(data, &pos, &type, 1) || !take(data, &pos, &delta, 2))
+      break;
+    at += delta;
+
+    bool complete = true;
+    switch (type) {
+      case TRACE_HEADER: {
+        uint16_t magic;
+        complete = take(data, &pos, &magic, 2) &&
+                   take(data, &pos, &header.version, 1) &&
+                   take(data, &pos, &header.num_sensors, 1) &&
+                   take(data, &pos, &header.millis, 4) &&
+                   take(data, &pos, &header.desired_temperature, 2) &&
+                   take(data, &pos, &header.kp, 4) &&
+                   take(data, &pos, &header.ki, 4) &&
+                   take(data, &pos, &header.kd, 4) &&
+                   take(data, &pos, &header.lcd_backlight_timeout, 4) &&
+                   take(data, &pos, &header.menu_return_timeout, 2) &&
+                   take(data, &pos, &header.resume_window, 1);
+        if (!complete)
+          break;
+        if (have_header) {
+          fprintf(stderr, "%s: a second header at %zu. Replaying up to there.\n", path, record);
+          pos = data.size();
+          break;
+        }
+        if (header.version != TRACE_VERSION) {
+          fprintf(stderr, "%s: version %u, expected %u\n", path, header.version, TRACE_VERSION);
+          return false;
+        }
+        if (header.num_sensors != numSensors) {
+          fprintf(stderr, "%s: recorded with %u sensors, the firmware has %u\n",
+                  path, header.num_sensors, numSensors);
+          return false;
+        }
+        at = header.millis;
+        have_header = true;
+        break;
+      }
+      case TRACE_TIME: {
+        uint32_t millis;
+        if ((complete = take(data, &pos, &millis, 4)))
+          at = millis;
+        break;
+      }
+      case TRACE_SENSORS: {
+        std::vector<int16_t> reading(header.num_sensors);
+        if ((complete = take(data, &pos, &reading[0], reading.size() * sizeof(int16_t))))
+          sensorReadings.push_back(reading);
+        break;
+      }
+      case TRACE_BUTTONS: {
+        recorded_buttons b;
+        b.at = at;
+        if ((complete = take(data, &pos, &b.buttons, 1)))
+          buttonChanges.push_back(b);
+        break;
+      }
+      case TRACE_PACKET: {
+        recorded_packet p;
+        uint16_t len;
+        p.at = at;
+        complete = take(data, &pos, p.seq, 4) && take(data, &pos, p.ip, 4) &&
+                   take(data, &pos, &len, 2);
+        if (complete) {
+          p.payload.resize(len);
+          if ((complete = take(data, &pos, p.payload.data(), len)))
+            packets.push_back(p);
+        }
+        break;
+      }
+      case TRACE_OUTPUT: {
+        recorded_output o;
+        o.at = at;
+        complete = take(data, &pos, &o.heater, 1) && take(data, &pos, &o.op_state, 1) &&
+                   take(data, &pos, &o.setpoint, 2);
+        if (complete)
+          outputs.push_back(o);
+        break;
+      }
+      case TRACE_END:
+        traceTruncated = true;
+        pos = data.size();
+        break;
+      default:
+        fprintf(stderr, "%s: unknown record %u at %zu. Replaying up to there.\n",
+                path, type, record);
+        pos = data.size();
+        break;
+    }
+    if (!complete)
+      break;
+    traceEnd = at;
+  }
+
+  if (!have_header) {
+    fprintf(stderr, "%s: the header is incomplete\n", path);
+    return false;
+  }
+  return true;
+}
+
+/* ---- The inputs ---- */
+
+void harnessBeforeIsr() {
+  while (!buttonChanges.empty() && replayed(buttonChanges.front().at)) {
+    harnessSetButtons(buttonChanges.front().buttons);
+    buttonChanges.pop_front();
+    buttonChangesFed++;
+  }
+}
+
+float replaySensorValue(uint8_t sensor) {
+  if (sensor == 0) {
+    if (sensorReadings.empty()) {
+      /* The replay runs a little longer than the trace */
+      if (!replayed(traceEnd))
+        extraSensorReads++;
+    } else {
+      lastReading = sensorReadings.front();
+      sensorReadings.pop_front();
+      sensorReadingsFed++;
+    }
+  }
+  if (sensor >= lastReading.size())
+    return DEVICE_DISCONNECTED_C;
+  return lastReading[sensor] / 16.0f;
+}
+
+uint16_t replayPacket(uint8_t *frame) {
+  if (packets.empty() || !replayed(packets.front().at))
+    return 0;
+
+  const recorded_packet &p = packets.front();
+  size_t len = p.payload.size();
+  if (len > 2000 - TCP_DATA_P - 1)
+    len = 2000 - TCP_DATA_P - 1;
+  /* A TCP segment to the address of the firmware, or networkTask()
+   * drops it */
+  memset(frame, 0, TCP_DATA_P);
+  frame[ETH_TYPE_H_P] = ETHTYPE_IP_H_V;
+  frame[ETH_TYPE_L_P] = ETHTYPE_IP_L_V;
+  frame[IP_HEADER_LEN_VER_P] = 0x45;
+  frame[IP_PROTO_P] = IP_PROTO_TCP_V;
+  memcpy(frame + IP_SRC_P, p.ip, 4);
+  memcpy(frame + IP_DST_P, ether.myip, 4);
+  memcpy(frame + TCP_SEQ_H_P, p.seq, 4);
+  memcpy(frame + TCP_DATA_P, p.payload.data(), len);
+  frame[TCP_DATA_P + len] = '\0';
+  packets.pop_front();
+  packetsFed++;
+  return TCP_DATA_P + len;
+}
+
+void replayReply(uint16_t len) {
+  replies++;
+  replyBytes += len;
+}
+
+void replaySerialWrite(uint8_t c) {
+  if (serialOut)
+    fputc(c, serialOut);
+}
+
+/* ---- The outputs: trace.h, built for the replay ---- */
+
+void traceStart() {
+  started = true;
+  offset_ms = (long)millis() - (long)header.millis;
+}
+
+void traceSensors(IN const float *temperatures,
+                  IN uint8_t count) {
+}
+
+void traceTick(IN uint8_t buttons,
+               IN uint8_t heater_output) {
+  heaterOutput = heater_output;
+}
+
+void tracePacket(IN const uint8_t *frame,
+                 IN uint16_t pos) {
+}
+
+/***f* traceTask
+ *
+ * Compares what the firmware outputs with the next TRACE_OUTPUT record.
+ * The records are taken in the same way as trace.cpp does, so the n-th
+ * output of the replay goes with the n-th recorded one.
+ */
+void traceTask(IN uint8_t op_state,
+               IN float setpoint) {
+  unsigned long now = millis();
+
+  if (now - lastOutput < TRACE_OUTPUT_PERIOD_MS)
+    return;
+  lastOutput = now;
+
+  const recorded_output *r = NULL;
+  if (outputsCompared < outputs.size())
+    r = &outputs[outputsCompared++];
+
+  int16_t raw = lround(setpoint * 16);
+  bool same = true;
+  if (r) {
+    unsigned heater_diff = abs((int)heaterOutput - (int)r->heater);
+    same = heater_diff <= heaterTolerance && op_state == r->op_state && raw == r->setpoint;
+  }
+  if (!same)
+    outputsDiverged++;
+
+  if (verbose || (!same && outputsDiverged <= REPLAY_MAX_REPORTED)) {
+    printf("%10.3f s  heater %3u, opState %2u, setpoint %6.2f", (now - offset_ms) / 1000.0,
+           heaterOutput, op_state, setpoint);
+    if (r)
+      printf("  recorded %3u, %2u, %6.2f", r->heater, r->op_state, r->setpoint / 16.0);
+    printf("%s\n", same ? "" : "  DIVERGED");
+  } else if (!same && outputsDiverged == REPLAY_MAX_REPORTED + 1) {
+    printf("...\n");
+  }
+}
+
+void traceStream() {
+}
+
+bool traceStreaming() {
+  return false;
+}
+
+uint16_t tracePrint(OUT Print &out,
+                    IN uint16_t offset,
+                    IN uint16_t max_size) {
+  return 0;
+}
+
+uint16_t traceSize() {
+  return 0;
+}
+
+/* ---- Running it ---- */
+
+static void usage() {
+  fprintf(stderr,
+          "usage: replay [-t tolerance] [-s serial.bin] [-v] trace.bin\n"
+          "  -t  how much the heater output may differ, in 1/255 (default %u)\n"
+          "  -s  write the serial output of the firmware (the binary log) to a file\n"
+          "  -v  print every output that is compared\n",
+          REPLAY_HEATER_TOLERANCE);
+  exit(2);
+}
+
+static void printTiming(IN const char *name,
+                        IN const host_timing *t) {
+  printf("  %-8s %10lu runs, %8.2f us avg, %8.2f us max on this host\n", name, t->runs,
+         t->runs ? t->total_us / t->runs : 0, t->max_us);
+}
+
+int main(int argc, char **argv) {
+  const char *path = NULL;
+
+  for (int i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], "-t") && i + 1 < argc)
+      heaterTolerance = atoi(argv[++i]);
+    else if (!strcmp(argv[i], "-s") && i + 1 < argc) {
+      serialOut = fopen(argv[++i], "wb");
+      if (!serialOut) {
+        perror(argv[i]);
+        return 2;
+      }
+    } else if (!strcmp(argv[i], "-v"))
+      verbose = true;
+    else if (argv[i][0] == '-' || path)
+      usage();
+    else
+      path = argv[i];
+  }
+  if (!path)
+    usage();
+  if (!loadTrace(path))
+    return 2;
+
+  /* Store the recorded settings, so that setup() loads them
+   * from the EEPROM like the firmware did */
+  settingsInit();
+  settingsSetDesiredTemperature(header.desired_temperature / 10.0);
+  settingsSetTunings(header.kp, header.ki, header.kd);
+  settingsSetTimeouts(header.lcd_backlight_timeout, header.menu_return_timeout);
+  settingsSetResumeWindow(header.resume_window);
+  harnessStoreSettings();
+
+  double start = harnessHostMicros();
+  harnessBoot(0);
+
+  unsigned long end_ms = traceEnd + offset_ms + REPLAY_TAIL_MS;
+  while (harnessMillis() < end_ms)
+    harnessLoop(REPLAY_LOOP_PERIOD_US);
+  double host_s = (harnessHostMicros() - start) / 1e6;
+
+  bool diverged = outputsDiverged || outputsCompared < outputs.size() ||
+                  !sensorReadings.empty() || extraSensorReads || !packets.empty();
+
+  printf("Replayed %.1f s of %s (%zu bytes%s) in %.2f s\n",
+         (traceEnd - header.millis) / 1000.0, path, traceBytes,
+         traceTruncated ? ", the recording stopped when the buffer was full" : "", host_s);
+  printf("  inputs:  %lu sensor readings, %lu button changes, %lu HTTP requests\n",
+         sensorReadingsFed, buttonChangesFed, packetsFed);
+  if (!sensorReadings.empty() || extraSensorReads)
+    printf("           %zu recorded readings left over, %lu reads beyond the trace\n",
+           sensorReadings.size(), extraSensorReads);
+  if (!packets.empty())
+    printf("           %zu recorded requests left over\n", packets.size());
+  printf("  outputs: %zu of %zu compared, %zu diverged (heater tolerance %u)\n",
+         outputsCompared, outputs.size(), outputsDiverged, heaterTolerance);
+  printf("  replies: %lu segments, %lu bytes\n", replies, replyBytes);
+  printTiming("loop()", &harnessLoopTiming);
+  printTiming("ISR", &harnessIsrTiming);
+  printf("%s\n", diverged ? "DIVERGED" : "OK");
+
+  if (serialOut)
+    fclose(serialOut);
+  return diverged ? 1 : 0;
+}
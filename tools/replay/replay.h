@@ -0,0 +1,48 @@
+#ifndef replay_h
+#define replay_h
+
+#include <stdint.h>
+
+/* What the shims (shim/shim.cpp) need from the runner: the virtual
+ * clock of harness.cpp, and the inputs of replay.cpp or bench.cpp */
+
+/***f* replayMicros
+ *
+ * Returns the virtual time. While the firmware boots, every
+ * call moves it a little, so that the busy-waits of setup() end.
+ */
+unsigned long replayMicros();
+
+/***f* replayAdvance
+ *
+ * Moves the virtual time, and runs the Timer1 ISR when it is due.
+ */
+void replayAdvance(unsigned long us);
+
+/***f* replaySensorValue
+ *
+ * Returns the reading of 'sensor': from the next TRACE_SENSORS record in
+ * the replay, from the plant model in the benchmark.
+ */
+float replaySensorValue(uint8_t sensor);
+
+/***f* replayPacket
+ *
+ * Copies the next HTTP payload in 'frame' if its time has come, and
+ * returns the length of the frame, or zero.
+ */
+uint16_t replayPacket(uint8_t *frame);
+
+/***f* replayReply
+ *
+ * Counts a TCP segment that the firmware sent.
+ */
+void replayReply(uint16_t len);
+
+/***f* replaySerialWrite
+ *
+ * Takes a byte that the firmware wrote to the serial port.
+ */
+void replaySerialWrite(uint8_t c);
+
+#endif
@@ -0,0 +1,99 @@
+/* Runs the firmware, built for the host, as a web server on a TAP
+ * device: the frames go through processEthernetPacket() and the rest of
+ * networkTask() as on the ENC28J60 (see shim/ether_tap.cpp), and loop()
+ * and the Timer1 ISR run on the clock of the host. For load tests with
+ * curl, ab, wrk or tools/replay/loadtest.py:
+ *
+ *   ip tuntap add dev sousvide0 mode tap
+ *   ip addr add 192.168.1.1/24 dev sousvide0
+ *   ip link set sousvide0 up
+ *   ./server -i sousvide0
+ *   curl http://192.168.1.100/
+ *
+ * The firmware has the address of shim/NetEEPROM.h. The temperatures
+ * are constant, as in http.cpp. Ctrl-C stops it and prints the counters
+ * of the frames and the timing of loop(). It exits with 1 if the
+ * firmware built a frame longer than the ENC28J60 sends, which isn't
+ * sent, so the requests whose reply it was time out in the load test.
+ */
+
+#include <errno.h>
+#include <poll.h>
+#include <signal.h>
+
+#include "http.h"
+#include "harness.h"
+#include "ether_tap.h"
+
+#include "common.h"
+#include "NetEEPROM.h"
+
+#define SERVER_TAP "sousvide0"
+#define SERVER_IDLE_MS 1       // How long to wait for a frame between the loop() runs
+
+static volatile sig_atomic_t stop = 0;
+
+static void onSignal(int sig) {
+  stop = 1;
+}
+
+static void printStats() {
+  const tap_stats *s = tapGetStats();
+  const host_timing *lp = &harnessLoopTiming;
+
+  fprintf(stderr,
+          "frames: %lu received, %lu sent, %lu send errors, %lu too long\n"
+          "        %lu ARP, %lu ICMP echo, %lu SYN, %lu requests, %lu FIN, %lu ignored\n",
+          s->frames_rx, s->frames_tx, s->send_errors, s->oversized,
+          s->arp, s->icmp, s->syn, s->requests, s->fin, s->ignored);
+  fprintf(stderr, "loop(): %lu runs, %.2f us avg, %.2f us max on this host\n",
+          lp->runs, lp->runs ? lp->total_us / lp->runs : 0.0, lp->max_us);
+}
+
+static void usage() {
+  fprintf(stderr,
+          "usage: server [-i interface]\n"
+          "  -i  the TAP device (default: " SERVER_TAP ")\n");
+  exit(2);
+}
+
+int main(int argc, char **argv) {
+  const char *tap = SERVER_TAP;
+
+  for (int i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], "-i") && i + 1 < argc)
+      tap = argv[++i];
+    else
+      usage();
+  }
+
+  if (!tapOpen(tap)) {
+    fprintf(stderr, "server: can't open the TAP device %s: %s\n", tap, strerror(errno));
+    return 1;
+  }
+  signal(SIGINT, onSignal);
+  signal(SIGTERM, onSignal);
+
+  uint8_t ip[4];
+  NetEeprom.readIp(ip);
+  fprintf(stderr, "server: %u.%u.%u.%u on %s\n", ip[0], ip[1], ip[2], ip[3], tap);
+  httpBoot();
+
+  /* The virtual time of the harness follows the host */
+  struct pollfd pfd = {tapFd(), POLLIN, 0};
+  double last = harnessHostMicros();
+  while (!stop) {
+    poll(&pfd, 1, SERVER_IDLE_MS);
+    unsigned long elapsed_us = harnessHostMicros() - last;
+    last += elapsed_us;
+    harnessLoop(elapsed_us);
+  }
+
+  printStats();
+  if (tapGetStats()->oversized) {
+    fprintf(stderr, "server: frames longer than MAX_FRAMELEN (%d bytes) weren't sent\n",
+            MAX_FRAMELEN);
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,135 @@
+#ifndef replay_arduino_h
+#define replay_arduino_h
+
+/* The parts of the Arduino core and avr-libc that the firmware uses,
+ * for running it on the host (see replay.cpp). The time is virtual:
+ * it only moves when the replay moves it. */
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <math.h>
+
+typedef uint8_t byte;
+typedef bool boolean;
+
+#define PROGMEM
+#define PGM_P const char *
+#define PSTR(s) (s)
+class __FlashStringHelper;
+#define F(s) ((const __FlashStringHelper *)(s))
+
+/* The PROGMEM tables hold host pointers, so read them whole */
+#define pgm_read_byte(p) (*(const uint8_t *)(p))
+#define pgm_read_word(p) (*(p))
+#define pgm_read_dword(p) (*(p))
+#define pgm_read_float(p) (*(const float *)(p))
+#define pgm_read_ptr(p) (*(p))
+
+inline char *strcpy_P(char *d, const char *s) { return strcpy(d, s); }
+inline char *strncpy_P(char *d, const char *s, size_t n) { return strncpy(d, s, n); }
+inline char *strcat_P(char *d, const char *s) { return strcat(d, s); }
+inline size_t strlen_P(const char *s) { return strlen(s); }
+inline int strcmp_P(const char *a, const char *b) { return strcmp(a, b); }
+inline int strncmp_P(const char *a, const char *b, size_t n) { return strncmp(a, b, n); }
+inline char *strstr_P(const char *a, const char *b) { return (char *)strstr(a, b); }
+inline const char *strchr_P(const char *s, int c) { return strchr(s, c); }
+inline void *memcpy_P(void *d, const void *s, size_t n) { return memcpy(d, s, n); }
+
+char *dtostrf(double value, signed char width, unsigned char prec, char *s);
+char *itoa(int value, char *s, int radix);
+char *utoa(unsigned int value, char *s, int radix);
+char *ltoa(long value, char *s, int radix);
+char *ultoa(unsigned long value, char *s, int radix);
+
+#define HIGH 1
+#define LOW 0
+#define INPUT 0
+#define OUTPUT 1
+#define INPUT_PULLUP 2
+#define DEC 10
+#define HEX 16
+#define OCT 8
+#define BIN 2
+
+#define B00000 0
+#define B00110 6
+#define B01001 9
+
+#ifndef min
+#define min(a, b) ((a) < (b) ? (a) : (b))
+#define max(a, b) ((a) > (b) ? (a) : (b))
+#endif
+#define constrain(a, l, h) ((a) < (l) ? (l) : ((a) > (h) ? (h) : (a)))
+#define bitRead(v, b) (((v) >> (b)) & 1)
+
+class Print {
+  public:
+    virtual ~Print() {}
+    virtual size_t write(uint8_t c) = 0;
+    size_t write(const uint8_t *buffer, size_t size);
+    size_t write(const char *s) { return write((const uint8_t *)s, strlen(s)); }
+
+    size_t print(const char *s) { return write(s); }
+    size_t print(const __FlashStringHelper *s) { return write((const char *)s); }
+    size_t print(char c) { return write((uint8_t)c); }
+    size_t print(unsigned char n, int base = DEC) { return print((unsigned long)n, base); }
+    size_t print(int n, int base = DEC) { return print((long)n, base); }
+    size_t print(unsigned int n, int base = DEC) { return print((unsigned long)n, base); }
+    size_t print(long n, int base = DEC);
+    size_t print(unsigned long n, int base = DEC);
+    size_t print(double n, int digits = 2);
+
+    size_t println() { return write("\r\n"); }
+    template <typename T> size_t println(T v) { size_t n = print(v); return n + println(); }
+    template <typename T> size_t println(T v, int f) { size_t n = print(v, f); return n + println(); }
+
+    virtual void flush() {}
+};
+
+/* What the firmware prints goes to stdout if the replay is verbose */
+class HardwareSerial : public Print {
+  public:
+    void begin(unsigned long) {}
+    int available() { return 0; }
+    int read() { return -1; }
+    int peek() { return -1; }
+    int availableForWrite() { return 63; }
+    size_t write(uint8_t c);
+    using Print::write;
+    operator bool() { return true; }
+};
+extern HardwareSerial Serial;
+
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
+
+void pinMode(uint8_t pin, uint8_t mode);
+int digitalRead(uint8_t pin);
+void digitalWrite(uint8_t pin, uint8_t value);
+void analogWrite(uint8_t pin, int value);
+
+/* Registers. The ones of the I/O space live in an array, so that
+ * _SFR_MEM8() and the FastGpio of the firmware work on them. */
+extern volatile uint8_t replaySfr[0x200];
+#define _SFR_MEM8(addr) (replaySfr[(addr)])
+
+extern volatile uint8_t SREG;
+extern volatile uint8_t TCCR1A, TCCR1B, TIMSK1, MCUSR;
+extern volatile uint16_t TCNT1;
+#define CS12 2
+#define TOIE1 0
+#define WDRF 3
+#define BORF 2
+#define EXTRF 1
+#define PORF 0
+
+inline void cli() { SREG &= ~0x80; }
+inline void sei() { SREG |= 0x80; }
+#define ISR(vector) extern "C" void vector(void)
+
+#endif
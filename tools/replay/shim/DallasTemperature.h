@@ -0,0 +1,29 @@
+#ifndef replay_dallastemperature_h
+#define replay_dallastemperature_h
+
+#include "OneWire.h"
+
+typedef uint8_t DeviceAddress[8];
+#define DEVICE_DISCONNECTED_C -127
+
+/* Every instance is a sensor. The readings come from the trace
+ * (see replaySensorValue() in replay.cpp). */
+class DallasTemperature {
+  public:
+    DallasTemperature() : index(count++) {}
+    void setOneWire(OneWire *wire) {}
+    void begin() {}
+    bool getAddress(uint8_t *address, uint8_t index) { memset(address, 0, 8); return true; }
+    bool setResolution(const uint8_t *address, uint8_t bits) { resolution = bits; return true; }
+    uint8_t getResolution(const uint8_t *address) { return resolution; }
+    void setWaitForConversion(bool wait) {}
+    void requestTemperatures() {}
+    float getTempCByIndex(uint8_t device);
+
+  private:
+    static uint8_t count;
+    uint8_t index;
+    uint8_t resolution = 12;
+};
+
+#endif
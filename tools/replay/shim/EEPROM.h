@@ -0,0 +1,20 @@
+#ifndef replay_eeprom_h
+#define replay_eeprom_h
+
+#include "Arduino.h"
+
+#define E2END 0xFFF
+#define eeprom_is_ready() true
+
+/* The 4KB of the Mega 2560, erased */
+struct EEPROMClass {
+  uint8_t read(int addr) { return data[addr]; }
+  void write(int addr, uint8_t value) { data[addr] = value; }
+  void update(int addr, uint8_t value) { data[addr] = value; }
+  uint16_t length() { return E2END + 1; }
+
+  uint8_t data[E2END + 1];
+};
+extern EEPROMClass EEPROM;
+
+#endif
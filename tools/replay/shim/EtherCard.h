@@ -0,0 +1,53 @@
+#ifndef replay_ethercard_h
+#define replay_ethercard_h
+
+#include "Arduino.h"
+#include "net.h"
+
+/* The frames go through one of two backends: ether_replay.cpp, where the
+ * HTTP payloads come from the runner (see replayPacket() in replay.h) and
+ * the replies are only counted, or ether_tap.cpp, where they are real
+ * frames on a TAP device of the host. */
+
+class BufferFiller : public Print {
+  public:
+    BufferFiller() : start(NULL), ptr(NULL) {}
+    BufferFiller(uint8_t *buffer) : start(buffer), ptr(buffer) {}
+    void emit_p(const char *fmt, ...);
+    void emit_raw(const char *s, uint16_t n) { memcpy(ptr, s, n); ptr += n; }
+    void emit_raw_p(const char *s, uint16_t n) { emit_raw(s, n); }
+    uint8_t *buffer() const { return start; }
+    uint16_t position() const { return ptr - start; }
+    size_t write(uint8_t c) { *ptr++ = c; return 1; }
+    using Print::write;
+
+  private:
+    uint8_t *start, *ptr;
+};
+
+class Ethernet {
+  public:
+    static uint8_t buffer[];
+    static uint8_t begin(uint16_t size, const uint8_t *mac, uint8_t cs_pin = 8);
+    static bool isLinkUp();
+    static uint16_t packetReceive();
+};
+
+class EtherCard : public Ethernet {
+  public:
+    static uint8_t mymac[6], myip[4], netmask[4], gwip[4], dhcpip[4], dnsip[4], hisip[4];
+
+    static bool staticSetup(const uint8_t *ip, const uint8_t *gw = 0,
+                            const uint8_t *dns = 0, const uint8_t *mask = 0);
+    static void DhcpStateMachine(uint16_t len) {}
+    static uint16_t packetLoop(uint16_t len);
+    static uint8_t *tcpOffset() { return buffer + TCP_DATA_P; }
+    static void httpServerReply(uint16_t len);
+    static void httpServerReplyAck();
+    static void httpServerReply_with_flags(uint16_t len, uint8_t flags);
+    static uint8_t parseIp(uint8_t *ip, const char *str);
+    static void copyIp(uint8_t *dst, const uint8_t *src) { memcpy(dst, src, 4); }
+};
+extern EtherCard ether;
+
+#endif
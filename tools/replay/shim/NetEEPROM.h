@@ -0,0 +1,31 @@
+#ifndef replay_neteeprom_h
+#define replay_neteeprom_h
+
+#include "EEPROM.h"
+
+#define NET_EEPROM_OFFSET (E2END - 31)
+
+/* A static configuration, so that the network is up right after
+ * setup() and the recorded requests reach the firmware */
+class NetEEPROMClass {
+  public:
+    void init(uint8_t *mac);
+    bool isDhcp() { return dhcp; }
+    void readIp(uint8_t *ip) { memcpy(ip, this->ip, 4); }
+    void readGateway(uint8_t *ip) { memcpy(ip, gateway, 4); }
+    void readDns(uint8_t *ip) { memcpy(ip, dns, 4); }
+    void readSubnet(uint8_t *ip) { memcpy(ip, subnet, 4); }
+    void writeDhcpConfig(uint8_t *mac) { dhcp = true; }
+    void writeManualConfig(uint8_t *mac, uint8_t *ip, uint8_t *gateway,
+                           uint8_t *subnet, uint8_t *dns);
+
+  private:
+    bool dhcp = false;
+    uint8_t ip[4] = {192, 168, 1, 100};
+    uint8_t gateway[4] = {192, 168, 1, 1};
+    uint8_t dns[4] = {192, 168, 1, 1};
+    uint8_t subnet[4] = {255, 255, 255, 0};
+};
+extern NetEEPROMClass NetEeprom;
+
+#endif
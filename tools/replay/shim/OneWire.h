@@ -0,0 +1,13 @@
+#ifndef replay_onewire_h
+#define replay_onewire_h
+
+#include "Arduino.h"
+
+class OneWire {
+  public:
+    OneWire() {}
+    OneWire(uint8_t pin) {}
+    void setPin(uint8_t pin) {}
+};
+
+#endif
@@ -0,0 +1,33 @@
+/* The frames of EtherCard for the replay, the benchmarks and the fuzz
+ * targets: the received payloads come from replayPacket() of the
+ * runner, and the replies are only counted. */
+
+#include "EtherCard.h"
+#include "replay.h"
+
+uint8_t Ethernet::begin(uint16_t size, const uint8_t *mac, uint8_t cs_pin) {
+  return 1;
+}
+
+bool Ethernet::isLinkUp() {
+  return true;
+}
+
+uint16_t Ethernet::packetReceive() {
+  return replayPacket(buffer);
+}
+
+uint16_t EtherCard::packetLoop(uint16_t len) {
+  return len ? TCP_DATA_P : 0;
+}
+
+void EtherCard::httpServerReplyAck() {
+}
+
+void EtherCard::httpServerReply(uint16_t len) {
+  replayReply(len);
+}
+
+void EtherCard::httpServerReply_with_flags(uint16_t len, uint8_t flags) {
+  replayReply(len);
+}
@@ -0,0 +1,350 @@
+/* The frames of EtherCard on a TAP device, for the server runner.
+ *
+ * This follows the TCP/IP of EtherCard (tcpip.cpp) closely, so that the
+ * firmware above it runs as on the ENC28J60: every reply is built in
+ * place in Ethernet::buffer from the frame that was received, and the
+ * HTTP server keeps no connection state. The SYN is answered with a
+ * SYN-ACK, a segment with data is handed to the firmware
+ * (packetLoop() returns the offset of the payload), the reply is sent
+ * with the FIN, and the FIN of the client is acknowledged. ARP and ICMP
+ * echo are answered too, so that the host finds the firmware and ping
+ * works. Nothing is retransmitted, as in EtherCard. */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <linux/if.h>
+#include <linux/if_tun.h>
+
+#include "EtherCard.h"
+#include "ether_tap.h"
+
+#include "common.h"
+
+#define TAP_HTTP_PORT 80
+#define TAP_WINDOW 1024        // The receive window that EtherCard advertises
+#define TAP_MSS 1408           // The MSS option of the SYN-ACK
+#define TAP_TTL 64
+#define TAP_ARP_LEN 42         // The Ethernet and ARP headers
+#define TAP_CRC_LEN 4          // Appended by the ENC28J60, counted in MAX_FRAMELEN
+#define TAP_ISN_STEP 0x10000   // Between the initial sequence numbers
+
+static int fd = -1;
+static uint16_t bufferSize = 0;
+static uint16_t infoDataLen = 0;   // The payload of the last segment, info_data_len in tcpip.cpp
+static uint32_t nextIsn = 0x0A;
+static tap_stats stats;
+
+static uint16_t get16(IN const uint8_t *p) {
+  return (uint16_t)p[0] << 8 | p[1];
+}
+
+static void put16(OUT uint8_t *p,
+                  IN uint16_t v) {
+  p[0] = v >> 8;
+  p[1] = v;
+}
+
+static uint32_t get32(IN const uint8_t *p) {
+  return (uint32_t)get16(p) << 16 | get16(p + 2);
+}
+
+static void put32(OUT uint8_t *p,
+                  IN uint32_t v) {
+  put16(p, v >> 16);
+  put16(p + 2, v);
+}
+
+/***f* checksum
+ *
+ * Returns the Internet checksum of 'len' bytes at 'p', starting from the
+ * partial sum 'sum' (of the TCP pseudo header).
+ */
+static uint16_t checksum(IN const uint8_t *p,
+                         IN uint16_t len,
+                         IN uint32_t sum) {
+  for (; len > 1; p += 2, len -= 2)
+    sum += get16(p);
+  if (len)
+    sum += (uint32_t)p[0] << 8;
+  while (sum >> 16)
+    sum = (sum & 0xFFFF) + (sum >> 16);
+  return ~sum;
+}
+
+static void frameSend(IN uint16_t len) {
+  /* The ENC28J60 aborts a frame longer than MAX_FRAMELEN. The reply
+   * that it was a segment of never completes. */
+  if (len + TAP_CRC_LEN > MAX_FRAMELEN) {
+    stats.oversized++;
+    return;
+  }
+  if (write(fd, Ethernet::buffer, len) == len)
+    stats.frames_tx++;
+  else
+    stats.send_errors++;
+}
+
+static void swap(OUT uint8_t *a,
+                 OUT uint8_t *b,
+                 IN uint8_t len) {
+  for (uint8_t i = 0; i < len; i++) {
+    uint8_t t = a[i];
+    a[i] = b[i];
+    b[i] = t;
+  }
+}
+
+/***f* ipReply
+ *
+ * Turns the Ethernet and the IP headers of the received frame around
+ * (make_eth() and make_ip() of EtherCard).
+ */
+static void ipReply() {
+  uint8_t *b = Ethernet::buffer;
+
+  memcpy(b + ETH_DST_MAC, b + ETH_SRC_MAC, 6);
+  memcpy(b + ETH_SRC_MAC, EtherCard::mymac, 6);
+  memcpy(b + IP_DST_P, b + IP_SRC_P, 4);
+  memcpy(b + IP_SRC_P, EtherCard::myip, 4);
+}
+
+static void ipHeader(IN uint16_t total_len) {
+  uint8_t *b = Ethernet::buffer;
+
+  b[IP_HEADER_LEN_VER_P] = 0x45;
+  b[IP_HEADER_LEN_VER_P + 1] = 0;
+  put16(b + IP_TOTLEN_H_P, total_len);
+  put16(b + IP_ID_H_P, 0);
+  b[IP_FLAGS_P] = 0x40;  // Don't fragment
+  b[IP_FLAGS_P + 1] = 0;
+  b[IP_TTL_P] = TAP_TTL;
+  put16(b + IP_CHECKSUM_P, 0);
+  put16(b + IP_CHECKSUM_P, checksum(b + IP_P, IP_HEADER_LEN, 0));
+}
+
+/***f* tcpSend
+ *
+ * Sends the TCP segment in the buffer, whose headers already go to the
+ * client, with 'options_len' bytes of options or 'data_len' bytes of
+ * payload at TCP_DATA_P.
+ */
+static void tcpSend(IN uint16_t data_len,
+                    IN uint8_t options_len) {
+  uint8_t *b = Ethernet::buffer;
+  uint16_t tcp_len = TCP_HEADER_LEN_PLAIN + options_len + data_len;
+
+  ipHeader(IP_HEADER_LEN + tcp_len);
+  b[TCP_HEADER_LEN_P] = ((TCP_HEADER_LEN_PLAIN + options_len) / 4) << 4;
+  put16(b + TCP_WIN_SIZE, TAP_WINDOW);
+  put16(b + TCP_CHECKSUM_H_P, 0);
+  put16(b + TCP_CHECKSUM_H_P + 2, 0);  // The urgent pointer
+
+  /* The pseudo header: the addresses, the protocol and the length */
+  uint32_t sum = IP_PROTO_TCP_V + tcp_len;
+  for (uint8_t i = 0; i < 8; i += 2)
+    sum += get16(b + IP_SRC_P + i);
+  put16(b + TCP_CHECKSUM_H_P, checksum(b + TCP_SRC_PORT_H_P, tcp_len, sum));
+
+  frameSend(ETH_HEADER_LEN + IP_HEADER_LEN + tcp_len);
+}
+
+/***f* tcpReplyTo
+ *
+ * Turns the received segment around with 'flags', acknowledging
+ * 'ack_len' sequence numbers of it (make_tcp_ack_from_any() of
+ * EtherCard). A SYN-ACK starts the sequence numbers of the connection.
+ */
+static void tcpReplyTo(IN uint16_t ack_len,
+                       IN uint8_t flags) {
+  uint8_t *b = Ethernet::buffer;
+  uint32_t seq = get32(b + TCP_SEQ_H_P);
+  uint32_t ack = get32(b + TCP_SEQACK_H_P);
+
+  swap(b + TCP_SRC_PORT_H_P, b + TCP_DST_PORT_H_P, 2);
+  if (flags & TCP_FLAGS_SYN_V) {
+    put32(b + TCP_SEQ_H_P, nextIsn);
+    nextIsn += TAP_ISN_STEP;
+  } else {
+    put32(b + TCP_SEQ_H_P, ack);
+  }
+  put32(b + TCP_SEQACK_H_P, seq + ack_len);
+  b[TCP_FLAGS_P] = flags;
+  ipReply();
+}
+
+static void arpReply() {
+  uint8_t *b = Ethernet::buffer;
+
+  b[ETH_ARP_OPCODE_H_P] = ETH_ARP_OPCODE_REPLY_H_V;
+  b[ETH_ARP_OPCODE_L_P] = ETH_ARP_OPCODE_REPLY_L_V;
+  memcpy(b + ETH_ARP_DST_MAC_P, b + ETH_ARP_SRC_MAC_P, 6);
+  memcpy(b + ETH_ARP_DST_IP_P, b + ETH_ARP_SRC_IP_P, 4);
+  memcpy(b + ETH_ARP_SRC_MAC_P, EtherCard::mymac, 6);
+  memcpy(b + ETH_ARP_SRC_IP_P, EtherCard::myip, 4);
+  memcpy(b + ETH_DST_MAC, b + ETH_SRC_MAC, 6);
+  memcpy(b + ETH_SRC_MAC, EtherCard::mymac, 6);
+  frameSend(TAP_ARP_LEN);
+}
+
+static void echoReply(IN uint16_t ip_len) {
+  uint8_t *b = Ethernet::buffer;
+
+  b[ICMP_TYPE_P] = ICMP_TYPE_ECHOREPLY_V;
+  put16(b + ICMP_CHECKSUM_P, 0);
+  put16(b + ICMP_CHECKSUM_P, checksum(b + ICMP_TYPE_P, ip_len - IP_HEADER_LEN, 0));
+  ipReply();
+  ipHeader(ip_len);
+  frameSend(ETH_HEADER_LEN + ip_len);
+}
+
+bool tapOpen(const char *name) {
+  struct ifreq ifr;
+
+  fd = open("/dev/net/tun", O_RDWR | O_NONBLOCK);
+  if (fd < 0)
+    return false;
+
+  memset(&ifr, 0, sizeof(ifr));
+  ifr.ifr_flags = IFF_TAP | IFF_NO_PI;
+  strncpy(ifr.ifr_name, name, IFNAMSIZ - 1);
+  if (ioctl(fd, TUNSETIFF, &ifr) < 0) {
+    int error = errno;
+    close(fd);
+    fd = -1;
+    errno = error;
+    return false;
+  }
+  return true;
+}
+
+int tapFd() {
+  return fd;
+}
+
+const tap_stats *tapGetStats() {
+  return &stats;
+}
+
+/* ---- EtherCard ---- */
+
+uint8_t Ethernet::begin(uint16_t size, const uint8_t *mac, uint8_t cs_pin) {
+  if (fd < 0)
+    return 0;
+  bufferSize = size;
+  memcpy(EtherCard::mymac, mac, 6);
+  return 1;
+}
+
+bool Ethernet::isLinkUp() {
+  return fd >= 0;
+}
+
+uint16_t Ethernet::packetReceive() {
+  if (fd < 0 || bufferSize == 0)
+    return 0;
+
+  /* Keep a byte for the terminating character, as the ENC28J60 driver */
+  ssize_t len = read(fd, buffer, bufferSize - 1);
+  if (len <= 0)
+    return 0;
+  stats.frames_rx++;
+  return len;
+}
+
+uint16_t EtherCard::packetLoop(uint16_t len) {
+  uint8_t *b = buffer;
+
+  if (len < ETH_HEADER_LEN)
+    return 0;
+
+  if (b[ETH_TYPE_H_P] == ETHTYPE_ARP_H_V && b[ETH_TYPE_L_P] == ETHTYPE_ARP_L_V) {
+    if (len >= TAP_ARP_LEN &&
+        b[ETH_ARP_OPCODE_H_P] == ETH_ARP_OPCODE_REQ_H_V &&
+        b[ETH_ARP_OPCODE_L_P] == ETH_ARP_OPCODE_REQ_L_V &&
+        memcmp(b + ETH_ARP_DST_IP_P, myip, 4) == 0) {
+      stats.arp++;
+      arpReply();
+    } else {
+      stats.ignored++;
+    }
+    return 0;
+  }
+
+  /* IPv4 without options, to our address, in one piece */
+  uint16_t ip_len = len >= ETH_HEADER_LEN + IP_HEADER_LEN ? get16(b + IP_TOTLEN_H_P) : 0;
+  if (b[ETH_TYPE_H_P] != ETHTYPE_IP_H_V || b[ETH_TYPE_L_P] != ETHTYPE_IP_L_V || b[IP_HEADER_LEN_VER_P] != 0x45 ||
+      ip_len < IP_HEADER_LEN || ETH_HEADER_LEN + ip_len > len ||
+      memcmp(b + IP_DST_P, myip, 4) != 0) {
+    stats.ignored++;
+    return 0;
+  }
+
+  if (b[IP_PROTO_P] == IP_PROTO_ICMP_V) {
+    if (ip_len > ICMP_CHECKSUM_P + 2 - ETH_HEADER_LEN &&
+        b[ICMP_TYPE_P] == ICMP_TYPE_ECHOREQUEST_V) {
+      stats.icmp++;
+      echoReply(ip_len);
+    } else {
+      stats.ignored++;
+    }
+    return 0;
+  }
+
+  uint8_t tcp_header_len = ip_len >= IP_HEADER_LEN + TCP_HEADER_LEN_PLAIN ?
+                           (b[TCP_HEADER_LEN_P] >> 4) * 4 : 0;
+  if (b[IP_PROTO_P] != IP_PROTO_TCP_V || tcp_header_len < TCP_HEADER_LEN_PLAIN ||
+      IP_HEADER_LEN + tcp_header_len > ip_len ||
+      get16(b + TCP_DST_PORT_H_P) != TAP_HTTP_PORT) {
+    stats.ignored++;
+    return 0;
+  }
+
+  uint8_t flags = b[TCP_FLAGS_P];
+  if (flags & TCP_FLAGS_RST_V)
+    return 0;
+
+  if (flags & TCP_FLAGS_SYN_V) {
+    stats.syn++;
+    tcpReplyTo(1, TCP_FLAGS_SYN_V | TCP_FLAGS_ACK_V);
+    b[TCP_OPTIONS_P] = 2;  // MSS
+    b[TCP_OPTIONS_P + 1] = 4;
+    put16(b + TCP_OPTIONS_P + 2, TAP_MSS);
+    tcpSend(0, 4);
+    return 0;
+  }
+
+  infoDataLen = ip_len - IP_HEADER_LEN - tcp_header_len;
+  if (infoDataLen > 0 && (flags & TCP_FLAGS_ACK_V)) {
+    uint16_t pos = ETH_HEADER_LEN + IP_HEADER_LEN + tcp_header_len;
+    /* Without the padding of short frames */
+    b[pos + infoDataLen] = '\0';
+    stats.requests++;
+    return pos;
+  }
+
+  if (flags & TCP_FLAGS_FIN_V) {
+    stats.fin++;
+    tcpReplyTo(infoDataLen + 1, TCP_FLAGS_ACK_V);
+    tcpSend(0, 0);
+  }
+  return 0;
+}
+
+void EtherCard::httpServerReplyAck() {
+  tcpReplyTo(infoDataLen, TCP_FLAGS_ACK_V);
+  tcpSend(0, 0);
+}
+
+void EtherCard::httpServerReply(uint16_t len) {
+  httpServerReplyAck();
+  buffer[TCP_FLAGS_P] = TCP_FLAGS_ACK_V | TCP_FLAGS_PUSH_V | TCP_FLAGS_FIN_V;
+  tcpSend(len, 0);
+}
+
+void EtherCard::httpServerReply_with_flags(uint16_t len, uint8_t flags) {
+  buffer[TCP_FLAGS_P] = flags;
+  tcpSend(len, 0);
+  put32(buffer + TCP_SEQ_H_P, get32(buffer + TCP_SEQ_H_P) + len);
+}
@@ -0,0 +1,37 @@
+#ifndef replay_ether_tap_h
+#define replay_ether_tap_h
+
+#include <stdint.h>
+
+/* The frames of EtherCard on a TAP device of the host (ether_tap.cpp),
+ * for the server runner (server.cpp). */
+
+typedef struct _tap_stats {
+  unsigned long frames_rx, frames_tx;
+  unsigned long arp, icmp;            // The requests answered
+  unsigned long syn, requests, fin;   // The TCP segments to the HTTP port
+  unsigned long ignored;              // Not for us, or not understood
+  unsigned long send_errors;
+  unsigned long oversized;            // Not sent: longer than the ENC28J60 sends
+} tap_stats;
+
+/***f* tapOpen
+ *
+ * Attaches to the TAP device 'name', creating it if the process may.
+ * Returns false, with the reason in errno, if it can't.
+ */
+bool tapOpen(const char *name);
+
+/***f* tapFd
+ *
+ * Returns the file descriptor of the TAP device, for poll().
+ */
+int tapFd();
+
+/***f* tapGetStats
+ *
+ * Returns the counters of the frames since tapOpen().
+ */
+const tap_stats *tapGetStats();
+
+#endif
@@ -0,0 +1,69 @@
+#ifndef replay_net_h
+#define replay_net_h
+
+/* The offsets in an Ethernet frame, as in the net.h of EtherCard */
+#define ETH_HEADER_LEN 14
+#define MAX_FRAMELEN 1500 // The largest frame of the ENC28J60, with its 4 byte CRC (enc28j60.h)
+#define ETH_DST_MAC 0
+#define ETH_SRC_MAC 6
+#define ETH_TYPE_H_P 12
+#define ETH_TYPE_L_P 13
+#define ETHTYPE_ARP_H_V 0x08
+#define ETHTYPE_ARP_L_V 0x06
+#define ETHTYPE_IP_H_V 0x08
+#define ETHTYPE_IP_L_V 0x00
+
+#define ETH_ARP_OPCODE_H_P 0x14
+#define ETH_ARP_OPCODE_L_P 0x15
+#define ETH_ARP_OPCODE_REQ_H_V 0x00
+#define ETH_ARP_OPCODE_REQ_L_V 0x01
+#define ETH_ARP_OPCODE_REPLY_H_V 0x00
+#define ETH_ARP_OPCODE_REPLY_L_V 0x02
+#define ETH_ARP_SRC_MAC_P 0x16
+#define ETH_ARP_SRC_IP_P 0x1c
+#define ETH_ARP_DST_MAC_P 0x20
+#define ETH_ARP_DST_IP_P 0x26
+
+#define IP_HEADER_LEN 20
+#define IP_P 0x0e
+#define IP_HEADER_LEN_VER_P 0x0e
+#define IP_TOTLEN_H_P 0x10
+#define IP_ID_H_P 0x12
+#define IP_FLAGS_P 0x14
+#define IP_TTL_P 0x16
+#define IP_PROTO_P 0x17
+#define IP_CHECKSUM_P 0x18
+#define IP_SRC_P 0x1a
+#define IP_DST_P 0x1e
+#define IP_PROTO_ICMP_V 1
+#define IP_PROTO_TCP_V 6
+#define IP_PROTO_UDP_V 17
+
+#define ICMP_TYPE_P 0x22
+#define ICMP_CHECKSUM_P 0x24
+#define ICMP_TYPE_ECHOREQUEST_V 8
+#define ICMP_TYPE_ECHOREPLY_V 0
+
+#define UDP_DST_PORT_H_P 0x24
+#define UDP_DST_PORT_L_P 0x25
+#define UDP_DATA_P 0x2a
+
+#define TCP_HEADER_LEN_PLAIN 20
+#define TCP_SRC_PORT_H_P 0x22
+#define TCP_DST_PORT_H_P 0x24
+#define TCP_DST_PORT_L_P 0x25
+#define TCP_SEQ_H_P 0x26
+#define TCP_SEQACK_H_P 0x2a
+#define TCP_HEADER_LEN_P 0x2e
+#define TCP_FLAGS_P 0x2f
+#define TCP_WIN_SIZE 0x30
+#define TCP_CHECKSUM_H_P 0x32
+#define TCP_OPTIONS_P 0x36
+#define TCP_FLAGS_FIN_V 0x01
+#define TCP_FLAGS_SYN_V 0x02
+#define TCP_FLAGS_RST_V 0x04
+#define TCP_FLAGS_PUSH_V 0x08
+#define TCP_FLAGS_ACK_V 0x10
+#define TCP_DATA_P (ETH_HEADER_LEN + IP_HEADER_LEN + TCP_HEADER_LEN_PLAIN)
+
+#endif
@@ -0,0 +1,322 @@
+/* The host side of the Arduino core and of the libraries that the
+ * firmware uses, plus empty versions of the modules that only talk to
+ * the hardware (lcd_twi.cpp, memory.cpp and watchdog.cpp are not built
+ * for the replay). */
+
+#include <stdarg.h>
+
+#include "Arduino.h"
+#include "EEPROM.h"
+#include "NetEEPROM.h"
+#include "EtherCard.h"
+#include "DallasTemperature.h"
+#include "replay.h"
+
+#include "common.h"
+#include "memory.h"
+#include "watchdog.h"
+
+/* ---- Arduino core ---- */
+
+volatile uint8_t replaySfr[0x200];
+volatile uint8_t SREG;
+volatile uint8_t TCCR1A, TCCR1B, TIMSK1, MCUSR;
+volatile uint16_t TCNT1;
+
+HardwareSerial Serial;
+
+size_t Print::write(const uint8_t *buffer, size_t size) {
+  size_t n = 0;
+  while (size--)
+    n += write(*buffer++);
+  return n;
+}
+
+size_t Print::print(long n, int base) {
+  char s[72];
+  if (base == DEC)
+    return write(ltoa(n, s, 10));
+  return print((unsigned long)n, base);
+}
+
+size_t Print::print(unsigned long n, int base) {
+  char s[72];
+  return write(ultoa(n, s, base));
+}
+
+size_t Print::print(double n, int digits) {
+  char s[64];
+  snprintf(s, sizeof(s), "%.*f", digits, n);
+  return write(s);
+}
+
+size_t HardwareSerial::write(uint8_t c) {
+  replaySerialWrite(c);
+  return 1;
+}
+
+char *dtostrf(double value, signed char width, unsigned char prec, char *s) {
+  sprintf(s, "%*.*f", width, prec, value);
+  return s;
+}
+
+char *ultoa(unsigned long value, char *s, int radix) {
+  char tmp[72];
+  int i = 0;
+
+  do {
+    int digit = value % radix;
+    tmp[i++] = digit < 10 ? '0' + digit : 'a' + digit - 10;
+    value /= radix;
+  } while (value);
+
+  for (int j = 0; j < i; j++)
+    s[j] = tmp[i - 1 - j];
+  s[i] = '\0';
+  return s;
+}
+
+char *ltoa(long value, char *s, int radix) {
+  if (value < 0 && radix == 10) {
+    s[0] = '-';
+    ultoa(-(unsigned long)value, s + 1, radix);
+    return s;
+  }
+  return ultoa(value, s, radix);
+}
+
+char *utoa(unsigned int value, char *s, int radix) {
+  return ultoa(value, s, radix);
+}
+
+char *itoa(int value, char *s, int radix) {
+  return ltoa(value, s, radix);
+}
+
+unsigned long millis() {
+  return replayMicros() / 1000;
+}
+
+unsigned long micros() {
+  return replayMicros();
+}
+
+void delay(unsigned long ms) {
+  replayAdvance(ms * 1000);
+}
+
+void delayMicroseconds(unsigned int us) {
+  replayAdvance(us);
+}
+
+void pinMode(uint8_t pin, uint8_t mode) {
+}
+
+int digitalRead(uint8_t pin) {
+  return LOW;
+}
+
+void digitalWrite(uint8_t pin, uint8_t value) {
+}
+
+void analogWrite(uint8_t pin, int value) {
+}
+
+/* ---- EEPROM and NetEEPROM ---- */
+
+EEPROMClass EEPROM = {{0}};
+
+NetEEPROMClass NetEeprom;
+
+void NetEEPROMClass::init(uint8_t *mac) {
+  static const uint8_t replay_mac[6] = {0x02, 0x52, 0x45, 0x50, 0x4C, 0x59};
+  memcpy(mac, replay_mac, sizeof(replay_mac));
+}
+
+void NetEEPROMClass::writeManualConfig(uint8_t *mac, uint8_t *ip, uint8_t *gateway,
+                                       uint8_t *subnet, uint8_t *dns) {
+  dhcp = false;
+  memcpy(this->ip, ip, 4);
+  memcpy(this->gateway, gateway, 4);
+  memcpy(this->subnet, subnet, 4);
+  memcpy(this->dns, dns, 4);
+}
+
+/* ---- DallasTemperature ---- */
+
+uint8_t DallasTemperature::count = 0;
+
+float DallasTemperature::getTempCByIndex(uint8_t device) {
+  return replaySensorValue(index);
+}
+
+/* ---- EtherCard, but the frames (ether_replay.cpp or ether_tap.cpp) ---- */
+
+EtherCard ether;
+uint8_t EtherCard::mymac[6], EtherCard::myip[4], EtherCard::netmask[4], EtherCard::gwip[4],
+        EtherCard::dhcpip[4], EtherCard::dnsip[4], EtherCard::hisip[4];
+
+bool EtherCard::staticSetup(const uint8_t *ip, const uint8_t *gw,
+                            const uint8_t *dns, const uint8_t *mask) {
+  if (ip)
+    copyIp(myip, ip);
+  if (gw)
+    copyIp(gwip, gw);
+  if (dns)
+    copyIp(dnsip, dns);
+  if (mask)
+    copyIp(netmask, mask);
+  return true;
+}
+
+uint8_t EtherCard::parseIp(uint8_t *ip, const char *str) {
+  unsigned int b[4];
+
+  if (sscanf(str, "%u.%u.%u.%u", &b[0], &b[1], &b[2], &b[3]) != 4)
+    return 1;
+  for (int i = 0; i < 4; i++) {
+    if (b[i] > 255)
+      return 1;
+    ip[i] = b[i];
+  }
+  return 0;
+}
+
+/* The format codes of EtherCard. The varargs are promoted the host
+ * way, so $L reads a long and keeps the 32 bits of the AVR one. */
+void BufferFiller::emit_p(const char *fmt, ...) {
+  va_list ap;
+  char s[72];
+
+  va_start(ap, fmt);
+  for (; *fmt; fmt++) {
+    if (*fmt != '$') {
+      write(*fmt);
+      continue;
+    }
+    const char *arg = s;
+    switch (*++fmt) {
+      case 'D':
+        itoa(va_arg(ap, int), s, 10);
+        break;
+      case 'L':
+        ltoa((int32_t)(va_arg(ap, long) & 0xFFFFFFFF), s, 10);
+        break;
+      case 'T':
+        dtostrf(va_arg(ap, double), 10, 3, s);
+        break;
+      case 'H':
+        sprintf(s, "%02X", va_arg(ap, int) & 0xFF);
+        break;
+      case 'S':
+      case 'F':
+        arg = va_arg(ap, const char *);
+        break;
+      case 'E': {
+        const uint8_t *addr = va_arg(ap, const uint8_t *);
+        for (uintptr_t a = (uintptr_t)addr; a <= E2END && EEPROM.read(a); a++)
+          write(EEPROM.read(a));
+        s[0] = '\0';
+        break;
+      }
+      default:
+        s[0] = *fmt;
+        s[1] = '\0';
+        break;
+    }
+    while (*arg)
+      write(*arg++);
+  }
+  va_end(ap);
+}
+
+/* ---- lcd_twi.cpp: the screens are rendered, but go nowhere ---- */
+
+LcdTwi::LcdTwi(IN uint8_t i2c_addr) {
+}
+
+void LcdTwi::begin(IN uint8_t cols,
+                   IN uint8_t rows) {
+}
+
+void LcdTwi::setCursor(IN uint8_t col,
+                       IN uint8_t row) {
+}
+
+size_t LcdTwi::write(IN uint8_t c) {
+  return 1;
+}
+
+void LcdTwi::createChar(IN uint8_t location,
+                        IN uint8_t charmap[]) {
+}
+
+void LcdTwi::setBacklight(IN uint8_t on) {
+}
+
+bool LcdTwi::canQueue(IN uint8_t ops) {
+  return true;
+}
+
+void LcdTwi::flush() {
+}
+
+uint32_t LcdTwi::i2cBytes() {
+  return 0;
+}
+
+uint16_t LcdTwi::errors() {
+  return 0;
+}
+
+bool LcdTwi::ready() {
+  return true;
+}
+
+uint16_t LcdTwi::resyncs() {
+  return 0;
+}
+
+/* ---- memory.cpp: there is no AVR heap and stack to look at ---- */
+
+void memoryMarkSetupDone() {
+}
+
+void memoryMonitor() {
+}
+
+void memoryGetStats(OUT memory_stats *stats) {
+  memset(stats, 0, sizeof(*stats));
+}
+
+void memoryPrint(OUT Print &out) {
+}
+
+/* ---- watchdog.cpp: nothing resets the host ---- */
+
+void watchdogInit() {
+}
+
+void watchdogBootStage(IN uint8_t stage) {
+}
+
+void watchdogStart() {
+}
+
+void watchdogCheckIn(IN uint8_t task) {
+}
+
+void watchdogTask() {
+}
+
+void watchdogSleep(IN uint16_t ms) {
+  delay(ms);
+}
+
+uint8_t watchdogResetCause() {
+  return 1 << PORF;
+}
+
+bool watchdogHungIn(IN uint8_t stage) {
+  return false;
+}
@@ -0,0 +1,14 @@
+#ifndef replay_crc16_h
+#define replay_crc16_h
+
+#include "../Arduino.h"
+
+/* The same polynomial (0xA001) as the avr-libc one */
+inline uint16_t _crc16_update(uint16_t crc, uint8_t a) {
+  crc ^= a;
+  for (uint8_t i = 0; i < 8; i++)
+    crc = (crc & 1) ? (crc >> 1) ^ 0xA001 : (crc >> 1);
+  return crc;
+}
+
+#endif